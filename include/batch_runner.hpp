@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <precision.hpp>
+#include <constants.hpp>
+
+class Sim;
+
+class BatchRunner {
+  // Runs many small simulations concurrently within one process.
+  // The available cores are split into workers of threadsPerRun threads each.
+  // Each worker takes the next constants file from a shared queue and reuses
+  // its previous Sim (allocations and FFTW plans) when the grid shape is the
+  // same. FFTW wisdom is process-wide, so plans for a shape measured by one
+  // worker are cheap for all others.
+  // When built with MPI, runDistributed() hands the same queue out to MPI
+  // ranks instead, each of which runs its simulations with all of its threads.
+  public:
+    BatchRunner(const std::string &batchPath, const int threadsPerRun_in = 1);
+
+    int run();
+#ifdef USE_MPI
+    int runDistributed();
+#endif
+    void writeSummary(const std::string &filePath) const;
+
+    // Runs c with the nonlinear engine its flags select. Plain finite
+    // difference runs reuse sim when the grid shape allows and replace it
+    // otherwise, and the other engines are built for the run.
+    static void runNonLinear(const Constants &c, Sim *&sim);
+
+    std::vector<std::string> constantsFiles;
+
+  private:
+    const int threadsPerRun;
+
+    // One entry per constants file
+    std::vector<int> workers;
+    std::vector<int> isSuccessful;
+    std::vector<real> wallTimes;
+
+    void findConstantsFiles(const std::string &batchPath);
+    bool runOne(const std::string &constantsFile, Sim *&sim) const;
+};
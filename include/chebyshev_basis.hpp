@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include <fftw_api.hpp>
+
+#include <constants.hpp>
+#include <precision.hpp>
+#include <variable.hpp>
+
+class ChebyshevBasis {
+  // Chebyshev polynomials in z on the Gauss-Lobatto points
+  // z_k = (1 - cos(pi k/(nZ-1)))/2, which cluster towards the top and bottom
+  // boundaries. Rows of a Variable hold the values at these points, and the
+  // columns of its first nN modes are transformed with a type I DCT.
+  // Coefficient m of mode n is stored at m*nN + n.
+  public:
+    ChebyshevBasis(const Constants &c_in);
+    ~ChebyshevBasis();
+
+    void toCoefficients(const Variable &var, mode *coefficients) const;
+    void toGridpoints(const mode *coefficients, Variable &var);
+
+    // Coefficients of d/dz
+    void differentiate(const mode *coefficients, mode *derivative) const;
+
+    // Value of mode n at any height, by Clenshaw's recurrence
+    mode evaluate(const mode *coefficients, const int n, const real height) const;
+
+    const int nN;
+    const int nZ;
+    const int nCoefficients;
+
+    // Height of each row
+    std::vector<real> z;
+
+  private:
+    mode *work;
+
+    FftwApi<real>::plan forwardPlan, backwardPlan;
+};
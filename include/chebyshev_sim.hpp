@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include <chebyshev_basis.hpp>
+#include <chebyshev_tau_solver.hpp>
+#include <constants.hpp>
+#include <precision.hpp>
+#include <variable.hpp>
+#include <variables.hpp>
+
+class ChebyshevSim {
+  // Nonlinear simulation for dirichlet vertical boundaries with a Chebyshev
+  // basis in z. The rows of vars are at the Gauss-Lobatto points of basis,
+  // which resolve the boundary layers with far fewer points than a uniform
+  // grid. Diffusion is Crank-Nicolson and the other terms Adams-Bashforth,
+  // so each step solves Helmholtz problems with ChebyshevTauSolver and dt is
+  // only limited by advection. The horizontal direction is handled as in
+  // Sim. Initial conditions and dumps are on the usual uniform grid,
+  // interpolated through uniformVars.
+  public:
+    real t;
+    real dt;
+
+    const Constants c;
+
+    ChebyshevBasis basis;
+
+    Variables<Variable> vars;
+    Variables<Variable> uniformVars;
+
+    // z derivatives, so that the Jacobians only need x differences
+    Variable dTmpdz, dOmgdz, dXidz, dPsidz;
+    Variable nonlinearSineTerm, nonlinearCosineTerm;
+
+    ChebyshevSim(const Constants &c_in);
+    ~ChebyshevSim();
+
+    void loadInitialConditions();
+    void save();
+
+    // Derivative calculations
+    void computeExplicitDerivatives();
+    void computeVerticalDerivative(const Variable &var, Variable &dVardz);
+    void computeJacobian(Variable &nonlinearTerm, const Variable &var, const Variable &dVardz);
+    void applyHorizontalBoundaryConditions(Variable &var);
+
+    // Simulation functions
+    void factoriseDiffusion();
+    void stepDiffusively(Variable &var, const Variable &dVardt,
+        const ChebyshevTauSolver &solver, const real diffusivity,
+        const std::vector<mode> &bottom, const std::vector<mode> &top, const real f);
+    void applyBoundaryConditions();
+    void solveForPsi();
+    real checkCFL();
+
+    void runNonLinear();
+    void runNonLinearStep(real f=1.0);
+
+  private:
+    ChebyshevTauSolver psiSolver, tmpSolver, omgSolver, xiSolver;
+
+    // Chebyshev coefficients
+    mode *coefficients, *derivativeCoefficients, *solutionCoefficients;
+
+    // Values at the top and bottom of each mode
+    std::vector<mode> zeroBoundary, tmpBottom, tmpTop, xiBottom, xiTop;
+
+    void setBoundaryValues();
+    void toChebyshevPoints(const Variable &uniform, Variable &chebyshev) const;
+    void toUniformPoints(const Variable &chebyshev, Variable &uniform) const;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+#include <precision.hpp>
+
+class ChebyshevTauSolver {
+  // Solves d2u/dz2 - lambda_n u = f for each mode n on 0 <= z <= 1, with u
+  // given at both ends, by the Chebyshev tau method. The even and odd
+  // coefficients decouple, and each set satisfies a tridiagonal system apart
+  // from one full row for the boundary condition, so a solve is O(nZ) per
+  // mode. Coefficients are laid out as in ChebyshevBasis.
+  public:
+    ChebyshevTauSolver(const int nN_in, const int nZ_in);
+
+    void factorise(const std::vector<real> &lambda);
+
+    void solve(const mode *rhs, mode *sol,
+        const std::vector<mode> &bottom, const std::vector<mode> &top) const;
+
+  private:
+    const int nN;
+    const int nZ;
+
+    // Per mode, indexed n*nZ + m for coefficient m. Each coefficient is
+    // p_m - q_m times the previous one of the same parity, where p_m comes
+    // from the right hand side by back substitution with wk and upper.
+    std::vector<real> q;
+    std::vector<real> wk;
+    std::vector<real> upper;
+    // The first even and odd coefficients multiplied by sumOfTerms[2*n+parity]
+    // give their contribution to the boundary sums
+    std::vector<real> sumOfTerms;
+    std::vector<real> scaledLambda;
+
+    mode scaledRhs(const mode *rhs, const int n, const int m) const;
+};
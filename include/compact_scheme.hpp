@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vector>
+
+#include <precision.hpp>
+
+class CompactScheme {
+  // Fourth order compact (Pade) differences along a column of nZ values,
+  //   alpha f'_{k-1} + f'_k + alpha f'_{k+1} = 3/4 (f_{k+1} - f_{k-1})/dz
+  //   beta f''_{k-1} + f''_k + beta f''_{k+1} = 6/5 (f_{k+1} - 2f_k + f_{k-1})/dz^2
+  // with alpha = 1/4 and beta = 1/10. Dirichlet columns are closed by fourth
+  // order one-sided relations at the ends, which need no ghost points (the
+  // second derivative's is explicit, as the compact one has a zero pivot), and
+  // periodic columns are cyclic. The matrices are the same for every column,
+  // so they are factorised once.
+  public:
+    CompactScheme(const int nZ_in, const real dz_in, const bool isPeriodic_in);
+
+    // Columns are read from f[k*stride] and written to result[k*stride]
+    template<class T>
+    void dfdz(const T *f, T *result, const int stride) const;
+    template<class T>
+    void dfdz2(const T *f, T *result, const int stride) const;
+
+  private:
+    struct Factorisation {
+      std::vector<real> sub;
+      std::vector<real> wk1;
+      std::vector<real> wk2;
+
+      // Sherman-Morrison correction for the corners of cyclic systems
+      std::vector<real> correction;
+      real cornerCoefficient;
+      real correctionDenominator;
+    };
+
+    const int nZ;
+    const real oodz;
+    const real oodz2;
+    const bool isPeriodic;
+
+    Factorisation firstDerivative;
+    Factorisation secondDerivative;
+
+    void factorise(Factorisation &factors, const real offDiagonal,
+        const real bottomSup, const real topSub);
+    template<class T>
+    void solve(const Factorisation &factors, T *x, const int stride) const;
+    template<class T>
+    void solveTridiagonal(const Factorisation &factors, T *x, const int stride) const;
+
+    inline int wrap(const int k) const;
+};
+
+inline int CompactScheme::wrap(const int k) const {
+  return (k + nZ)%nZ;
+}
+
+template<class T>
+void CompactScheme::solveTridiagonal(const Factorisation &factors, T *x, const int stride) const {
+  x[0] *= factors.wk1[0];
+  for(int k=1; k<nZ; ++k) {
+    x[k*stride] = (x[k*stride] - factors.sub[k-1]*x[(k-1)*stride])*factors.wk1[k];
+  }
+  for(int k=nZ-2; k>=0; --k) {
+    x[k*stride] -= factors.wk2[k]*x[(k+1)*stride];
+  }
+}
+
+template<class T>
+void CompactScheme::solve(const Factorisation &factors, T *x, const int stride) const {
+  solveTridiagonal(factors, x, stride);
+  if(isPeriodic) {
+    const T vDotX = x[0] + factors.cornerCoefficient*x[(nZ-1)*stride];
+    const T scale = vDotX/factors.correctionDenominator;
+    for(int k=0; k<nZ; ++k) {
+      x[k*stride] -= scale*factors.correction[k];
+    }
+  }
+}
+
+template<class T>
+void CompactScheme::dfdz(const T *f, T *result, const int stride) const {
+  if(isPeriodic) {
+    for(int k=0; k<nZ; ++k) {
+      result[k*stride] = 0.75*(f[wrap(k+1)*stride] - f[wrap(k-1)*stride])*oodz;
+    }
+  } else {
+    const int N = nZ-1;
+    result[0] = (-17.0*f[0] + 9.0*f[stride] + 9.0*f[2*stride] - f[3*stride])*oodz/6.0;
+    for(int k=1; k<N; ++k) {
+      result[k*stride] = 0.75*(f[(k+1)*stride] - f[(k-1)*stride])*oodz;
+    }
+    result[N*stride] = (17.0*f[N*stride] - 9.0*f[(N-1)*stride]
+        - 9.0*f[(N-2)*stride] + f[(N-3)*stride])*oodz/6.0;
+  }
+  solve(firstDerivative, result, stride);
+}
+
+template<class T>
+void CompactScheme::dfdz2(const T *f, T *result, const int stride) const {
+  if(isPeriodic) {
+    for(int k=0; k<nZ; ++k) {
+      result[k*stride] = 1.2*(f[wrap(k+1)*stride] - 2.0*f[k*stride] + f[wrap(k-1)*stride])*oodz2;
+    }
+  } else {
+    const int N = nZ-1;
+    result[0] = (45.0*f[0] - 154.0*f[stride] + 214.0*f[2*stride]
+        - 156.0*f[3*stride] + 61.0*f[4*stride] - 10.0*f[5*stride])*oodz2/12.0;
+    for(int k=1; k<N; ++k) {
+      result[k*stride] = 1.2*(f[(k+1)*stride] - 2.0*f[k*stride] + f[(k-1)*stride])*oodz2;
+    }
+    result[N*stride] = (45.0*f[N*stride] - 154.0*f[(N-1)*stride] + 214.0*f[(N-2)*stride]
+        - 156.0*f[(N-3)*stride] + 61.0*f[(N-4)*stride] - 10.0*f[(N-5)*stride])*oodz2/12.0;
+  }
+  solve(secondDerivative, result, stride);
+}
@@ -21,6 +21,46 @@ class Constants {
     bool isNonlinear;
     bool isDoubleDiffusion;
     bool isCudaEnabled;
+    bool isEigenvalueSolverEnabled;
+
+    // Each thread transforms its own z-slab and computes its Jacobians
+    bool isSlabTransformEnabled;
+
+    // 2D Fourier basis for doubly periodic domains
+    bool isFullySpectral;
+
+    // Chebyshev basis in z for dirichlet vertical boundaries
+    bool isChebyshev;
+
+    // Fourth order compact differences in z
+    bool isCompact;
+
+    // Spectral x derivatives in the Jacobian, which allow the smaller
+    // dealiased nX of the 3/2 rule
+    bool isSpectralX;
+
+    // Round the default nX up until the transform length has no prime
+    // factors above 7, which FFTW handles much faster
+    bool isFftFriendlyNX;
+
+    // Linear derivatives, time step and psi solve on the real and
+    // imaginary parts of whole rows of modes, as in SplitComplexKernels
+    bool isSplitComplexKernels;
+
+    // Variables stores the rows of tmp, omg, psi and xi, and those of their
+    // derivatives, interleaved in one array each
+    bool isFieldInterleaved;
+
+    // Library for the transforms in x, "fftw" or "native"
+    std::string transformBackend;
+
+    // Clustering of the vertical grid, as in StretchedGrid
+    std::string verticalStretching;
+    real stretchingFactor;
+
+    // Lockstep ensemble of nonlinear simulations
+    int ensembleSize;
+    real ensemblePerturbation;
 
     bool isPhysicalResSpecfified;
 
@@ -48,11 +88,20 @@ class Constants {
     std::string saveFolder;
     std::string icFile; // initial conditions
 
+    // Start from the nearest cached final state instead of icFile
+    bool warmStart;
+    std::string stateCacheFolder;
+
     Constants();
     ~Constants();
     Constants(const std::string &input);
 
     void calculateDerivedConstants();
+    bool isSameGridShape(const Constants &other) const;
+    int dealiasedNX() const;
+    int fftFriendlyNX(const int minimumNX) const;
+    int transformLength(const int nX_in) const;
+    real transformCost(const int nX_in) const;
 
     void print() const;
     bool isValid() const;
@@ -3,6 +3,8 @@
 #include <constants.hpp>
 #include <precision.hpp>
 #include <sim.hpp>
+#include <linear_stability_solver.hpp>
+#include <linear_mode_sim.hpp>
 #ifdef CUDA
 #include <sim_gpu.hpp>
 #endif
@@ -16,7 +18,10 @@ class CriticalRayleighChecker {
     int calculateCriticalWavenumber();
     real calculateCriticalRayleigh();
     int testCriticalRayleigh();
-    template<class SimType> bool isCritical(const real testRa, const int nCrit);
+    template<class SimType> bool isCritical(SimType &sim, const real testRa, const int nCrit);
+    bool isCriticalModeDecoupled(LinearModeSim &sim, const Variables<Variable> &initialVars,
+        const real testRa, const int nCrit);
+    bool isCriticalEigenvalue(LinearStabilitySolver &solver, const real testRa, const int nCrit);
 
   private:
     Constants c;
@@ -24,9 +29,11 @@ class CriticalRayleighChecker {
 };
 
 template<class SimType>
-bool CriticalRayleighChecker::isCritical(const real testRa, const int nCrit) {
+bool CriticalRayleighChecker::isCritical(SimType &sim, const real testRa, const int nCrit) {
+  // The same simulation is reused for each Ra
   c.Ra = testRa;
-  SimType sim(c);
+  c.calculateDerivedConstants();
+  sim.reset(c);
 
   sim.vars.load(c.icFile);
 
@@ -45,7 +52,8 @@ bool CriticalRayleighChecker::isCritical(const real testRa, const int nCrit) {
       real logTmp = std::log(std::abs(sim.vars.tmp.magnitude(nCrit,32))) - std::log(std::abs(tmpPrev));
       real logOmg = std::log(std::abs(sim.vars.omg.magnitude(nCrit,32))) - std::log(std::abs(omgPrev));
       real logPsi = std::log(std::abs(sim.vars.psi.magnitude(nCrit,32))) - std::log(std::abs(psiPrev));
-      if(std::abs(logTmp - logTmpPrev)<tolerance and
+      if(steps > 0 and
+         std::abs(logTmp - logTmpPrev)<tolerance and
          std::abs(logOmg - logOmgPrev)<tolerance and
          std::abs(logPsi - logPsiPrev)<tolerance) {
         return logTmp > 0.0;
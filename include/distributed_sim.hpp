@@ -0,0 +1,97 @@
+#pragma once
+
+#ifdef USE_MPI
+
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+#include <constants.hpp>
+#include <precision.hpp>
+#include <thomas_algorithm.hpp>
+#include <variable.hpp>
+#include <variables.hpp>
+
+class DistributedSim {
+  // Nonlinear simulation with the z direction split into slabs of rows over
+  // the ranks of MPI_COMM_WORLD, for grids that do not fit on one node.
+  // Each rank stores its slab in ordinary Variables, with the ghost rows
+  // k = -1 and k = nLocalZ holding copies of the neighbouring ranks' rows.
+  // Ghost rows are exchanged without blocking, and the interior rows are
+  // computed while the messages are in flight. The psi solve needs whole
+  // columns, so omega is transposed to a mode-partitioned layout, solved
+  // per mode and transposed back.
+  public:
+    real t;
+    real dt;
+
+    const Constants c;
+    Constants cLocal;
+
+    int rank;
+    int nRanks;
+
+    // Rows [kStart, kStart+nLocalZ) and, for the psi solve, modes
+    // [nStart, nStart+nLocalN) belong to this rank
+    int kStart;
+    int nLocalZ;
+    int nStart;
+    int nLocalN;
+
+    Variables<Variable> vars;
+    Variable nonlinearSineTerm, nonlinearCosineTerm;
+
+    ThomasAlgorithm *thomasAlgorithm;
+
+    DistributedSim(const Constants &c_in);
+    ~DistributedSim();
+
+    // Whether every option in c is implemented on slabs. Others run serially.
+    static bool isSupported(const Constants &c);
+
+    void loadInitialConditions();
+    void save();
+
+    // Derivative calculations
+    void computeLinearDerivatives(const int kFirst, const int kLast);
+    void computeNonlinearDerivatives();
+    void applyPhysicalBoundaryConditions();
+    void computeJacobian(Variable &nonlinearTerm, const Variable &var, const int kFirst, const int kLast);
+    void addNonlinearTerm(Variable &dVardt, Variable &nonlinearTerm);
+
+    // Simulation functions
+    void solveForPsi();
+    void applyTemperatureBoundaryConditions();
+    void applyVorticityBoundaryConditions();
+    void applyPsiBoundaryConditions();
+    void applyXiBoundaryConditions();
+    real checkCFL();
+
+    void runNonLinear();
+    void runNonLinearStep(real f=1.0);
+
+  private:
+    int lowerRank;
+    int upperRank;
+    int saveNumber;
+
+    std::vector<int> rowStarts, rowCounts;
+    std::vector<int> modeStarts, modeCounts;
+
+    // Transpose buffers
+    std::vector<mode> slabBuffer;
+    std::vector<mode> columnBuffer;
+    std::vector<mode> columns;
+    std::vector<mode> solution;
+
+    void startGhostExchange(const std::vector<Variable*> &exchangeVars, const bool isSpatial, std::vector<MPI_Request> &requests);
+    void finishGhostExchange(std::vector<MPI_Request> &requests);
+
+    bool isBottomRank() const;
+    bool isTopRank() const;
+    std::vector<Variable*> activeVariables();
+    std::string createSaveFilename() const;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <constants.hpp>
+#include <precision.hpp>
+#include <thomas_algorithm.hpp>
+#include <ensemble_variable.hpp>
+
+class EnsembleSim {
+  // Advances nMembers nonlinear simulations with the same grid and parameters
+  // in lockstep. Every member shares one timestep, one set of FFTW plans and
+  // one tridiagonal factorisation, and each transform call covers all
+  // members at once. Member 0 starts from icFile unchanged, the others have
+  // a small random perturbation added to the temperature.
+  public:
+    real t;
+    real dt;
+
+    Constants c;
+    const int nMembers;
+
+    EnsembleVariable tmp, omg, psi, xi;
+    EnsembleVariable dTmpdt, dOmgdt, dXidt;
+    EnsembleVariable nonlinearSineTerm, nonlinearCosineTerm;
+
+    ThomasAlgorithm *thomasAlgorithm;
+
+    EnsembleSim(const Constants &c_in, const int nMembers_in, const real perturbation_in = 0.0);
+    ~EnsembleSim();
+
+    void loadInitialConditions();
+    void save();
+
+    // Derivative calculations
+    void computeLinearDerivatives();
+    void computeNonlinearDerivatives();
+    void applyPhysicalBoundaryConditions();
+    void computeNonlinearDerivative(EnsembleVariable &dVardt, const EnsembleVariable &var);
+
+    // Simulation functions
+    void solveForPsi();
+    void applyTemperatureBoundaryConditions();
+    void applyVorticityBoundaryConditions();
+    void applyPsiBoundaryConditions();
+    void applyXiBoundaryConditions();
+    real checkCFL();
+
+    void runNonLinear();
+    void runNonLinearStep(real f=1.0);
+
+  private:
+    const real perturbation;
+    int saveNumber;
+
+    // Sherman-Morrison correction for periodic vertical boundaries
+    std::vector<real> periodicCorrection;
+
+    void precalculatePeriodicCorrection();
+    std::string createSaveFilename(const int m) const;
+};
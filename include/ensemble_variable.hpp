@@ -0,0 +1,132 @@
+#pragma once
+
+#include <vector>
+#include <fstream>
+
+#include <precision.hpp>
+#include <constants.hpp>
+#include <variable.hpp>
+
+#include <fftw_api.hpp>
+
+class EnsembleVariable {
+  // Equivalent of Variable for an ensemble of nMembers simulations.
+  // The member index is the innermost dimension, so loops over members are
+  // contiguous and a single FFTW plan transforms every row of every member.
+  public:
+    inline int calcIndex(int n, int k) const;
+    inline int varSize() const;
+    inline int rowSize() const;
+    inline int totalSize() const;
+
+    inline mode& operator()(int n, int k, int m);
+    inline const mode& operator()(int n, int k, int m) const;
+    inline mode* members(int n, int k);
+    inline const mode* members(int n, int k) const;
+    inline mode& getPrev(int n, int k, int m);
+    inline const mode& getPrev(int n, int k, int m) const;
+    inline const mode* prevMembers(int n, int k) const;
+    inline real& spatial(int ix, int k, int m);
+    inline const real& spatial(int ix, int k, int m) const;
+    inline real* spatialMembers(int ix, int k);
+    inline const real* spatialMembers(int ix, int k) const;
+
+    void advanceTimestep();
+    void update(const EnsembleVariable& dVardt, const real dt, const real f=1.0);
+
+    void toSpectral();
+    void toPhysical();
+
+    void fill(mode value);
+    void readMember(const Variable &var, const int m);
+    void writeMember(Variable &var, const int m) const;
+    void writeMemberToFile(std::ofstream& file, const int m) const;
+    void readMemberFromFile(std::ifstream& file, const int m);
+
+    EnsembleVariable(const Constants &c_in, const int nMembers_in, const int totalSteps_in = 1, const bool useSinTransform_in = true);
+    ~EnsembleVariable();
+
+    const int nN;
+    const int nZ;
+    const int nX;
+    const int nG;
+    const int nMembers;
+    const bool useSinTransform;
+
+    mode *data;
+    real *spatialData;
+
+    std::vector<mode> topBoundary;
+    std::vector<mode> bottomBoundary;
+
+  private:
+    const Constants c;
+    const int totalSteps;
+    int current;
+    int previous;
+
+    FftwApi<real>::plan fftwForwardPlan;
+    FftwApi<real>::plan fftwBackwardPlan;
+
+    void setupFFTW();
+};
+
+inline int EnsembleVariable::calcIndex(int n, int k) const {
+  return ((k+nG)*rowSize() + n+nG)*nMembers;
+}
+
+inline int EnsembleVariable::varSize() const {
+  return rowSize()*(nZ+2*nG)*nMembers;
+}
+
+inline int EnsembleVariable::rowSize() const {
+  return nX + 2*nG;
+}
+
+inline int EnsembleVariable::totalSize() const {
+  return varSize()*totalSteps;
+}
+
+inline mode& EnsembleVariable::operator()(int n, int k, int m) {
+  return data[current*varSize() + calcIndex(n,k) + m];
+}
+
+inline const mode& EnsembleVariable::operator()(int n, int k, int m) const {
+  return data[current*varSize() + calcIndex(n,k) + m];
+}
+
+inline mode* EnsembleVariable::members(int n, int k) {
+  return data + current*varSize() + calcIndex(n,k);
+}
+
+inline const mode* EnsembleVariable::members(int n, int k) const {
+  return data + current*varSize() + calcIndex(n,k);
+}
+
+inline mode& EnsembleVariable::getPrev(int n, int k, int m) {
+  return data[previous*varSize() + calcIndex(n,k) + m];
+}
+
+inline const mode& EnsembleVariable::getPrev(int n, int k, int m) const {
+  return data[previous*varSize() + calcIndex(n,k) + m];
+}
+
+inline const mode* EnsembleVariable::prevMembers(int n, int k) const {
+  return data + previous*varSize() + calcIndex(n,k);
+}
+
+inline real& EnsembleVariable::spatial(int ix, int k, int m) {
+  return spatialData[calcIndex(ix,k) + m];
+}
+
+inline const real& EnsembleVariable::spatial(int ix, int k, int m) const {
+  return spatialData[calcIndex(ix,k) + m];
+}
+
+inline real* EnsembleVariable::spatialMembers(int ix, int k) {
+  return spatialData + calcIndex(ix,k);
+}
+
+inline const real* EnsembleVariable::spatialMembers(int ix, int k) const {
+  return spatialData + calcIndex(ix,k);
+}
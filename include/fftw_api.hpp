@@ -0,0 +1,46 @@
+#pragma once
+
+#include <fftw3.h>
+
+template<class T>
+struct FftwApi;
+// FFTW's interface for scalar type T, so FftwApi<float>::plan_many_r2r is
+// fftwf_plan_many_r2r. Only the functions used are listed. The float ones
+// are only instantiated, and libfftw3f only linked, in SINGLE and MIXED
+// builds.
+
+#define FFTW_API(T, X) \
+template<> \
+struct FftwApi<T> { \
+  typedef X##plan plan; \
+  typedef X##complex complex; \
+  typedef X##iodim iodim; \
+  typedef X##r2r_kind r2r_kind; \
+  template<class... Args> static plan plan_many_r2r(Args... args) { return X##plan_many_r2r(args...); } \
+  template<class... Args> static plan plan_many_dft(Args... args) { return X##plan_many_dft(args...); } \
+  template<class... Args> static plan plan_many_dft_r2c(Args... args) { return X##plan_many_dft_r2c(args...); } \
+  template<class... Args> static plan plan_many_dft_c2r(Args... args) { return X##plan_many_dft_c2r(args...); } \
+  template<class... Args> static plan plan_dft_r2c_2d(Args... args) { return X##plan_dft_r2c_2d(args...); } \
+  template<class... Args> static plan plan_dft_c2r_2d(Args... args) { return X##plan_dft_c2r_2d(args...); } \
+  template<class... Args> static plan plan_guru_r2r(Args... args) { return X##plan_guru_r2r(args...); } \
+  template<class... Args> static plan plan_guru_dft_r2c(Args... args) { return X##plan_guru_dft_r2c(args...); } \
+  template<class... Args> static plan plan_guru_dft_c2r(Args... args) { return X##plan_guru_dft_c2r(args...); } \
+  template<class... Args> static void execute(Args... args) { X##execute(args...); } \
+  template<class... Args> static void execute_r2r(Args... args) { X##execute_r2r(args...); } \
+  template<class... Args> static void execute_dft(Args... args) { X##execute_dft(args...); } \
+  template<class... Args> static void execute_dft_r2c(Args... args) { X##execute_dft_r2c(args...); } \
+  template<class... Args> static void execute_dft_c2r(Args... args) { X##execute_dft_c2r(args...); } \
+  template<class... Args> static void destroy_plan(Args... args) { X##destroy_plan(args...); } \
+  template<class... Args> static void* malloc(Args... args) { return X##malloc(args...); } \
+  template<class... Args> static void free(Args... args) { X##free(args...); } \
+  template<class... Args> static int init_threads(Args... args) { return X##init_threads(args...); } \
+  template<class... Args> static void plan_with_nthreads(Args... args) { X##plan_with_nthreads(args...); } \
+  template<class... Args> static void cleanup_threads(Args... args) { X##cleanup_threads(args...); } \
+  template<class... Args> static int import_wisdom_from_filename(Args... args) { return X##import_wisdom_from_filename(args...); } \
+  template<class... Args> static int export_wisdom_to_filename(Args... args) { return X##export_wisdom_to_filename(args...); } \
+};
+
+FFTW_API(double, fftw_)
+FFTW_API(float, fftwf_)
+
+#undef FFTW_API
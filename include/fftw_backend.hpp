@@ -0,0 +1,21 @@
+#pragma once
+
+#include <transform_backend.hpp>
+#include <fftw_api.hpp>
+
+template<class T>
+class FftwBackend : public TransformBackend<T> {
+  public:
+    FftwBackend(const TransformKind kind, const int n, const int nRows,
+        T *spatial, std::complex<T> *spectral, const int rowStride, const int nThreads);
+    ~FftwBackend();
+
+    void forward();
+    void backward();
+
+  private:
+    typedef FftwApi<T> Fftw;
+
+    typename Fftw::plan forwardPlan;
+    typename Fftw::plan backwardPlan;
+};
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <complex>
+#include <type_traits>
+#include <omp.h>
+
+#include <constants.hpp>
+#include <precision.hpp>
+#include <variable.hpp>
+
+// Lazily evaluated arithmetic on Variables, so that
+//   vars.dOmgdt = c.Pr*lap(vars.omg) - kx(c)*c.xCosDerivativeFactor*c.Pr*c.Ra*vars.tmp;
+// builds a small expression object and assigning it runs one parallel loop
+// over the grid, with no temporary arrays. Expressions are either spectral,
+// indexed (n,k) for the modes below nN, or physical, indexed (ix,k) for
+// the nX points of each row, and the two cannot be mixed. A bare Variable
+// is spectral, and spatial(var) is its physical values. rows(var, kFirst,
+// kLast) assigns to only those rows, as the slabs need.
+
+struct SpectralSpace {
+  static int rowLength(const Variable &var) { return var.nN; }
+  static mode& at(Variable &var, const int n, const int k) { return var(n,k); }
+};
+
+struct PhysicalSpace {
+  static int rowLength(const Variable &var) { return var.nX; }
+  static transform_real& at(Variable &var, const int ix, const int k) { return var.spatial(ix,k); }
+};
+
+template<class E, class Space>
+struct FieldExpression {
+  const E& self() const { return static_cast<const E&>(*this); }
+};
+
+// Leaves, which hold references to Variables that must outlive them
+
+struct ModesExpression : FieldExpression<ModesExpression, SpectralSpace> {
+  const Variable &var;
+  ModesExpression(const Variable &var_in) : var(var_in) {}
+  mode operator()(const int n, const int k) const { return var(n,k); }
+};
+
+struct LaplacianExpression : FieldExpression<LaplacianExpression, SpectralSpace> {
+  const Variable &var;
+  LaplacianExpression(const Variable &var_in) : var(var_in) {}
+  mode operator()(const int n, const int k) const { return var.laplacian(n,k); }
+};
+
+struct DfdzExpression : FieldExpression<DfdzExpression, SpectralSpace> {
+  const Variable &var;
+  DfdzExpression(const Variable &var_in) : var(var_in) {}
+  mode operator()(const int n, const int k) const { return var.dfdz(n,k); }
+};
+
+struct Dfdz2Expression : FieldExpression<Dfdz2Expression, SpectralSpace> {
+  const Variable &var;
+  Dfdz2Expression(const Variable &var_in) : var(var_in) {}
+  mode operator()(const int n, const int k) const { return var.dfdz2(n,k); }
+};
+
+// n*wavelength, the horizontal wavenumber of mode n
+struct WavenumberExpression : FieldExpression<WavenumberExpression, SpectralSpace> {
+  const real wavelength;
+  WavenumberExpression(const real wavelength_in) : wavelength(wavelength_in) {}
+  real operator()(const int n, const int k) const { return n*wavelength; }
+};
+
+struct SpatialExpression : FieldExpression<SpatialExpression, PhysicalSpace> {
+  const Variable &var;
+  SpatialExpression(const Variable &var_in) : var(var_in) {}
+  transform_real operator()(const int ix, const int k) const { return var.spatial(ix,k); }
+};
+
+struct DfdxSpatialExpression : FieldExpression<DfdxSpatialExpression, PhysicalSpace> {
+  const Variable &var;
+  DfdxSpatialExpression(const Variable &var_in) : var(var_in) {}
+  transform_real operator()(const int ix, const int k) const { return var.dfdx(ix,k); }
+};
+
+struct DfdzSpatialExpression : FieldExpression<DfdzSpatialExpression, PhysicalSpace> {
+  const Variable &var;
+  DfdzSpatialExpression(const Variable &var_in) : var(var_in) {}
+  transform_real operator()(const int ix, const int k) const { return var.dfdzSpatial(ix,k); }
+};
+
+template<class T, class Space>
+struct ScalarExpression : FieldExpression<ScalarExpression<T, Space>, Space> {
+  const T value;
+  ScalarExpression(const T value_in) : value(value_in) {}
+  T operator()(const int i, const int k) const { return value; }
+};
+
+// Nodes, which hold their operands by value
+
+template<class E, class Space>
+struct ShiftExpression : FieldExpression<ShiftExpression<E, Space>, Space> {
+  const E expression;
+  const int di, dk;
+  ShiftExpression(const E &expression_in, const int di_in, const int dk_in)
+    : expression(expression_in), di(di_in), dk(dk_in) {}
+  auto operator()(const int i, const int k) const { return expression(i+di, k+dk); }
+};
+
+template<class E, class Space>
+struct NegateExpression : FieldExpression<NegateExpression<E, Space>, Space> {
+  const E expression;
+  NegateExpression(const E &expression_in) : expression(expression_in) {}
+  auto operator()(const int i, const int k) const { return -expression(i,k); }
+};
+
+struct AddOperation {
+  template<class A, class B> static auto apply(const A &a, const B &b) { return a + b; }
+};
+
+struct SubtractOperation {
+  template<class A, class B> static auto apply(const A &a, const B &b) { return a - b; }
+};
+
+struct MultiplyOperation {
+  template<class A, class B> static auto apply(const A &a, const B &b) { return a*b; }
+};
+
+template<class Operation, class L, class R, class Space>
+struct BinaryExpression : FieldExpression<BinaryExpression<Operation, L, R, Space>, Space> {
+  const L left;
+  const R right;
+  BinaryExpression(const L &left_in, const R &right_in) : left(left_in), right(right_in) {}
+  auto operator()(const int i, const int k) const { return Operation::apply(left(i,k), right(i,k)); }
+};
+
+// Building expressions
+
+inline LaplacianExpression lap(const Variable &var) { return LaplacianExpression(var); }
+inline DfdzExpression dfdz(const Variable &var) { return DfdzExpression(var); }
+inline Dfdz2Expression dfdz2(const Variable &var) { return Dfdz2Expression(var); }
+inline WavenumberExpression kx(const Constants &c) { return WavenumberExpression(c.wavelength); }
+inline SpatialExpression spatial(const Variable &var) { return SpatialExpression(var); }
+inline DfdxSpatialExpression dfdx(const Variable &var) { return DfdxSpatialExpression(var); }
+inline DfdzSpatialExpression dfdzSpatial(const Variable &var) { return DfdzSpatialExpression(var); }
+
+// The expression's value at (i+di, k+dk)
+template<class E, class Space>
+ShiftExpression<E, Space> shift(const FieldExpression<E, Space> &expression, const int di, const int dk) {
+  return ShiftExpression<E, Space>(expression.self(), di, dk);
+}
+
+inline ShiftExpression<ModesExpression, SpectralSpace> shift(const Variable &var, const int di, const int dk) {
+  return ShiftExpression<ModesExpression, SpectralSpace>(ModesExpression(var), di, dk);
+}
+
+template<class T>
+struct IsScalar : std::is_arithmetic<T> {};
+
+template<class T>
+struct IsScalar<std::complex<T>> : std::true_type {};
+
+template<class E, class Space>
+NegateExpression<E, Space> operator-(const FieldExpression<E, Space> &expression) {
+  return NegateExpression<E, Space>(expression.self());
+}
+
+inline NegateExpression<ModesExpression, SpectralSpace> operator-(const Variable &var) {
+  return NegateExpression<ModesExpression, SpectralSpace>(ModesExpression(var));
+}
+
+// Each operator takes two expressions of the same space, an expression and
+// a Variable, two Variables, or a scalar and either
+#define FIELD_EXPRESSION_OPERATOR(OP, OPERATION) \
+template<class L, class R, class Space> \
+BinaryExpression<OPERATION, L, R, Space> operator OP( \
+    const FieldExpression<L, Space> &left, const FieldExpression<R, Space> &right) { \
+  return BinaryExpression<OPERATION, L, R, Space>(left.self(), right.self()); \
+} \
+template<class L> \
+BinaryExpression<OPERATION, L, ModesExpression, SpectralSpace> operator OP( \
+    const FieldExpression<L, SpectralSpace> &left, const Variable &right) { \
+  return BinaryExpression<OPERATION, L, ModesExpression, SpectralSpace>(left.self(), ModesExpression(right)); \
+} \
+template<class R> \
+BinaryExpression<OPERATION, ModesExpression, R, SpectralSpace> operator OP( \
+    const Variable &left, const FieldExpression<R, SpectralSpace> &right) { \
+  return BinaryExpression<OPERATION, ModesExpression, R, SpectralSpace>(ModesExpression(left), right.self()); \
+} \
+inline BinaryExpression<OPERATION, ModesExpression, ModesExpression, SpectralSpace> operator OP( \
+    const Variable &left, const Variable &right) { \
+  return BinaryExpression<OPERATION, ModesExpression, ModesExpression, SpectralSpace>( \
+      ModesExpression(left), ModesExpression(right)); \
+} \
+template<class L, class Space, class T, class = typename std::enable_if<IsScalar<T>::value>::type> \
+BinaryExpression<OPERATION, L, ScalarExpression<T, Space>, Space> operator OP( \
+    const FieldExpression<L, Space> &left, const T &right) { \
+  return BinaryExpression<OPERATION, L, ScalarExpression<T, Space>, Space>(left.self(), right); \
+} \
+template<class T, class R, class Space, class = typename std::enable_if<IsScalar<T>::value>::type> \
+BinaryExpression<OPERATION, ScalarExpression<T, Space>, R, Space> operator OP( \
+    const T &left, const FieldExpression<R, Space> &right) { \
+  return BinaryExpression<OPERATION, ScalarExpression<T, Space>, R, Space>(left, right.self()); \
+} \
+template<class T, class = typename std::enable_if<IsScalar<T>::value>::type> \
+BinaryExpression<OPERATION, ModesExpression, ScalarExpression<T, SpectralSpace>, SpectralSpace> operator OP( \
+    const Variable &left, const T &right) { \
+  return BinaryExpression<OPERATION, ModesExpression, ScalarExpression<T, SpectralSpace>, SpectralSpace>( \
+      ModesExpression(left), right); \
+} \
+template<class T, class = typename std::enable_if<IsScalar<T>::value>::type> \
+BinaryExpression<OPERATION, ScalarExpression<T, SpectralSpace>, ModesExpression, SpectralSpace> operator OP( \
+    const T &left, const Variable &right) { \
+  return BinaryExpression<OPERATION, ScalarExpression<T, SpectralSpace>, ModesExpression, SpectralSpace>( \
+      left, ModesExpression(right)); \
+}
+
+FIELD_EXPRESSION_OPERATOR(+, AddOperation)
+FIELD_EXPRESSION_OPERATOR(-, SubtractOperation)
+FIELD_EXPRESSION_OPERATOR(*, MultiplyOperation)
+
+#undef FIELD_EXPRESSION_OPERATOR
+
+// Evaluation
+
+class RowRange {
+  // Rows [kFirst, kLast) of a Variable, as the target of an assignment
+  public:
+    RowRange(Variable &var_in, const int kFirst_in, const int kLast_in)
+      : var(var_in), kFirst(kFirst_in), kLast(kLast_in) {}
+
+    template<class E, class Space>
+    void operator=(const FieldExpression<E, Space> &expression) {
+      evaluate<Space>(expression.self(), [](auto &target, const auto &value) { target = value; });
+    }
+
+    template<class E, class Space>
+    void operator+=(const FieldExpression<E, Space> &expression) {
+      evaluate<Space>(expression.self(), [](auto &target, const auto &value) { target += value; });
+    }
+
+    template<class E, class Space>
+    void operator-=(const FieldExpression<E, Space> &expression) {
+      evaluate<Space>(expression.self(), [](auto &target, const auto &value) { target -= value; });
+    }
+
+  private:
+    Variable &var;
+    const int kFirst, kLast;
+
+    // Rows are shared out over the threads, unless this is already inside
+    // a parallel region, and each row is a loop that can be vectorised
+    template<class Space, class E, class Assign>
+    void evaluate(const E &expression, Assign assign) {
+      const int rowLength = Space::rowLength(var);
+      #pragma omp parallel for schedule(static) if(!omp_in_parallel())
+      for(int k=kFirst; k<kLast; ++k) {
+        #pragma omp simd
+        for(int i=0; i<rowLength; ++i) {
+          assign(Space::at(var, i, k), expression(i, k));
+        }
+      }
+    }
+};
+
+inline RowRange rows(Variable &var, const int kFirst, const int kLast) {
+  return RowRange(var, kFirst, kLast);
+}
+
+template<class E, class Space>
+Variable& Variable::operator=(const FieldExpression<E, Space> &expression) {
+  rows(*this, 0, nZ) = expression;
+  return *this;
+}
+
+template<class E, class Space>
+Variable& Variable::operator+=(const FieldExpression<E, Space> &expression) {
+  rows(*this, 0, nZ) += expression;
+  return *this;
+}
+
+template<class E, class Space>
+Variable& Variable::operator-=(const FieldExpression<E, Space> &expression) {
+  rows(*this, 0, nZ) -= expression;
+  return *this;
+}
@@ -9,6 +9,7 @@
 class KineticEnergyTracker {
   public:
     KineticEnergyTracker(const Constants &c_in);
+    void reset(const Constants &c_in);
     void calcKineticEnergy(Variable &psi);
     real calcKineticEnergyForMode(const Variable &psi, int n);
     void saveKineticEnergy();
@@ -20,5 +21,5 @@ class KineticEnergyTracker {
     // Kinetic Energy tracker
     std::vector<real> kineticEnergies;
     Variable keDens;
-    const Constants c;
+    Constants c;
 };
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <constants.hpp>
+
+class LayoutBenchmark {
+  // Times nonlinear steps with each variable in its own array and with the
+  // fields interleaved, so isFieldInterleaved can be set per grid size
+  public:
+    LayoutBenchmark(const Constants &c_in);
+    void run(const int nRepeats) const;
+
+  private:
+    Constants c;
+
+    // Microseconds per nonlinear step, and per pass of the linear
+    // derivatives and time step alone
+    void time(const bool isFieldInterleaved, const int nRepeats,
+        real &stepTime, real &spectralTime) const;
+};
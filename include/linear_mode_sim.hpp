@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vector>
+
+#include <precision.hpp>
+#include <constants.hpp>
+#include <variable.hpp>
+#include <variables.hpp>
+#include <thomas_algorithm.hpp>
+
+class LinearModeSim {
+  // Linear simulation in which each horizontal mode is integrated on its own.
+  // In the linear system modes do not couple, so each selected mode is stored
+  // contiguously (tmp|omg|psi|xi plus derivative history) and advanced with
+  // its own timestep, independently and in parallel.
+  public:
+    Constants c;
+
+    std::vector<int> modes; // modes being integrated
+    std::vector<real> dt; // timestep per mode
+    std::vector<real> t; // current time per mode
+
+    ThomasAlgorithm *thomasAlgorithm;
+
+    // An empty list of modes integrates all modes n >= 1
+    LinearModeSim(const Constants &c_in, const std::vector<int> &modes_in = std::vector<int>());
+    ~LinearModeSim();
+
+    // Keeps the storage and modes for another run on the same grid. The
+    // state must be loaded again afterwards.
+    void reset(const Constants &c_in);
+
+    void load(const Variables<Variable> &vars);
+    void store(Variables<Variable> &vars) const;
+
+    void runStep(const int i);
+    void run(const real totalTime);
+
+    inline mode& tmp(int i, int k);
+    inline mode& omg(int i, int k);
+    inline mode& psi(int i, int k);
+    inline mode& xi(int i, int k);
+    inline const mode& tmp(int i, int k) const;
+    inline const mode& omg(int i, int k) const;
+    inline const mode& psi(int i, int k) const;
+    inline const mode& xi(int i, int k) const;
+
+  private:
+    int fieldSize;
+
+    // Storage for each mode, laid out as
+    // tmp|omg|psi|xi|dTmpdt(2 steps)|dOmgdt(2 steps)|dXidt(2 steps)
+    std::vector<std::vector<mode>> data;
+    std::vector<int> currentSlot; // derivative slot holding the current step
+
+    // Vertical gradients of the n=0 background profiles
+    std::vector<real> dTmpdz;
+    std::vector<real> dXidz;
+
+    inline int fieldIndex(int field, int k) const;
+    inline int derivativeIndex(int field, int slot, int k) const;
+
+    void setTimesteps();
+    void computeDerivatives(const int i);
+    void updateVars(const int i);
+    void applyBoundaryConditions(const int i);
+    void solveForPsi(const int i);
+};
+
+inline int LinearModeSim::fieldIndex(int field, int k) const {
+  // One ghost point either side in z
+  return field*fieldSize + k + 1;
+}
+
+inline int LinearModeSim::derivativeIndex(int field, int slot, int k) const {
+  return (4 + 2*field + slot)*fieldSize + k + 1;
+}
+
+inline mode& LinearModeSim::tmp(int i, int k) {
+  return data[i][fieldIndex(0, k)];
+}
+
+inline mode& LinearModeSim::omg(int i, int k) {
+  return data[i][fieldIndex(1, k)];
+}
+
+inline mode& LinearModeSim::psi(int i, int k) {
+  return data[i][fieldIndex(2, k)];
+}
+
+inline mode& LinearModeSim::xi(int i, int k) {
+  return data[i][fieldIndex(3, k)];
+}
+
+inline const mode& LinearModeSim::tmp(int i, int k) const {
+  return data[i][fieldIndex(0, k)];
+}
+
+inline const mode& LinearModeSim::omg(int i, int k) const {
+  return data[i][fieldIndex(1, k)];
+}
+
+inline const mode& LinearModeSim::psi(int i, int k) const {
+  return data[i][fieldIndex(2, k)];
+}
+
+inline const mode& LinearModeSim::xi(int i, int k) const {
+  return data[i][fieldIndex(3, k)];
+}
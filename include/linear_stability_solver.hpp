@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+#include <precision.hpp>
+#include <constants.hpp>
+#include <variable.hpp>
+
+class LinearStabilitySolver {
+  // Computes growth rates of the linearised system directly from its eigenvalues.
+  // Each horizontal mode n decouples, so the operator for a single mode is
+  // assembled as a banded matrix coupling tmp, omg, psi (and xi) in z, then
+  // the eigenvalues closest to the shift are found by shift-invert Arnoldi.
+  public:
+    Constants c;
+
+    // Shift used in the shift-invert iteration
+    real shift;
+    // Dimension of the Krylov subspace
+    int nKrylov;
+
+    LinearStabilitySolver(const Constants &c_in);
+
+    void setBackground(const Variable &tmp, const Variable &xi);
+    void setConductionBackground();
+
+    mode calcLeadingEigenvalue(const int n);
+    real calcGrowthRate(const int n);
+    real findCriticalRayleigh(const int n, real RaLow, real RaHigh, const real tolerance=1e-6);
+
+  private:
+    int blockSize; // variables per grid point
+    int nUnknowns;
+    int kl; // lower bandwidth
+    int ku; // upper bandwidth
+    int bandWidth;
+
+    // Vertical gradients of the n=0 background profiles
+    std::vector<real> dTmpdz;
+    std::vector<real> dXidz;
+
+    // Factorised (A - shift*B) in banded storage with pivots
+    std::vector<mode> band;
+    std::vector<int> pivots;
+
+    // Arnoldi workspace
+    std::vector<mode> krylovBasis;
+    std::vector<mode> hessenberg;
+    std::vector<mode> work;
+
+    inline int tmpIndex(int k) const;
+    inline int omgIndex(int k) const;
+    inline int psiIndex(int k) const;
+    inline int xiIndex(int k) const;
+    inline mode& bandEntry(int i, int j);
+
+    void assembleOperator(const int n);
+    void factorise();
+    void solveFactorised(mode *x) const;
+    void applyShiftInvert(const mode *in, mode *out);
+    std::vector<mode> calcRitzValues();
+};
+
+std::vector<mode> calcHessenbergEigenvalues(std::vector<mode> H, const int m);
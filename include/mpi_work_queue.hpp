@@ -0,0 +1,39 @@
+#pragma once
+
+#ifdef USE_MPI
+
+#include <functional>
+#include <vector>
+
+#include <precision.hpp>
+
+class MpiWorkQueue {
+  // Distributes nTasks independent tasks over the ranks of MPI_COMM_WORLD.
+  // Rank 0 only hands out task indices, one at a time, to whichever rank
+  // asks next, so slow tasks do not hold up a static partition. Each task
+  // writes nResults reals, which are gathered on rank 0 together with the
+  // rank that ran it. With a single rank the tasks simply run in order.
+  public:
+    MpiWorkQueue(const int nTasks_in, const int nResults_in);
+
+    void run(std::function<void(int, real*)> task);
+    bool isRoot() const;
+    // Whether this rank runs tasks, which rank 0 only does on its own
+    bool isRunningTasks() const;
+
+    int rank;
+    int nRanks;
+
+    // Only filled on rank 0
+    std::vector<real> results;
+    std::vector<int> taskRanks;
+
+  private:
+    const int nTasks;
+    const int nResults;
+
+    void runMaster();
+    void runWorker(std::function<void(int, real*)> task);
+};
+
+#endif
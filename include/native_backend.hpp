@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+#include <transform_backend.hpp>
+#include <native_fft.hpp>
+
+template<class T>
+class NativeBackend : public TransformBackend<T> {
+  // Builds every transform from one real FFT of length M. The sine and
+  // cosine transforms take the odd and even extensions of a row, so M is
+  // 2(n+1) and 2(n-1) respectively, and the fourier transforms use M = n.
+  // Even M is done as a complex FFT of M/2 and odd M as one of M.
+  public:
+    typedef std::complex<T> Complex;
+
+    NativeBackend(const TransformKind kind_in, const int n_in, const int nRows_in,
+        T *spatial_in, Complex *spectral_in, const int rowStride_in, const int nThreads_in);
+
+    void forward();
+    void backward();
+
+  private:
+    const TransformKind kind;
+    const int n;
+    const int nRows;
+    T *spatial;
+    Complex *spectral;
+    const int rowStride;
+    const int nThreads;
+
+    const int M;
+    const bool isPacked;
+    NativeFft<T> fft;
+
+    // exp(-2 pi i k/M), for unpacking even lengths
+    std::vector<Complex> packingTwiddles;
+
+    // Per thread scratch, each 2*(M+2) modes
+    std::vector<Complex> scratch;
+
+    void forwardRow(const int row, Complex *work);
+    void backwardRow(const int row, Complex *work);
+
+    // Y[k] = sum_j x[j] exp(-2 pi i jk/M) for k <= M/2
+    void realForward(const T *x, Complex *Y, Complex *work) const;
+    // x[j] = sum_k Y[k] exp(2 pi i jk/M) over the Hermitian spectrum
+    void realBackward(const Complex *Y, T *x, Complex *work) const;
+};
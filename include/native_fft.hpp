@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+#include <complex>
+
+template<class T>
+class NativeFft {
+  // Mixed radix complex FFT, out[k] = sum_j in[j] exp(-2 pi i jk/n), done
+  // by recursive decimation in time as in KISS FFT. Radices 4 and 2 have
+  // their own butterflies, and any other prime uses the O(p^2) generic one.
+  public:
+    typedef std::complex<T> Complex;
+
+    NativeFft(const int n_in);
+
+    // in and out must not overlap
+    void forward(const Complex *in, Complex *out) const;
+
+    const int n;
+
+  private:
+    // Pairs of (radix, remaining length)
+    std::vector<int> factors;
+    std::vector<Complex> twiddles;
+
+    void work(Complex *out, const Complex *in, const int stride, const int *factor) const;
+    void butterfly2(Complex *out, const int stride, const int m) const;
+    void butterfly4(Complex *out, const int stride, const int m) const;
+    void butterflyGeneric(Complex *out, const int stride, const int m, const int p) const;
+};
@@ -6,3 +6,6 @@
 inline int mod(int a, int b);
 mode adamsBashforth(mode dfdt_current, mode dfdt_prev, real frac, real dt);
 real checkCFL(Variable& psi, real dz, real dx, real dt, int a, int nN, int nX, int nZ);
+// Power of 0.8 by which dt should be scaled to stay within 0.8 of the times
+// taken to cross a cell in z and in x. dt itself is left to the caller.
+real cflTimestepFactor(const real dt, const real zCrossingTime, const real xCrossingTime, const bool isVerbose = true);
@@ -6,22 +6,52 @@
 #include <cuComplex.h>
 #endif
 
+// Chosen at compile time with -DPRECISION_SINGLE or -DPRECISION_MIXED
+// (make PRECISION=SINGLE or PRECISION=MIXED), and double by default.
+// real is used for the time stepping state, the vertical solves and the
+// diagnostics, and transform_real for the spatial arrays, the x transforms
+// and the Jacobian. Mixed precision keeps the first in double and runs the
+// second in float.
+#if not defined PRECISION_SINGLE and not defined PRECISION_MIXED and not defined PRECISION_DOUBLE
 #define PRECISION_DOUBLE
-// NOTE SINGLE PRECISION NOT SUPPORTED YET
-//#define PRECISION_SINGLE
+#endif
+
+#if defined PRECISION_MIXED and defined CUDA
+#error "Mixed precision is not supported on the GPU"
+#endif
 
 #if defined PRECISION_DOUBLE
 typedef double real;
+typedef double transform_real;
 const real EPSILON = FLT_EPSILON;
 #ifdef CUDA
 typedef cuDoubleComplex gpu_mode;
 #endif
+#elif defined PRECISION_MIXED
+typedef double real;
+typedef float transform_real;
+const real EPSILON = FLT_EPSILON;
 #elif defined PRECISION_SINGLE
 typedef float real;
-const real EPSILON = DBL_EPSILON;
+typedef float transform_real;
+const real EPSILON = FLT_EPSILON;
 #ifdef CUDA
 typedef cuComplex gpu_mode;
 #endif
 #endif
 
 typedef std::complex<real> mode;
+typedef std::complex<transform_real> transform_mode;
+
+#if defined PRECISION_SINGLE
+// std::complex<float> has no arithmetic with double, which every double
+// literal in the code would otherwise need a cast for
+inline mode operator*(const double a, const mode &b) { return real(a)*b; }
+inline mode operator*(const mode &a, const double b) { return a*real(b); }
+inline mode operator/(const double a, const mode &b) { return real(a)/b; }
+inline mode operator/(const mode &a, const double b) { return a/real(b); }
+inline mode operator+(const double a, const mode &b) { return real(a)+b; }
+inline mode operator+(const mode &a, const double b) { return a+real(b); }
+inline mode operator-(const double a, const mode &b) { return real(a)-b; }
+inline mode operator-(const mode &a, const double b) { return a-real(b); }
+#endif
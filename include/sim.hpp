@@ -3,6 +3,7 @@
 #include <vector>
 
 #include <thomas_algorithm.hpp>
+#include <split_complex_kernels.hpp>
 #include <constants.hpp>
 #include <precision.hpp>
 #include <variable.hpp>
@@ -28,12 +29,27 @@ class Sim {
     // Variable arrays
     Variables<Variable> vars;
     Variable nonlinearSineTerm, nonlinearCosineTerm;
+    Variable nonlinearXiTerm; // lets the xi Jacobian run alongside tmp
 
     ThomasAlgorithm *thomasAlgorithm;
 
+    // Only created for c.isSplitComplexKernels
+    SplitComplexKernels *splitComplexKernels;
+
+    // Spatial x derivatives from the spectral coefficients, only allocated
+    // for isSpectralX. Each is in the other basis to its variable.
+    Variable *dPsidx, *dTmpdx, *dOmgdx, *dXidx;
+
+    // Initial conditions kept in memory so that resets avoid re-reading icFile
+    std::vector<mode> initialState;
+    std::string initialStateFile;
+
     Sim(const Constants &c_in);
     ~Sim();
 
+    bool reset(const Constants &c_in);
+    void loadInitialConditions();
+
     // Helper functions
     void printMaxOf(real *a, std::string name) const;
     void printBenchmarkData() const;
@@ -41,14 +57,28 @@ class Sim {
 
     // Derivative calculations
     void computeLinearDerivatives();
-    void computeLinearTemperatureDerivative();
-    void computeLinearVorticityDerivative();
-    void computeLinearXiDerivative();
+    void computeLinearTemperatureDerivative(const int kFirst, const int kLast);
+    void computeLinearVorticityDerivative(const int kFirst, const int kLast);
+    void computeLinearXiDerivative(const int kFirst, const int kLast);
     void addAdvectionApproximation();
+    void updateVars(real f=1.0);
 
     void computeNonlinearDerivatives();
+    void computeDerivatives();
+    void computeDerivativesInSlabs();
     void applyPhysicalBoundaryConditions();
+    void applyHorizontalPhysicalBoundaryConditions(const int kFirst, const int kLast);
+    void copyPeriodicGhostRow(const int kGhost, const int kSource);
     void computeNonlinearDerivative(Variable &dVardt, const Variable &var);
+    void computeJacobianRow(Variable &nonlinearTerm, const Variable &var, const int k);
+    void computeCompactJacobian(Variable &nonlinearTerm, const Variable &var);
+    void computeSpectralXDerivative(const Variable &var, Variable &dVardx);
+    void computeSpectralXDerivatives();
+    void computeSpectralJacobianRow(Variable &nonlinearTerm, const Variable &var, const int k);
+    void computeNonlinearTerm(Variable &nonlinearTerm, const Variable &var);
+    void addNonlinearTerm(Variable &dVardt, const Variable &nonlinearTerm);
+    void applyMeanTemperatureGradient();
+    void applyMeanSalinityGradient();
     void computeNonlinearTemperatureDerivative();
     void computeNonlinearXiDerivative();
     void computeNonlinearVorticityDerivative();
@@ -69,4 +99,16 @@ class Sim {
     bool isCritical(int nCrit);
     real findCriticalRa(int nCrit);
     void runLinearStep();
+
+  private:
+    // Rows [slabStarts[s], slabStarts[s+1]) form slab s. slabReady[s] is set
+    // to slabEpoch once slab s is in physical space for the current step.
+    std::vector<int> slabStarts;
+    std::vector<int> slabReady;
+    int slabEpoch;
+
+    void setupSlabTransforms();
+    void waitForSlab(const int s) const;
+
+    const Variable& spectralXDerivativeOf(const Variable &var) const;
 };
@@ -30,6 +30,10 @@ class SimGPU {
     SimGPU(const Constants &c_in);
     ~SimGPU();
 
+    // As Sim::reset. The device constants are copied by
+    // Constants::calculateDerivedConstants.
+    bool reset(const Constants &c_in);
+
     void computeLinearDerivatives();
     void computeLinearTemperatureDerivative();
     void computeLinearVorticityDerivative();
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+
+#include <fftw_api.hpp>
+
+#include <constants.hpp>
+#include <precision.hpp>
+#include <variable.hpp>
+#include <variables.hpp>
+
+class SpectralSim {
+  // Nonlinear simulation for doubly periodic domains using a 2D Fourier
+  // basis. Every field is stored as the nZ x (nX/2+1) coefficients of a 2D
+  // real transform, so derivatives are exact and the psi solve is a
+  // division. Quadratic products are dealiased with the 2/3 rule. Initial
+  // conditions and dumps use the usual mode/gridpoint format, converted by
+  // transforms in z through the Variables in vars.
+  public:
+    real t;
+    real dt;
+
+    const Constants c;
+
+    // Staging area for reading and writing files
+    Variables<Variable> vars;
+
+    // Spectral coefficients, indexed m*nXh + n for z mode m and x mode n
+    const int nXh;
+    const int nSpectral;
+    mode *tmp, *omg, *psi, *xi;
+    mode *dTmpdt[2], *dOmgdt[2], *dXidt[2];
+
+    SpectralSim(const Constants &c_in);
+    ~SpectralSim();
+
+    void loadInitialConditions();
+    void save();
+
+    void toSpectral(const real *physical, mode *spectral) const;
+    void toPhysical(const mode *spectral, real *physical) const;
+
+    // Derivative calculations
+    void computeLinearDerivatives();
+    void computeVelocities();
+    void computeNonlinearDerivative(mode *dVardt, const mode *var);
+    void computeNonlinearDerivatives();
+
+    // Simulation functions
+    void solveForPsi();
+    real checkCFL();
+
+    void runNonLinear();
+    void runNonLinearStep(real f=1.0);
+
+  private:
+    int current; // slot of the derivatives being calculated
+
+    // Wavenumbers of each z and x mode, and 1 for modes kept by the 2/3 rule
+    std::vector<real> kz;
+    std::vector<real> kx;
+    std::vector<real> dealiasMask;
+
+    // Physical space work arrays
+    real *u, *w, *field, *product;
+    // Spectral work arrays
+    mode *spectralWork, *productHat;
+
+    FftwApi<real>::plan forwardPlan, backwardPlan;
+    FftwApi<real>::plan zForwardPlan, zBackwardPlan;
+
+    void columnsToSpectral(const Variable &var, const int step, mode *spectral);
+    void spectralToColumns(const mode *spectral, Variable &var, const int step);
+};
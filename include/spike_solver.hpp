@@ -0,0 +1,47 @@
+#pragma once
+
+#include <precision.hpp>
+#include <variable.hpp>
+
+#include <vector>
+
+class SpikeSolver {
+  // Partitioned (SPIKE) tridiagonal solver that splits the rows of each
+  // mode's system over threads. Each partition is solved on its own with
+  // the Thomas algorithm, a small system for the partition end values is
+  // solved per mode, and each partition is then corrected by its spikes.
+  // The spikes and the LU factors of the reduced systems only depend on the
+  // matrix, so they are calculated once by factorise().
+  public:
+    SpikeSolver(const int nN_in, const int nRows_in, const int nPartitions_in);
+
+    // Row i of mode n's system is sub[i-1]*x[i-1] + dia[i]*x[i] + sup[i]*x[i+1]
+    void factorise(const int n, const real *sub, const real *dia, const real *sup);
+
+    // Solves rows [0, nRows) of every mode. Must be called from within a
+    // parallel region, by all its threads.
+    void solve(Variable& sol, const Variable& rhs, std::vector<mode> &ends) const;
+
+    const int nPartitions;
+
+  private:
+    const int nN;
+    const int nRows;
+    const int nReduced;
+
+    std::vector<int> partitionStarts;
+
+    // Per mode, indexed n*nRows + i
+    std::vector<real> sub;
+    std::vector<real> wk1;
+    std::vector<real> wk2;
+    std::vector<real> leftSpike;
+    std::vector<real> rightSpike;
+
+    // Per mode LU factors of the reduced system, indexed n*nReduced*nReduced
+    std::vector<real> reducedLU;
+    std::vector<int> reducedPivots;
+
+    void solvePartition(const int n, const int p, Variable& sol, const Variable& rhs) const;
+    void solveReduced(const int n, mode *ends) const;
+};
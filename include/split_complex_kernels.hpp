@@ -0,0 +1,41 @@
+#pragma once
+
+#include <constants.hpp>
+#include <precision.hpp>
+#include <variable.hpp>
+#include <variables.hpp>
+
+#include <vector>
+
+class SplitComplexKernels {
+  // Sim's linear derivatives, Jacobian accumulation and time step written
+  // on the real and imaginary parts of whole rows of modes, so that the
+  // inner loops are plain real arithmetic that vectorises. The coefficients
+  // that only depend on n are tabulated once for each real and imaginary
+  // part. The modes stay interleaved, as the transforms, solvers and files
+  // all read them that way.
+  public:
+    SplitComplexKernels(const Constants &c_in);
+    void reparameterise(const Constants &c_in);
+
+    void computeLinearTemperatureDerivative(Variables<Variable> &vars, const int kFirst, const int kLast) const;
+    void computeLinearVorticityDerivative(Variables<Variable> &vars, const int kFirst, const int kLast) const;
+    void computeLinearXiDerivative(Variables<Variable> &vars, const int kFirst, const int kLast) const;
+    void addNonlinearTerm(Variable &dVardt, const Variable &nonlinearTerm) const;
+    void updateVars(Variables<Variable> &vars, const real dt, const real f) const;
+
+  private:
+    Constants c;
+
+    // -(n*wavelength)^2 and the Jacobian normalisation, indexed 2n and 2n+1
+    std::vector<real> dfdx2Factors;
+    std::vector<real> normalisations;
+
+    // Real and imaginary parts of the coefficients of tmp and xi in the
+    // vorticity equation, indexed n
+    std::vector<real> tmpFactorsRe, tmpFactorsIm;
+    std::vector<real> xiFactorsRe, xiFactorsIm;
+
+    void precalculate();
+    void update(Variable &var, const Variable &dVardt, const real dt, const real f) const;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <precision.hpp>
+#include <constants.hpp>
+
+class StabilitySweep {
+  // Evaluates linear growth rates over a grid of parameters in parallel.
+  // Each thread owns a LinearStabilitySolver so operators and workspaces
+  // are reused between points.
+  // When built with MPI, runDistributed() hands out chunks of points to MPI
+  // ranks from a work queue and gathers the map on rank 0.
+  public:
+    StabilitySweep(const Constants &c_in, const std::string &sweepFile);
+
+    void run();
+#ifdef USE_MPI
+    void runDistributed();
+#endif
+    void writeResults(const std::string &filePath) const;
+
+    std::string outputFile;
+
+  private:
+    const Constants c;
+
+    std::vector<int> modes;
+    std::vector<real> Ras;
+    std::vector<real> RaXis;
+    std::vector<real> taus;
+    std::vector<real> Prs;
+    std::vector<real> aspectRatios;
+
+    std::vector<mode> eigenvalues;
+
+    int nPoints() const;
+    void setParameters(Constants &cPoint, const int i, int &n) const;
+};
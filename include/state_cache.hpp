@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+#include <constants.hpp>
+#include <variable.hpp>
+#include <variables.hpp>
+
+class StateCache {
+  // Directory of final simulation states, each stored as a dump file next to
+  // the constants that produced it. A new run can start from the cached
+  // state with the nearest parameters instead of spinning up from icFile.
+  // States on a different grid are regridded (modes truncated or zero padded,
+  // linear interpolation in z).
+  public:
+    StateCache(const std::string &folder_in);
+
+    void store(const Constants &c, const Variables<Variable> &vars) const;
+    bool findNearest(const Constants &c, std::string &stateFile, Constants &cached) const;
+    bool load(const Constants &c, Variables<Variable> &vars) const;
+
+    static real distance(const Constants &c1, const Constants &c2);
+
+    const std::string folder;
+
+  private:
+    std::string createKey(const Constants &c) const;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <precision.hpp>
+
+class StretchedGrid {
+  // Vertical grid for dirichlet boundaries whose heights z(s) are a smooth
+  // map of the uniform coordinate s = k/(nZ-1). "boundaries" clusters the
+  // points at the top and bottom with a tanh map and "interface" clusters
+  // them around z = 1/2 with a sinh map, for step profiles. Larger factors
+  // cluster more strongly. Derivatives are taken in s and converted with
+  // the metric terms
+  //   d/dz = s_z d/ds,   d2/dz2 = s_z^2 d2/ds2 + s_zz d/ds
+  public:
+    StretchedGrid(const std::string &stretching, const real factor, const int nZ_in);
+
+    static bool isValidStretching(const std::string &stretching);
+
+    // Distance between points around row k
+    real spacing(const int k) const;
+    real minSpacing() const;
+
+    const int nZ;
+    const real ds;
+
+    std::vector<real> z;
+    std::vector<real> dsdz;
+    std::vector<real> d2sdz2;
+};
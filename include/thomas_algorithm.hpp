@@ -2,6 +2,9 @@
 
 #include <precision.hpp>
 #include <variable.hpp>
+#include <spike_solver.hpp>
+
+#include <vector>
 
 class ThomasAlgorithm {
   private:
@@ -12,22 +15,52 @@ class ThomasAlgorithm {
     void solveSystem(mode *sol, const mode *rhs, const int matrixN, const int n) const;
     void solveSystem(Variable& sol, const Variable& rhs, const int matrixN, const int n) const;
     void solvePeriodicSystem(Variable& sol, const Variable& rhs, const int n) const;
+    void solvePeriodicSystem(mode *sol, const mode *rhs, const int n) const;
+    void solveColumn(mode *sol, const mode *rhs, const int n) const;
+    void solveAllModesInRows(Variable& sol, const Variable& rhs) const;
+    void transposeForRows();
+
+    // Matrix entries for mode n away from the boundaries
+    real diagonal(const int n) const;
+    real offDiagonal(const int n) const;
+    void formCompactRhs(const mode *rhs, const int stride, mode *compactRhs) const;
 
     int nZ;
     const int nN;
     const bool isPeriodic;
-    const real oodz2;
-    const real wavelength;
+    // Fourth order compact laplacian, as in CompactScheme
+    const bool isCompact;
+    real oodz2;
+    real wavelength;
+
+    // Metric terms for a stretched vertical grid, which make the rows differ
+    StretchedGrid *stretchedGrid;
 
     // For periodic solver
     mode *sol2;
     mode *rhs2;
+
+    // Only used when there are fewer modes than threads
+    SpikeSolver *spikeSolver;
+    std::vector<mode> periodicSpikes;
+
+    // With c.isSplitComplexKernels, non-periodic second order systems are
+    // solved a row at a time for all modes at once. These are wk1, wk2 and
+    // sub transposed, with each entry repeated for the real and imaginary
+    // parts, indexed k*2*nN + 2*n (+1).
+    bool isRowSweep;
+    std::vector<real> wk1Rows;
+    std::vector<real> wk2Rows;
+    std::vector<real> subRows;
   public:
     real *wk1;
     real *wk2;
-    real *sub;
+    real *sub; // per mode, indexed n*nZ + k
 
     void solve(Variable& sol, const Variable& rhs, const int n) const;
+    void solve(mode *sol, const mode *rhs, const int n) const;
+    void solveAllModes(Variable& sol, const Variable& rhs) const;
+    void reparameterise(const Constants& c_in);
     ThomasAlgorithm(const Constants& c_in);
     ~ThomasAlgorithm();
 };
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+#include <precision.hpp>
+
+enum class TransformKind { sine, cosine, fourier };
+
+template<class T>
+class TransformBackend {
+  // Batched transforms along x for a block of rows, with FFTW's
+  // unnormalised conventions: RODFT00 (sine) and REDFT00 (cosine) between
+  // the spatial values and the real parts of the modes, and r2c/c2r
+  // (fourier) for periodic rows. n is the transform length as FFTW counts
+  // it, and row r starts at spatial + r*rowStride and spectral + r*rowStride.
+  // T is the scalar type the transforms run in, which is transform_real in
+  // Variable.
+  public:
+    static TransformBackend* create(const std::string &name, const TransformKind kind,
+        const int n, const int nRows, T *spatial, std::complex<T> *spectral,
+        const int rowStride, const int nThreads);
+    static bool isValidName(const std::string &name);
+
+    virtual ~TransformBackend() {}
+
+    virtual void forward() = 0;
+    virtual void backward() = 0;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+#include <constants.hpp>
+
+class TransformBenchmark {
+  // Times the x transforms of every backend at the grid size in the
+  // constants, so transformBackend can be set to the fastest per machine
+  public:
+    TransformBenchmark(const Constants &c_in);
+    void run(const int nRepeats) const;
+
+  private:
+    Constants c;
+
+    // Microseconds per call for the whole grid
+    void time(const std::string &backend, const bool useSinTransform, const int nRepeats,
+        real &forwardTime, real &backwardTime) const;
+};
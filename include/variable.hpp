@@ -5,9 +5,15 @@
 #include <fstream>
 #include <cassert>
 #include <string>
+#include <vector>
+#include <type_traits>
 #include <boundary_conditions.hpp>
+#include <compact_scheme.hpp>
+#include <stretched_grid.hpp>
+#include <transform_backend.hpp>
 
-#include <fftw3.h>
+template<class E, class Space>
+struct FieldExpression;
 
 class Variable {
   // Encapsulates an array representing a variable in the model
@@ -24,32 +30,63 @@ class Variable {
     inline int totalSize() const;
     inline int varSize() const;
     inline int rowSize() const;
+    inline int getRowStride() const;
+    inline int getTotalSteps() const;
 
     inline int calcIndex(int step, int n, int k) const;
     inline int calcIndex(int n, int k) const;
 
     inline mode& operator()(int n, int k);
     inline const mode& operator()(int n, int k) const;
-    inline real& spatial(int ix, int k);
-    inline const real& spatial(int ix, int k) const;
+    inline transform_real& spatial(int ix, int k);
+    inline const transform_real& spatial(int ix, int k) const;
 
     inline real magnitude(int n, int k) const;
 
     inline mode& getPrev(int n, int k);
     inline const mode& getPrev(int n, int k) const;
 
+    // Row k of the current or previous modes as 2*nN reals, each real part
+    // followed by its imaginary part
+    inline real* realRow(int k);
+    inline const real* realRow(int k) const;
+    inline const real* realPrevRow(int k) const;
+
     inline mode dfdz(int n, int k) const;
     inline mode dfdz2(int n, int k) const;
 
-    inline real dfdzSpatial(int ix, int k) const;
-    inline real dfdx(int ix, int k) const;
+    inline transform_real dfdzSpatial(int ix, int k) const;
+    inline transform_real dfdx(int ix, int k) const;
     inline mode dfdx2Spectral(int n, int k) const;
     inline mode laplacian(int n, int k) const;
 
     void update(const Variable& dVardt, const real dt, const real f=1.0);
 
+    // Evaluate a spectral or physical expression into every row, as in
+    // field_expression.hpp, which defines them
+    template<class E, class Space>
+    Variable& operator=(const FieldExpression<E, Space> &expression);
+    template<class E, class Space>
+    Variable& operator+=(const FieldExpression<E, Space> &expression);
+    template<class E, class Space>
+    Variable& operator-=(const FieldExpression<E, Space> &expression);
+
+    // With compact differences, dfdz and dfdz2 return the values calculated
+    // by computeCompactDerivatives and dfdzSpatial those calculated by
+    // computeCompactSpatialDerivative, so these must be called after the
+    // data changes
+    void computeCompactDerivatives();
+    void computeCompactSpatialDerivative();
+    inline bool isCompact() const { return compactScheme != nullptr; }
+
+    // ds/dz at row k, which is 1 without vertical stretching
+    inline real verticalMetric(int k) const;
+    inline const StretchedGrid* getStretchedGrid() const { return stretchedGrid; }
+
     void toSpectral();
     void toPhysical();
+    void toSpectral(const int slab);
+    void toPhysical(const int slab);
 
     bool anyNan() const;
 
@@ -57,9 +94,19 @@ class Variable {
 
     void writeToFile(std::ofstream& file) const;
     void readFromFile(std::ifstream& file);
+    void writeToBuffer(mode *buffer) const;
+    void readFromBuffer(const mode *buffer);
+
+    void reparameterise(const Constants &c_in);
 
     void initialiseData(mode initialValue = 0.0);
-    void setupFFTW();
+    void setupTransforms();
+    void setupSlabTransforms(const std::vector<int> &slabStarts_in);
+
+    // Moves the data onto storage owned elsewhere, whose rows are rowStride
+    // apart, so that other variables' rows can sit in between. The storage
+    // must hold totalSteps*(nZ+2*nG)*rowStride values.
+    void useStorage(mode *data_in, transform_real *spatialData_in, const int rowStride_in);
 
     // totalSteps gives the number of arrays to store, including the current one
     Variable(const Constants &c_in, const int totalSteps_in = 1, const bool useSinTransform_in = true);
@@ -70,34 +117,80 @@ class Variable {
     const int nX;
     const int nG;
     mode * data;
-    real * spatialData;
+    transform_real * spatialData;
 
     const bool useSinTransform;
 
+    // Only modes below nN are used, so toSpectral leaves the higher ones
+    // unnormalised and toPhysical takes them to be zero
+    bool isPruned;
+
+    // toSpectral skips the normalisation pass, and whoever reads the modes
+    // multiplies them by spectralNormalisation(n) instead
+    bool isNormalisationDeferred;
+    inline real spectralNormalisation(int n) const;
+
     mode topBoundary;
     mode bottomBoundary;
   protected:
     const BoundaryConditions verticalBoundaryConditions;
     const BoundaryConditions horizontalBoundaryConditions;
-    const real dz;
-    const real oodz2;
-    const real oodz;
-    const real oodx;
+    real dz;
+    real oodz2;
+    real oodz;
+    real oodx;
     const int totalSteps;
-    const Constants c;
+    Constants c;
     int current; // index pointing to slice of array representing current time
     int previous;
 
-    fftw_plan fftwForwardPlan;
-    fftw_plan fftwBackwardPlan;
+    // Distance between rows, which is rowSize() unless useStorage has
+    // interleaved this variable with others
+    int rowStride;
+    bool isStorageOwned;
+    inline int stepSize() const;
+
+    // Only allocated for compact differences
+    CompactScheme *compactScheme;
+    mode *dfdzData;
+    mode *dfdz2Data;
+    transform_real *dfdzSpatialData;
+
+    // Only allocated for a stretched vertical grid
+    StretchedGrid *stretchedGrid;
+
+    // From c.transformBackend
+    TransformBackend<transform_real> *transform;
+
+    // Per-slab transforms, only created by setupSlabTransforms
+    std::vector<int> slabStarts;
+    std::vector<TransformBackend<transform_real>*> slabTransforms;
+
+    // When transform_real is not real, the transforms read and write these
+    // modes, which are copied to and from data a row at a time
+    static const bool isTransformStaged = not std::is_same<mode, transform_mode>::value;
+    transform_mode *stagingData;
+    transform_mode* transformSpectralData();
+
+    void normaliseSpectralRow(const int k);
+    void normalisePhysicalRow(const int k);
+    void copyFromStagingRow(const int k);
+    void copyToStagingRow(const int k);
+    void initialiseStagingData();
+    TransformBackend<transform_real>* createTransform(const int kFirst, const int nRows, const int nThreads);
+    void destroySlabTransforms();
 };
 
+inline int Variable::getTotalSteps() const {
+  return totalSteps;
+}
+
 inline int Variable::calcIndex(int step, int n, int k) const {
-  return step*varSize() + calcIndex(n,k);
+  return step*stepSize() + calcIndex(n,k);
 }
 
 inline int Variable::calcIndex(int n, int k) const {
-  return (k+nG)*(nX+2*nG) + n+nG;
+  return (k+nG)*rowStride + n+nG;
   //return n*(nZ+2*nG) + (k+nG);
 }
 
@@ -115,12 +208,12 @@ inline real Variable::magnitude(int n, int k) const {
   return std::abs((*this)(n,k));
 }
 
-inline real& Variable::spatial(int i, int k) {
+inline transform_real& Variable::spatial(int i, int k) {
   // Get at n, k, possibly at previous step
   return spatialData[calcIndex(current, i, k)];
 }
 
-inline const real& Variable::spatial(int i, int k) const {
+inline const transform_real& Variable::spatial(int i, int k) const {
   // Get at n, k, possibly at previous step
   return spatialData[calcIndex(current, i, k)];
 }
@@ -135,6 +228,18 @@ inline const mode& Variable::getPrev(int n, int k) const {
   return data[calcIndex(previous, n, k)];
 }
 
+inline real* Variable::realRow(int k) {
+  return reinterpret_cast<real*>(&(*this)(0, k));
+}
+
+inline const real* Variable::realRow(int k) const {
+  return reinterpret_cast<const real*>(&(*this)(0, k));
+}
+
+inline const real* Variable::realPrevRow(int k) const {
+  return reinterpret_cast<const real*>(&getPrev(0, k));
+}
+
 inline int Variable::totalSize() const {
   return varSize()*totalSteps;
 }
@@ -147,24 +252,65 @@ inline int Variable::rowSize() const {
   return nX + 2*nG;
 }
 
+inline int Variable::getRowStride() const {
+  return rowStride;
+}
+
+inline int Variable::stepSize() const {
+  return rowStride*(nZ+2*nG);
+}
+
 inline mode Variable::dfdz(int n, int k) const {
+  if(compactScheme != nullptr) {
+    return dfdzData[calcIndex(n,k)];
+  }
   // Avoid derivatives at the edge
-  return ((*this)(n, k+1) - (*this)(n, k-1))*oodz*0.5;
+  const mode dfds = ((*this)(n, k+1) - (*this)(n, k-1))*oodz*0.5;
+  if(stretchedGrid != nullptr) {
+    return stretchedGrid->dsdz[k]*dfds;
+  }
+  return dfds;
 }
 
 inline mode Variable::dfdz2(int n, int k) const {
+  if(compactScheme != nullptr) {
+    return dfdz2Data[calcIndex(n,k)];
+  }
   // Avoid derivatives at the edge
-  return ((*this)(n, k+1) - 2.0*(*this)(n, k) + (*this)(n, k-1))*oodz2;
+  const mode d2fds2 = ((*this)(n, k+1) - 2.0*(*this)(n, k) + (*this)(n, k-1))*oodz2;
+  if(stretchedGrid != nullptr) {
+    const mode dfds = ((*this)(n, k+1) - (*this)(n, k-1))*oodz*0.5;
+    return pow(stretchedGrid->dsdz[k], 2)*d2fds2 + stretchedGrid->d2sdz2[k]*dfds;
+  }
+  return d2fds2;
 }
 
-inline real Variable::dfdzSpatial(int ix, int k) const {
+inline transform_real Variable::dfdzSpatial(int ix, int k) const {
+  if(compactScheme != nullptr) {
+    return dfdzSpatialData[calcIndex(ix,k)];
+  }
   // Avoid derivatives at the edge
-  return (spatial(ix, k+1) - spatial(ix, k-1))*oodz*0.5;
+  return (spatial(ix, k+1) - spatial(ix, k-1))*transform_real(oodz)*transform_real(0.5)
+    *transform_real(verticalMetric(k));
+}
+
+inline real Variable::spectralNormalisation(int n) const {
+  if(horizontalBoundaryConditions == BoundaryConditions::impermeable) {
+    return (n == 0 ? 0.5 : 1.0)/(nX-1.0);
+  }
+  return 1.0/nX;
+}
+
+inline real Variable::verticalMetric(int k) const {
+  if(stretchedGrid != nullptr) {
+    return stretchedGrid->dsdz[k];
+  }
+  return 1.0;
 }
 
-inline real Variable::dfdx(int ix, int k) const {
+inline transform_real Variable::dfdx(int ix, int k) const {
   // Avoid derivatives at the edge
-  return (spatial(ix+1, k) - spatial(ix-1, k))*oodx*0.5;
+  return (spatial(ix+1, k) - spatial(ix-1, k))*transform_real(oodx)*transform_real(0.5);
 }
 
 inline mode Variable::dfdx2Spectral(int n, int k) const {
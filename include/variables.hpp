@@ -23,18 +23,32 @@ class Variables {
 
     int saveNumber;
 
-    const Constants c;
+    Constants c;
 
     Variables(const Constants &c_in);
 
     void save();
+    void writeToFile(const std::string &filePath) const;
     void load(const std::string &icFile);
     void reinit(const real value = 0.0);
 
+    int stateSize() const;
+    void writeState(std::vector<mode> &state) const;
+    void readState(const std::vector<mode> &state);
+    void reparameterise(const Constants &c_in);
+
     void updateVars(const real dt, const real f = 1.0);
     void advanceDerivatives();
   private:
     std::string createSaveFilename();
+
+    // Only used for c.isFieldInterleaved, in which case row k of each
+    // variable in a group is followed by row k of the next, so the spectral
+    // loops read one stream per group rather than one per variable
+    std::vector<mode> stateStorage, derivativeStorage;
+    std::vector<transform_real> stateSpatialStorage, derivativeSpatialStorage;
+    void interleave(const std::vector<varType*> &group, std::vector<mode> &storage,
+        std::vector<transform_real> &spatialStorage);
 };
 
 template<class varType>
@@ -59,9 +73,34 @@ Variables<varType>::Variables(const Constants &c_in)
     variableList.push_back(&dXidt);
   }
 
+  if(c.isFieldInterleaved) {
+    std::vector<varType*> state = {&tmp, &omg, &psi};
+    std::vector<varType*> derivatives = {&dTmpdt, &dOmgdt};
+    if(c.isDoubleDiffusion) {
+      state.push_back(&xi);
+      derivatives.push_back(&dXidt);
+    }
+    interleave(state, stateStorage, stateSpatialStorage);
+    interleave(derivatives, derivativeStorage, derivativeSpatialStorage);
+  }
+
   saveNumber = 0;
 }
 
+template<class varType>
+void Variables<varType>::interleave(const std::vector<varType*> &group, std::vector<mode> &storage,
+    std::vector<transform_real> &spatialStorage) {
+  const int rowSize = group[0]->rowSize();
+  const int rowStride = group.size()*rowSize;
+  const int size = group[0]->getTotalSteps()*(c.nZ+2*c.nG)*rowStride;
+  storage.resize(size);
+  spatialStorage.resize(size);
+  for(int i=0; i<group.size(); ++i) {
+    assert(group[i]->getTotalSteps() == group[0]->getTotalSteps());
+    group[i]->useStorage(storage.data() + i*rowSize, spatialStorage.data() + i*rowSize, rowStride);
+  }
+}
+
 template<class varType>
 void Variables<varType>::updateVars(const real dt, const real f) {
   tmp.update(dTmpdt, dt, f);
@@ -87,6 +126,51 @@ void Variables<varType>::reinit(const real value) {
   }
 }
 
+template<class varType>
+int Variables<varType>::stateSize() const {
+  int size = 0;
+  for(int i=0; i<variableList.size(); ++i) {
+    size += variableList[i]->totalSize();
+  }
+  return size;
+}
+
+template<class varType>
+void Variables<varType>::writeState(std::vector<mode> &state) const {
+  // In-memory equivalent of save, used to restart without re-reading files
+  state.resize(stateSize());
+  int offset = 0;
+  for(int i=0; i<variableList.size(); ++i) {
+    variableList[i]->writeToBuffer(state.data() + offset);
+    offset += variableList[i]->totalSize();
+  }
+}
+
+template<class varType>
+void Variables<varType>::readState(const std::vector<mode> &state) {
+  assert(state.size() == stateSize());
+  int offset = 0;
+  for(int i=0; i<variableList.size(); ++i) {
+    variableList[i]->readFromBuffer(state.data() + offset);
+    offset += variableList[i]->totalSize();
+  }
+}
+
+template<class varType>
+void Variables<varType>::reparameterise(const Constants &c_in) {
+  // The set of variables in use depends on isDoubleDiffusion, so it must not change
+  assert(c_in.isDoubleDiffusion == c.isDoubleDiffusion);
+  c = c_in;
+  tmp.reparameterise(c);
+  xi.reparameterise(c);
+  omg.reparameterise(c);
+  psi.reparameterise(c);
+  dTmpdt.reparameterise(c);
+  dOmgdt.reparameterise(c);
+  dXidt.reparameterise(c);
+  saveNumber = 0;
+}
+
 template<class varType>
 std::string Variables<varType>::createSaveFilename() {
   // Format save number
@@ -98,18 +182,22 @@ std::string Variables<varType>::createSaveFilename() {
 
 template<class varType>
 void Variables<varType>::save() {
-  std::ofstream file (createSaveFilename(), std::ios::out | std::ios::binary);
+  writeToFile(createSaveFilename());
+  ++saveNumber;
+}
+
+template<class varType>
+void Variables<varType>::writeToFile(const std::string &filePath) const {
+  std::ofstream file (filePath, std::ios::out | std::ios::binary);
   if(file.is_open()) {
     for(int i=0; i<variableList.size(); ++i) {
       variableList[i]->writeToFile(file);
     }
   } else {
-    std::cout << "Couldn't open " << c.saveFolder << " for writing. Aborting." << std::endl;
+    std::cout << "Couldn't open " << filePath << " for writing. Aborting." << std::endl;
     exit(-1);
   }
   file.close();
-
-  ++saveNumber;
 }
 
 template<class varType>
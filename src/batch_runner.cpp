@@ -0,0 +1,216 @@
+#include <batch_runner.hpp>
+#include <sim.hpp>
+#include <ensemble_sim.hpp>
+#include <spectral_sim.hpp>
+#include <chebyshev_sim.hpp>
+#include <critical_rayleigh_checker.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef USE_MPI
+#include <mpi_work_queue.hpp>
+#endif
+
+using std::cout;
+using std::endl;
+
+BatchRunner::BatchRunner(const std::string &batchPath, const int threadsPerRun_in):
+  threadsPerRun(std::max(1, threadsPerRun_in))
+{
+  findConstantsFiles(batchPath);
+  workers.assign(constantsFiles.size(), 0);
+  isSuccessful.assign(constantsFiles.size(), 0);
+  wallTimes.assign(constantsFiles.size(), 0.0);
+}
+
+void BatchRunner::findConstantsFiles(const std::string &batchPath) {
+  // Either a directory of .json constants files or a text file listing one
+  // constants file per line
+  struct stat pathStat;
+  if(stat(batchPath.c_str(), &pathStat) != 0) {
+    cout << "Couldn't find batch " << batchPath << ". Aborting." << endl;
+    exit(-1);
+  }
+
+  if(S_ISDIR(pathStat.st_mode)) {
+    DIR *dir = opendir(batchPath.c_str());
+    struct dirent *entry;
+    while((entry = readdir(dir)) != nullptr) {
+      std::string name = entry->d_name;
+      if(name.size() > 5 and name.substr(name.size()-5) == ".json") {
+        constantsFiles.push_back(batchPath + "/" + name);
+      }
+    }
+    closedir(dir);
+    std::sort(constantsFiles.begin(), constantsFiles.end());
+  } else {
+    std::ifstream list(batchPath);
+    std::string line;
+    while(std::getline(list, line)) {
+      if(line != "" and line[0] != '#') {
+        constantsFiles.push_back(line);
+      }
+    }
+  }
+}
+
+void BatchRunner::runNonLinear(const Constants &c, Sim *&sim) {
+  if(c.isCudaEnabled) {
+#ifdef CUDA
+    SimGPU simulation(c);
+    simulation.runNonLinear();
+#endif
+  } else if(c.isFullySpectral) {
+    SpectralSim simulation(c);
+    simulation.runNonLinear();
+  } else if(c.isChebyshev) {
+    ChebyshevSim simulation(c);
+    simulation.runNonLinear();
+  } else if(c.ensembleSize > 1) {
+    EnsembleSim ensemble(c, c.ensembleSize, c.ensemblePerturbation);
+    ensemble.runNonLinear();
+  } else {
+    if(sim == nullptr or not sim->reset(c)) {
+      delete sim;
+      sim = new Sim(c);
+    }
+    sim->runNonLinear();
+  }
+}
+
+bool BatchRunner::runOne(const std::string &constantsFile, Sim *&sim) const {
+  const Constants c(constantsFile);
+  if(not c.isValid() or c.isCudaEnabled) {
+    #pragma omp critical
+    cout << "Skipping " << constantsFile << endl;
+    return false;
+  }
+
+  #pragma omp critical
+  cout << "Starting " << constantsFile << " -> " << c.saveFolder << endl;
+
+  bool isSuccess = true;
+  if(c.isNonlinear) {
+    runNonLinear(c, sim);
+  } else {
+    CriticalRayleighChecker crChecker(c);
+    if(crChecker.testCriticalRayleigh() < 0) {
+      isSuccess = false;
+    }
+  }
+
+  #pragma omp critical
+  cout << "Finished " << constantsFile << endl;
+
+  return isSuccess;
+}
+
+int BatchRunner::run() {
+  int nRuns = constantsFiles.size();
+  int nWorkers = 1;
+#ifdef _OPENMP
+  nWorkers = std::max(1, omp_get_max_threads()/threadsPerRun);
+  nWorkers = std::min(nWorkers, std::max(1, nRuns));
+  omp_set_max_active_levels(2);
+#endif
+
+  cout << "Running " << nRuns << " simulations on " << nWorkers
+    << " workers with " << threadsPerRun << " threads each" << endl;
+
+  int nFailed = 0;
+
+  #pragma omp parallel num_threads(nWorkers) reduction(+:nFailed)
+  {
+    int worker = 0;
+#ifdef _OPENMP
+    // Inner parallel regions and FFTW plans made by this worker use its share of cores
+    omp_set_num_threads(threadsPerRun);
+    worker = omp_get_thread_num();
+#endif
+    Sim *sim = nullptr;
+
+    #pragma omp for schedule(dynamic)
+    for(int i=0; i<nRuns; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      bool isSuccess = runOne(constantsFiles[i], sim);
+      std::chrono::duration<real> elapsed = std::chrono::steady_clock::now() - start;
+
+      workers[i] = worker;
+      isSuccessful[i] = isSuccess;
+      wallTimes[i] = elapsed.count();
+      if(not isSuccess) {
+        ++nFailed;
+      }
+    }
+
+    delete sim;
+  }
+
+  cout << nRuns - nFailed << " of " << nRuns << " runs completed" << endl;
+  return nFailed;
+}
+
+#ifdef USE_MPI
+int BatchRunner::runDistributed() {
+  // Results per run are success and wall time
+  int nRuns = constantsFiles.size();
+  MpiWorkQueue queue(nRuns, 2);
+
+  if(queue.isRoot()) {
+    cout << "Running " << nRuns << " simulations on " << std::max(1, queue.nRanks-1)
+      << " MPI ranks" << endl;
+  }
+
+  Sim *sim = nullptr;
+  queue.run([&](int i, real *result) {
+    auto start = std::chrono::steady_clock::now();
+    bool isSuccess = runOne(constantsFiles[i], sim);
+    std::chrono::duration<real> elapsed = std::chrono::steady_clock::now() - start;
+    result[0] = isSuccess ? 1.0 : 0.0;
+    result[1] = elapsed.count();
+  });
+  delete sim;
+
+  int nFailed = 0;
+  if(queue.isRoot()) {
+    for(int i=0; i<nRuns; ++i) {
+      workers[i] = queue.taskRanks[i];
+      isSuccessful[i] = queue.results[2*i] > 0.5;
+      wallTimes[i] = queue.results[2*i+1];
+      if(not isSuccessful[i]) {
+        ++nFailed;
+      }
+    }
+    cout << nRuns - nFailed << " of " << nRuns << " runs completed" << endl;
+  }
+  return nFailed;
+}
+#endif
+
+void BatchRunner::writeSummary(const std::string &filePath) const {
+  std::ofstream file(filePath);
+  if(not file.is_open()) {
+    cout << "Couldn't open " << filePath << " for writing. Aborting." << endl;
+    exit(-1);
+  }
+
+  file << "# index worker success wallTime constantsFile" << endl;
+  file << std::setprecision(6);
+  for(int i=0; i<constantsFiles.size(); ++i) {
+    file << i << " " << workers[i] << " " << isSuccessful[i] << " "
+      << wallTimes[i] << " " << constantsFiles[i] << endl;
+  }
+  file.close();
+
+  cout << "Batch summary written to " << filePath << endl;
+}
@@ -0,0 +1,119 @@
+#include <chebyshev_basis.hpp>
+
+#include <cmath>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+ChebyshevBasis::ChebyshevBasis(const Constants &c_in)
+  : nN(c_in.nN)
+  , nZ(c_in.nZ)
+  , nCoefficients(c_in.nN*c_in.nZ)
+{
+  z.resize(nZ);
+  for(int k=0; k<nZ; ++k) {
+    z[k] = 0.5*(1.0 - cos(M_PI*k/(nZ-1)));
+  }
+
+  work = static_cast<mode*>(FftwApi<real>::malloc(sizeof(mode)*nCoefficients));
+
+  // Plans are made on an array laid out like a Variable and executed on the
+  // Variables themselves. The real and imaginary parts of each mode are
+  // transformed separately.
+  const int rowSize = c_in.nX + 2*c_in.nG;
+  const int varSize = rowSize*(c_in.nZ + 2*c_in.nG);
+  mode *layout = static_cast<mode*>(FftwApi<real>::malloc(sizeof(mode)*varSize));
+  real *columns = reinterpret_cast<real*>(layout + c_in.nG*rowSize + c_in.nG);
+  int n[] = {nZ};
+  FftwApi<real>::r2r_kind kind[] = {FFTW_REDFT00};
+
+  #pragma omp critical
+  {
+#ifdef _OPENMP
+  FftwApi<real>::plan_with_nthreads(omp_get_max_threads());
+#endif
+  forwardPlan = FftwApi<real>::plan_many_r2r(1, n, 2*nN,
+      columns, nullptr, 2*rowSize, 1,
+      reinterpret_cast<real*>(work), nullptr, 2*nN, 1,
+      kind, FFTW_MEASURE | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+#ifdef _OPENMP
+  FftwApi<real>::plan_with_nthreads(omp_get_max_threads());
+#endif
+  backwardPlan = FftwApi<real>::plan_many_r2r(1, n, 2*nN,
+      reinterpret_cast<real*>(work), nullptr, 2*nN, 1,
+      columns, nullptr, 2*rowSize, 1,
+      kind, FFTW_MEASURE | FFTW_UNALIGNED);
+  }
+
+  FftwApi<real>::free(layout);
+}
+
+ChebyshevBasis::~ChebyshevBasis() {
+  // Shares the planner's state, as in FftwBackend
+  #pragma omp critical
+  {
+  FftwApi<real>::destroy_plan(forwardPlan);
+  FftwApi<real>::destroy_plan(backwardPlan);
+  }
+  FftwApi<real>::free(work);
+}
+
+void ChebyshevBasis::toCoefficients(const Variable &var, mode *coefficients) const {
+  real *columns = reinterpret_cast<real*>(const_cast<mode*>(var.getCurrent()) + var.calcIndex(0,0));
+  FftwApi<real>::execute_r2r(forwardPlan, columns, reinterpret_cast<real*>(coefficients));
+
+  // Rows run from bottom to top, the reverse of the usual ordering, which
+  // flips the sign of the odd coefficients
+  const int N = nZ-1;
+  for(int m=0; m<nZ; ++m) {
+    const real normalisation = (m%2 == 0 ? 1.0 : -1.0)/(N*((m == 0 or m == N) ? 2.0 : 1.0));
+    for(int n=0; n<nN; ++n) {
+      coefficients[m*nN + n] *= normalisation;
+    }
+  }
+}
+
+void ChebyshevBasis::toGridpoints(const mode *coefficients, Variable &var) {
+  const int N = nZ-1;
+  for(int m=0; m<nZ; ++m) {
+    const real normalisation = (m%2 == 0 ? 1.0 : -1.0)*((m == 0 or m == N) ? 1.0 : 0.5);
+    for(int n=0; n<nN; ++n) {
+      work[m*nN + n] = coefficients[m*nN + n]*normalisation;
+    }
+  }
+
+  real *columns = reinterpret_cast<real*>(var.getCurrent() + var.calcIndex(0,0));
+  FftwApi<real>::execute_r2r(backwardPlan, reinterpret_cast<real*>(work), columns);
+}
+
+void ChebyshevBasis::differentiate(const mode *coefficients, mode *derivative) const {
+  // c_{m-1} d_{m-1} = d_{m+1} + 2m a_m on [-1, 1], with c_0 = 2, then a
+  // factor of 2 for the map to [0, 1]
+  const int N = nZ-1;
+  for(int n=0; n<nN; ++n) {
+    derivative[N*nN + n] = 0.0;
+    derivative[(N-1)*nN + n] = 4.0*N*coefficients[N*nN + n];
+  }
+  for(int m=N-1; m>=1; --m) {
+    for(int n=0; n<nN; ++n) {
+      derivative[(m-1)*nN + n] = derivative[(m+1)*nN + n] + 4.0*m*coefficients[m*nN + n];
+    }
+  }
+  for(int n=0; n<nN; ++n) {
+    derivative[n] *= 0.5;
+  }
+}
+
+mode ChebyshevBasis::evaluate(const mode *coefficients, const int n, const real height) const {
+  const real x = 2.0*height - 1.0;
+  mode b1 = 0.0;
+  mode b2 = 0.0;
+  for(int m=nZ-1; m>=1; --m) {
+    const mode b0 = coefficients[m*nN + n] + 2.0*x*b1 - b2;
+    b2 = b1;
+    b1 = b0;
+  }
+  return coefficients[n] + x*b1 - b2;
+}
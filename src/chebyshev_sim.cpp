@@ -0,0 +1,368 @@
+#include <chebyshev_sim.hpp>
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+#include <numerical_methods.hpp>
+
+using std::cout;
+using std::endl;
+
+ChebyshevSim::ChebyshevSim(const Constants &c_in)
+  : c(c_in)
+  , basis(c_in)
+  , vars(c_in)
+  , uniformVars(c_in)
+  , dTmpdz(c_in, 1, false)
+  , dOmgdz(c_in, 1, true)
+  , dXidz(c_in, 1, false)
+  , dPsidz(c_in, 1, true)
+  , nonlinearSineTerm(c_in, 1, true)
+  , nonlinearCosineTerm(c_in, 1, false)
+  , psiSolver(c_in.nN, c_in.nZ)
+  , tmpSolver(c_in.nN, c_in.nZ)
+  , omgSolver(c_in.nN, c_in.nZ)
+  , xiSolver(c_in.nN, c_in.nZ)
+{
+  dt = c.initialDt;
+
+  for(mode **var : {&coefficients, &derivativeCoefficients, &solutionCoefficients}) {
+    *var = new mode[basis.nCoefficients];
+  }
+
+  std::vector<real> lambda(c.nN);
+  for(int n=0; n<c.nN; ++n) {
+    lambda[n] = pow(n*c.wavelength, 2);
+  }
+  psiSolver.factorise(lambda);
+  factoriseDiffusion();
+
+  zeroBoundary.assign(c.nN, 0.0);
+}
+
+ChebyshevSim::~ChebyshevSim() {
+  delete [] coefficients;
+  delete [] derivativeCoefficients;
+  delete [] solutionCoefficients;
+}
+
+void ChebyshevSim::toChebyshevPoints(const Variable &uniform, Variable &chebyshev) const {
+  // Cubic interpolation between the four nearest uniform points
+  const int nZ = c.nZ;
+  for(int i=0; i<uniform.getTotalSteps(); ++i) {
+    const mode *uniformData = uniform.getPlus(i);
+    mode *chebyshevData = chebyshev.getPlus(i);
+    for(int k=0; k<nZ; ++k) {
+      const real position = basis.z[k]*(nZ-1);
+      const int kFirst = std::max(0, std::min(int(position)-1, nZ-4));
+      real weights[4];
+      for(int j=0; j<4; ++j) {
+        weights[j] = 1.0;
+        for(int l=0; l<4; ++l) {
+          if(l != j) {
+            weights[j] *= (position - (kFirst+l))/real(j-l);
+          }
+        }
+      }
+      for(int n=0; n<c.nN; ++n) {
+        mode value = 0.0;
+        for(int j=0; j<4; ++j) {
+          value += weights[j]*uniformData[uniform.calcIndex(n, kFirst+j)];
+        }
+        chebyshevData[chebyshev.calcIndex(n,k)] = value;
+      }
+    }
+  }
+  chebyshev.topBoundary = chebyshev(0,nZ-1);
+  chebyshev.bottomBoundary = chebyshev(0,0);
+}
+
+void ChebyshevSim::toUniformPoints(const Variable &chebyshev, Variable &uniform) const {
+  // Barycentric interpolation, which evaluates the Chebyshev interpolant
+  // without transforming each step
+  const int nZ = c.nZ;
+  std::vector<real> weights(nZ);
+  for(int j=0; j<nZ; ++j) {
+    weights[j] = (j%2 == 0 ? 1.0 : -1.0)*((j == 0 or j == nZ-1) ? 0.5 : 1.0);
+  }
+
+  for(int i=0; i<chebyshev.getTotalSteps(); ++i) {
+    const mode *chebyshevData = chebyshev.getPlus(i);
+    mode *uniformData = uniform.getPlus(i);
+    for(int k=0; k<nZ; ++k) {
+      const real height = real(k)/(nZ-1);
+      std::vector<real> terms(nZ);
+      int kNode = -1;
+      real sum = 0.0;
+      for(int j=0; j<nZ; ++j) {
+        const real distance = height - basis.z[j];
+        if(std::abs(distance) < 1e-14) {
+          kNode = j;
+          break;
+        }
+        terms[j] = weights[j]/distance;
+        sum += terms[j];
+      }
+      for(int n=0; n<c.nN; ++n) {
+        mode value = 0.0;
+        if(kNode >= 0) {
+          value = chebyshevData[chebyshev.calcIndex(n,kNode)];
+        } else {
+          for(int j=0; j<nZ; ++j) {
+            value += terms[j]*chebyshevData[chebyshev.calcIndex(n,j)];
+          }
+          value /= sum;
+        }
+        uniformData[uniform.calcIndex(n,k)] = value;
+      }
+    }
+  }
+}
+
+void ChebyshevSim::setBoundaryValues() {
+  // Only the mean temperature and salinity are nonzero on the boundaries
+  tmpBottom.assign(c.nN, 0.0);
+  tmpTop.assign(c.nN, 0.0);
+  xiBottom.assign(c.nN, 0.0);
+  xiTop.assign(c.nN, 0.0);
+  tmpBottom[0] = vars.tmp.bottomBoundary;
+  tmpTop[0] = vars.tmp.topBoundary;
+  if(c.isDoubleDiffusion) {
+    xiBottom[0] = vars.xi.bottomBoundary;
+    xiTop[0] = vars.xi.topBoundary;
+  }
+}
+
+void ChebyshevSim::applyBoundaryConditions() {
+  // Each step keeps the boundary values, so they only need setting once
+  for(int n=0; n<c.nN; ++n) {
+    vars.tmp(n,0) = tmpBottom[n];
+    vars.tmp(n,c.nZ-1) = tmpTop[n];
+    vars.omg(n,0) = 0.0;
+    vars.omg(n,c.nZ-1) = 0.0;
+    if(c.isDoubleDiffusion) {
+      vars.xi(n,0) = xiBottom[n];
+      vars.xi(n,c.nZ-1) = xiTop[n];
+    }
+  }
+}
+
+void ChebyshevSim::loadInitialConditions() {
+  uniformVars.load(c.icFile);
+  for(int i=0; i<vars.variableList.size(); ++i) {
+    toChebyshevPoints(*uniformVars.variableList[i], *vars.variableList[i]);
+  }
+  setBoundaryValues();
+  applyBoundaryConditions();
+  solveForPsi();
+}
+
+void ChebyshevSim::save() {
+  for(int i=0; i<vars.variableList.size(); ++i) {
+    toUniformPoints(*vars.variableList[i], *uniformVars.variableList[i]);
+  }
+  uniformVars.save();
+}
+
+void ChebyshevSim::computeVerticalDerivative(const Variable &var, Variable &dVardz) {
+  basis.toCoefficients(var, coefficients);
+  basis.differentiate(coefficients, derivativeCoefficients);
+  basis.toGridpoints(derivativeCoefficients, dVardz);
+}
+
+void ChebyshevSim::applyHorizontalBoundaryConditions(Variable &var) {
+  // As Sim::applyHorizontalPhysicalBoundaryConditions, by the parity of the
+  // transform
+  const int nX = c.nX;
+  #pragma omp parallel for schedule(static)
+  for(int k=0; k<c.nZ; ++k) {
+    if(c.horizontalBoundaryConditions == BoundaryConditions::impermeable) {
+      if(var.useSinTransform) {
+        var.spatial(0,k) = 0.0;
+        var.spatial(nX-1,k) = 0.0;
+        var.spatial(-1,k) = -var.spatial(1,k);
+        var.spatial(nX,k) = -var.spatial(nX-2,k);
+      } else {
+        var.spatial(-1,k) = var.spatial(1,k);
+        var.spatial(nX,k) = var.spatial(nX-2,k);
+      }
+    } else if(c.horizontalBoundaryConditions == BoundaryConditions::periodic) {
+      var.spatial(-1,k) = var.spatial(nX-1,k);
+      var.spatial(nX,k) = var.spatial(0,k);
+    }
+  }
+}
+
+void ChebyshevSim::computeJacobian(Variable &nonlinearTerm, const Variable &var, const Variable &dVardz) {
+  // -(u dvar/dx + w dvar/dz) with u = -dpsi/dz and w = dpsi/dx
+  #pragma omp parallel for schedule(static)
+  for(int k=0; k<c.nZ; ++k) {
+    for(int ix=0; ix<c.nX; ++ix) {
+      nonlinearTerm.spatial(ix,k) =
+        -(-dPsidz.spatial(ix,k)*var.dfdx(ix,k) + vars.psi.dfdx(ix,k)*dVardz.spatial(ix,k));
+    }
+  }
+  nonlinearTerm.toSpectral();
+}
+
+void ChebyshevSim::computeExplicitDerivatives() {
+  computeVerticalDerivative(vars.tmp, dTmpdz);
+  computeVerticalDerivative(vars.omg, dOmgdz);
+  computeVerticalDerivative(vars.psi, dPsidz);
+  if(c.isDoubleDiffusion) {
+    computeVerticalDerivative(vars.xi, dXidz);
+  }
+
+  for(Variable *var : {&vars.tmp, &vars.omg, &vars.psi, &dTmpdz, &dOmgdz, &dPsidz}) {
+    var->toPhysical();
+  }
+  applyHorizontalBoundaryConditions(vars.tmp);
+  applyHorizontalBoundaryConditions(vars.omg);
+  applyHorizontalBoundaryConditions(vars.psi);
+  if(c.isDoubleDiffusion) {
+    vars.xi.toPhysical();
+    dXidz.toPhysical();
+    applyHorizontalBoundaryConditions(vars.xi);
+  }
+
+  computeJacobian(nonlinearCosineTerm, vars.tmp, dTmpdz);
+  computeJacobian(nonlinearSineTerm, vars.omg, dOmgdz);
+  for(int k=0; k<c.nZ; ++k) {
+    for(int n=0; n<c.nN; ++n) {
+      vars.dTmpdt(n,k) = nonlinearCosineTerm(n,k);
+      vars.dOmgdt(n,k) = nonlinearSineTerm(n,k)
+        - n*c.wavelength*c.xCosDerivativeFactor*c.Pr*c.Ra*vars.tmp(n,k);
+    }
+  }
+
+  if(c.isDoubleDiffusion) {
+    computeJacobian(nonlinearCosineTerm, vars.xi, dXidz);
+    for(int k=0; k<c.nZ; ++k) {
+      for(int n=0; n<c.nN; ++n) {
+        vars.dXidt(n,k) = nonlinearCosineTerm(n,k);
+        vars.dOmgdt(n,k) += n*c.wavelength*c.xCosDerivativeFactor*c.RaXi*c.tau*c.Pr*vars.xi(n,k);
+      }
+    }
+  }
+}
+
+void ChebyshevSim::factoriseDiffusion() {
+  // Crank-Nicolson for diffusivity kappa solves
+  // (1 - (dt kappa/2) laplacian) var_{n+1/2} = var_n + (dt/2) explicit terms
+  std::vector<real> lambda(c.nN);
+  const std::vector<std::pair<ChebyshevTauSolver*, real>> solvers = {
+    {&tmpSolver, 1.0}, {&omgSolver, c.Pr}, {&xiSolver, c.tau}};
+  for(const auto &solver : solvers) {
+    for(int n=0; n<c.nN; ++n) {
+      lambda[n] = pow(n*c.wavelength, 2) + 2.0/(dt*solver.second);
+    }
+    solver.first->factorise(lambda);
+  }
+}
+
+void ChebyshevSim::stepDiffusively(Variable &var, const Variable &dVardt,
+    const ChebyshevTauSolver &solver, const real diffusivity,
+    const std::vector<mode> &bottom, const std::vector<mode> &top, const real f) {
+  // Solves for the midpoint value, which has the same boundary values, then
+  // extrapolates to the end of the step
+  basis.toCoefficients(var, coefficients);
+
+  const real scale = -2.0/(dt*diffusivity);
+  for(int k=0; k<c.nZ; ++k) {
+    for(int n=0; n<c.nN; ++n) {
+      var(n,k) = scale*(var(n,k)
+          + 0.5*adamsBashforth(dVardt(n,k), dVardt.getPrev(n,k), f, dt));
+    }
+  }
+  basis.toCoefficients(var, derivativeCoefficients);
+
+  solver.solve(derivativeCoefficients, solutionCoefficients, bottom, top);
+
+  for(int i=0; i<basis.nCoefficients; ++i) {
+    solutionCoefficients[i] = 2.0*solutionCoefficients[i] - coefficients[i];
+  }
+  basis.toGridpoints(solutionCoefficients, var);
+}
+
+void ChebyshevSim::solveForPsi() {
+  basis.toCoefficients(vars.omg, coefficients);
+  for(int i=0; i<basis.nCoefficients; ++i) {
+    coefficients[i] = -coefficients[i];
+  }
+  psiSolver.solve(coefficients, solutionCoefficients, zeroBoundary, zeroBoundary);
+  basis.toGridpoints(solutionCoefficients, vars.psi);
+}
+
+real ChebyshevSim::checkCFL() {
+  // As checkCFL in numerical_methods, with the local vertical spacing
+  computeVerticalDerivative(vars.psi, dPsidz);
+  vars.psi.toPhysical();
+  dPsidz.toPhysical();
+  applyHorizontalBoundaryConditions(vars.psi);
+
+  real vxMax = 0.0;
+  real vzRateMax = 0.0;
+  bool isNan = false;
+
+  #pragma omp parallel for schedule(static) reduction(max:vxMax,vzRateMax) reduction(||:isNan)
+  for(int k=0; k<c.nZ; ++k) {
+    real dzLocal = std::min(
+        k > 0 ? basis.z[k] - basis.z[k-1] : 1.0,
+        k < c.nZ-1 ? basis.z[k+1] - basis.z[k] : 1.0);
+    for(int ix=0; ix<c.nX; ++ix) {
+      real vx = dPsidz.spatial(ix,k);
+      real vz = vars.psi.dfdx(ix,k);
+      isNan = isNan or std::isnan(vx) or std::isnan(vz);
+      vxMax = std::max(vxMax, std::abs(vx));
+      vzRateMax = std::max(vzRateMax, std::abs(vz)/dzLocal);
+    }
+  }
+
+  if(isNan or dt*vzRateMax > 1.0 or dt > c.dx/vxMax) {
+    cout << "CFL Condition Breached" << endl;
+    exit(-1);
+  }
+
+  return cflTimestepFactor(dt, 1.0/vzRateMax, c.dx/vxMax);
+}
+
+void ChebyshevSim::runNonLinearStep(real f) {
+  computeExplicitDerivatives();
+  stepDiffusively(vars.tmp, vars.dTmpdt, tmpSolver, 1.0, tmpBottom, tmpTop, f);
+  stepDiffusively(vars.omg, vars.dOmgdt, omgSolver, c.Pr, zeroBoundary, zeroBoundary, f);
+  if(c.isDoubleDiffusion) {
+    stepDiffusively(vars.xi, vars.dXidt, xiSolver, c.tau, xiBottom, xiTop, f);
+  }
+  vars.advanceDerivatives();
+  solveForPsi();
+}
+
+void ChebyshevSim::runNonLinear() {
+  loadInitialConditions();
+
+  real saveTime = 0;
+  real CFLCheckTime = 0;
+  real f = 1.0; // Fractional change in dt (if CFL condition being breached)
+  t = 0;
+  while (c.totalTime-t>EPSILON) {
+    if(CFLCheckTime-t < EPSILON) {
+      CFLCheckTime += 1e1*dt;
+      f = checkCFL();
+      dt *= f;
+      if(f != 1.0) {
+        factoriseDiffusion();
+      }
+    }
+    if(saveTime-t < EPSILON) {
+      cout << t << " of " << c.totalTime << "(" << t/c.totalTime*100 << "%)" << endl;
+      saveTime+=c.timeBetweenSaves;
+      save();
+    }
+    runNonLinearStep(f);
+    t+=dt;
+    f=1.0;
+  }
+  printf("%e of %e (%.2f%%)\n", t, c.totalTime, t/c.totalTime*100);
+  save();
+}
@@ -0,0 +1,103 @@
+#include <chebyshev_tau_solver.hpp>
+
+#include <cassert>
+
+ChebyshevTauSolver::ChebyshevTauSolver(const int nN_in, const int nZ_in)
+  : nN(nN_in)
+  , nZ(nZ_in)
+{
+  assert(nZ >= 4);
+  q.resize(nN*nZ);
+  wk.resize(nN*nZ);
+  upper.resize(nN*nZ);
+  sumOfTerms.resize(2*nN);
+  scaledLambda.resize(nN);
+}
+
+void ChebyshevTauSolver::factorise(const std::vector<real> &lambda) {
+  // On [-1, 1] the equation is u'' - (lambda/4) u = f/4. Writing u in terms
+  // of the coefficients of u'' gives, for m >= 2,
+  //   u_m = c_{m-2} u''_{m-2}/(4m(m-1)) - e_m u''_m/(2(m^2-1)) + e_{m+2} u''_{m+2}/(4m(m+1))
+  // with c_0 = 2 (otherwise 1) and e_m = 1 for m <= N-2 (otherwise 0), where
+  // the tau method sets u''_m = f_m/4 + (lambda/4) u_m.
+  const int N = nZ-1;
+  assert(lambda.size() == nN);
+
+  for(int n=0; n<nN; ++n) {
+    const real L = 0.25*lambda[n];
+    scaledLambda[n] = L;
+    real *qN = q.data() + n*nZ;
+    real *wkN = wk.data() + n*nZ;
+    real *upperN = upper.data() + n*nZ;
+
+    for(int parity=0; parity<2; ++parity) {
+      const int mLast = N - (N-parity)%2;
+      for(int m=mLast; m>=2; m-=2) {
+        const real lower = -(m == 2 ? 2.0 : 1.0)*L/(4.0*m*(m-1));
+        const real diagonal = 1.0 + (m <= N-2 ? L/(2.0*(m*m-1)) : 0.0);
+        upperN[m] = m+2 <= N-2 ? -L/(4.0*m*(m+1)) : 0.0;
+        const real qAbove = m+2 <= N ? qN[m+2] : 0.0;
+        wkN[m] = 1.0/(diagonal - upperN[m]*qAbove);
+        qN[m] = lower*wkN[m];
+      }
+
+      // Each coefficient is a multiple of the first of its parity when the
+      // right hand side is zero
+      real term = 1.0;
+      real sum = 1.0;
+      for(int m=parity+2; m<=N; m+=2) {
+        term *= -qN[m];
+        sum += term;
+      }
+      sumOfTerms[2*n + parity] = sum;
+    }
+  }
+}
+
+mode ChebyshevTauSolver::scaledRhs(const mode *rhs, const int n, const int m) const {
+  const int N = nZ-1;
+  mode r = (m == 2 ? 2.0 : 1.0)*rhs[(m-2)*nN + n]/(4.0*m*(m-1));
+  if(m <= N-2) {
+    r -= rhs[m*nN + n]/(2.0*(m*m-1));
+  }
+  if(m+2 <= N-2) {
+    r += rhs[(m+2)*nN + n]/(4.0*m*(m+1));
+  }
+  return 0.25*r;
+}
+
+void ChebyshevTauSolver::solve(const mode *rhs, mode *sol,
+    const std::vector<mode> &bottom, const std::vector<mode> &top) const {
+  // rhs and sol must not overlap
+  const int N = nZ-1;
+
+  #pragma omp parallel for schedule(static)
+  for(int n=0; n<nN; ++n) {
+    const real *qN = q.data() + n*nZ;
+    const real *wkN = wk.data() + n*nZ;
+    const real *upperN = upper.data() + n*nZ;
+
+    for(int parity=0; parity<2; ++parity) {
+      // Back substitution, leaving p_m in sol
+      const int mLast = N - (N-parity)%2;
+      for(int m=mLast; m>=2; m-=2) {
+        const mode pAbove = m+2 <= N ? sol[(m+2)*nN + n] : 0.0;
+        sol[m*nN + n] = (scaledRhs(rhs, n, m) - upperN[m]*pAbove)*wkN[m];
+      }
+
+      // u(1) = sum of u_m and u(-1) = sum of (-1)^m u_m
+      const mode boundarySum = 0.5*(top[n] + (parity == 0 ? 1.0 : -1.0)*bottom[n]);
+      mode particular = 0.0;
+      mode sum = 0.0;
+      for(int m=parity+2; m<=N; m+=2) {
+        particular = sol[m*nN + n] - qN[m]*particular;
+        sum += particular;
+      }
+      sol[parity*nN + n] = (boundarySum - sum)/sumOfTerms[2*n + parity];
+
+      for(int m=parity+2; m<=N; m+=2) {
+        sol[m*nN + n] -= qN[m]*sol[(m-2)*nN + n];
+      }
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#include <compact_scheme.hpp>
+
+#include <cassert>
+
+CompactScheme::CompactScheme(const int nZ_in, const real dz_in, const bool isPeriodic_in)
+  : nZ(nZ_in)
+  , oodz(1.0/dz_in)
+  , oodz2(1.0/(dz_in*dz_in))
+  , isPeriodic(isPeriodic_in)
+{
+  assert(nZ >= 6);
+  factorise(firstDerivative, 0.25, 3.0, 3.0);
+  factorise(secondDerivative, 0.1, 0.0, 0.0);
+}
+
+void CompactScheme::factorise(Factorisation &factors, const real offDiagonal,
+    const real bottomSup, const real topSub) {
+  std::vector<real> dia(nZ, 1.0);
+  std::vector<real> sup(nZ, offDiagonal);
+  factors.sub.assign(nZ, offDiagonal);
+
+  if(isPeriodic) {
+    // Sherman-Morrison with gamma = -1, as in Numerical Recipes' cyclic
+    // solver: the corners are removed by changing the first and last
+    // diagonal entries and restored by one correction vector
+    const real gamma = -1.0;
+    dia[0] -= gamma;
+    dia[nZ-1] -= offDiagonal*offDiagonal/gamma;
+    factors.cornerCoefficient = offDiagonal/gamma;
+  } else {
+    // One-sided closures
+    sup[0] = bottomSup;
+    factors.sub[nZ-2] = topSub;
+  }
+
+  factors.wk1.resize(nZ);
+  factors.wk2.resize(nZ);
+  factors.wk1[0] = 1.0/dia[0];
+  factors.wk2[0] = sup[0]*factors.wk1[0];
+  for(int k=1; k<nZ; ++k) {
+    factors.wk1[k] = 1.0/(dia[k] - factors.sub[k-1]*factors.wk2[k-1]);
+    factors.wk2[k] = sup[k]*factors.wk1[k];
+  }
+
+  if(isPeriodic) {
+    factors.correction.assign(nZ, 0.0);
+    factors.correction[0] = -1.0;
+    factors.correction[nZ-1] = offDiagonal;
+    solveTridiagonal(factors, factors.correction.data(), 1);
+    factors.correctionDenominator = 1.0 + factors.correction[0]
+      + factors.cornerCoefficient*factors.correction[nZ-1];
+  }
+}
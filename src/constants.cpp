@@ -1,8 +1,11 @@
 #include <constants.hpp>
+#include <stretched_grid.hpp>
+#include <transform_backend.hpp>
 
 #include <json.hpp>
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 #ifdef CUDA
 #include <constants_gpu.hpp>
@@ -10,7 +13,17 @@
 
 using namespace std::complex_literals;
 
-Constants::Constants() {}
+Constants::Constants() {
+  // Read by every Variable, so these need defaults
+  isCompact = false;
+  isSpectralX = false;
+  isFftFriendlyNX = false;
+  isSplitComplexKernels = false;
+  isFieldInterleaved = false;
+  transformBackend = "fftw";
+  verticalStretching = "uniform";
+  stretchingFactor = 0.0;
+}
 
 Constants::~Constants() {}
 
@@ -21,7 +34,10 @@ Constants::Constants(const std::string &input) {
 
 void Constants::calculateDerivedConstants() {
   if(not isPhysicalResSpecfified) {
-    nX = 3*nN+1;
+    nX = isSpectralX ? dealiasedNX() : 3*nN+1;
+    if(isFftFriendlyNX) {
+      nX = fftFriendlyNX(nX);
+    }
   }
 
   if(verticalBoundaryConditions_in == "dirichlet") {
@@ -69,6 +85,85 @@ void Constants::calculateDerivedConstants() {
 #endif
 }
 
+int Constants::dealiasedNX() const {
+  // Products of modes below nN reach 2nN-2. Sine and cosine transforms on
+  // nX points alias mode m onto 2(nX-1)-m and real transforms onto m-nX,
+  // whose magnitude must stay at least nN so the kept modes are exact.
+  if(horizontalBoundaryConditions_in == "periodic") {
+    return 3*nN-2;
+  }
+  return (3*nN+1)/2;
+}
+
+namespace {
+  std::vector<int> primeFactors(int n) {
+    std::vector<int> factors;
+    for(int p=2; p*p<=n; ++p) {
+      while(n%p == 0) {
+        factors.push_back(p);
+        n /= p;
+      }
+    }
+    if(n > 1) {
+      factors.push_back(n);
+    }
+    return factors;
+  }
+
+  bool hasOnlySmallFactors(const int n) {
+    for(int p : primeFactors(n)) {
+      if(p > 7) {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+int Constants::transformLength(const int nX_in) const {
+  // RODFT00 on nX-2 points and REDFT00 on nX points are both done by FFTW
+  // as a real transform of length 2(nX-1), so nX-1 sets their speed
+  if(horizontalBoundaryConditions_in == "periodic") {
+    return nX_in;
+  }
+  return nX_in-1;
+}
+
+real Constants::transformCost(const int nX_in) const {
+  // Mixed radix model: each radix p pass costs about p operations per point
+  const int length = transformLength(nX_in);
+  real cost = 0.0;
+  for(int p : primeFactors(length)) {
+    cost += p*length;
+  }
+  return cost;
+}
+
+int Constants::fftFriendlyNX(const int minimumNX) const {
+  int result = minimumNX;
+  while(not hasOnlySmallFactors(transformLength(result))) {
+    ++result;
+  }
+  return result;
+}
+
+bool Constants::isSameGridShape(const Constants &other) const {
+  // Same array sizes, FFTW plans and set of variables
+  return nZ == other.nZ
+    and nN == other.nN
+    and nX == other.nX
+    and nG == other.nG
+    and isDoubleDiffusion == other.isDoubleDiffusion
+    and verticalBoundaryConditions == other.verticalBoundaryConditions
+    and transformBackend == other.transformBackend
+    and isFieldInterleaved == other.isFieldInterleaved
+    and isCompact == other.isCompact
+    and isSpectralX == other.isSpectralX
+    and verticalStretching == other.verticalStretching
+    and stretchingFactor == other.stretchingFactor
+    and horizontalBoundaryConditions == other.horizontalBoundaryConditions;
+}
+
 void Constants::print() const {
   std::cout <<"Parameters:" << std::endl;
   std::cout << "nZ: " << nZ << std::endl;
@@ -83,6 +178,53 @@ void Constants::print() const {
   std::cout << "is nonlinear? " << isNonlinear << std::endl;
   std::cout << "is double diffusion? " << isDoubleDiffusion << std::endl;
   std::cout << "is CUDA enabled? " << isCudaEnabled << std::endl;
+  if(not isNonlinear) {
+    std::cout << "is eigenvalue solver enabled? " << isEigenvalueSolverEnabled << std::endl;
+  }
+  if(isSlabTransformEnabled) {
+    std::cout << "slab transforms enabled" << std::endl;
+  }
+  if(isFullySpectral) {
+    std::cout << "fully spectral" << std::endl;
+  }
+  if(isChebyshev) {
+    std::cout << "Chebyshev in z" << std::endl;
+  }
+  if(isCompact) {
+    std::cout << "compact differences in z" << std::endl;
+  }
+  if(isSpectralX) {
+    std::cout << "spectral x derivatives" << std::endl;
+  }
+  std::cout << "FFT length: " << transformLength(nX) << " =";
+  for(int p : primeFactors(transformLength(nX))) {
+    std::cout << " " << p;
+  }
+  std::cout << ", cost per row ~" << transformCost(nX) << std::endl;
+  const int friendlyNX = fftFriendlyNX(nX);
+  if(friendlyNX != nX) {
+    std::cout << "nX " << friendlyNX << " would make the transforms about "
+      << transformCost(nX)/transformCost(friendlyNX) << " times cheaper" << std::endl;
+  }
+  if(isSplitComplexKernels) {
+    std::cout << "split complex kernels" << std::endl;
+  }
+  if(isFieldInterleaved) {
+    std::cout << "interleaved fields" << std::endl;
+  }
+  if(transformBackend != "fftw") {
+    std::cout << "transform backend: " << transformBackend << std::endl;
+  }
+  if(verticalStretching != "uniform") {
+    std::cout << "vertical stretching: " << verticalStretching << " (" << stretchingFactor << ")" << std::endl;
+  }
+  if(warmStart) {
+    std::cout << "warm start from state cache: " << stateCacheFolder << std::endl;
+  }
+  if(ensembleSize > 1) {
+    std::cout << "ensemble size: " << ensembleSize << std::endl;
+    std::cout << "ensemble perturbation: " << ensemblePerturbation << std::endl;
+  }
   std::cout << "icFile: " << icFile << std::endl;
   std::cout << "vertical boundary conditions: " << verticalBoundaryConditions_in << std::endl;
   std::cout << "horizontal boundary conditions: " << horizontalBoundaryConditions_in << std::endl;
@@ -148,13 +290,100 @@ bool Constants::isValid() const {
     return -1;
   }
 
+  if(isFullySpectral and (verticalBoundaryConditions_in != "periodic"
+        or horizontalBoundaryConditions_in != "periodic")) {
+    std::cout << "The fully spectral solver needs periodic vertical and horizontal boundary conditions" << std::endl;
+    return false;
+  }
+
+  if(isChebyshev and verticalBoundaryConditions_in != "dirichlet") {
+    std::cout << "The Chebyshev solver needs dirichlet vertical boundary conditions" << std::endl;
+    return false;
+  }
+
+  if(isChebyshev and nZ < 4) {
+    std::cout << "The Chebyshev solver needs at least 4 vertical points" << std::endl;
+    return false;
+  }
+
+  if(isCompact and (not isNonlinear or isSlabTransformEnabled or ensembleSize > 1
+        or isFullySpectral or isChebyshev)) {
+    std::cout << "Compact differences are only available for nonlinear runs without slab transforms, ensembles or spectral z" << std::endl;
+    return false;
+  }
+
+  if(isCompact and nZ < 6) {
+    std::cout << "Compact differences need at least 6 vertical points" << std::endl;
+    return false;
+  }
+
+  if(isSpectralX and (not isNonlinear or isCudaEnabled or isSlabTransformEnabled
+        or ensembleSize > 1 or isCompact or isFullySpectral or isChebyshev)) {
+    std::cout << "Spectral x derivatives are only available for nonlinear runs without slab transforms, ensembles, compact differences or spectral z" << std::endl;
+    return false;
+  }
+
+  if(isSpectralX and nX < dealiasedNX()) {
+    std::cout << "nX (" << nX << ") should be at least " << dealiasedNX() << " to dealias the Jacobian" << std::endl;
+    return false;
+  }
+
+  if(not TransformBackend<transform_real>::isValidName(transformBackend)) {
+    std::cout << "Transform backend must be \"fftw\" or \"native\"" << std::endl;
+    return false;
+  }
+
+  if(transformBackend != "fftw" and (isCudaEnabled or ensembleSize > 1 or isFullySpectral)) {
+    std::cout << "CUDA, ensembles and fully spectral runs only have FFTW transforms" << std::endl;
+    return false;
+  }
+
+  if(isSplitComplexKernels and (isCudaEnabled or ensembleSize > 1 or isCompact
+        or isFullySpectral or isChebyshev or verticalStretching != "uniform")) {
+    std::cout << "Split complex kernels are only available for uniform finite difference grids without CUDA or ensembles" << std::endl;
+    return false;
+  }
+
+  if(isFieldInterleaved and (isCudaEnabled or ensembleSize > 1 or isCompact
+        or isFullySpectral or isChebyshev)) {
+    std::cout << "Interleaved fields are only available for finite difference runs without compact differences, CUDA or ensembles" << std::endl;
+    return false;
+  }
+
+  if(warmStart and (not isNonlinear or isCudaEnabled or ensembleSize > 1
+        or isFullySpectral or isChebyshev)) {
+    std::cout << "Warm starts are only available for single nonlinear finite difference runs without CUDA" << std::endl;
+    return false;
+  }
+
+  if(not StretchedGrid::isValidStretching(verticalStretching)) {
+    std::cout << "Vertical stretching must be \"uniform\", \"boundaries\" or \"interface\"" << std::endl;
+    return false;
+  }
+
+  if(verticalStretching != "uniform" and (verticalBoundaryConditions_in != "dirichlet"
+        or not isNonlinear or isCudaEnabled or ensembleSize > 1 or warmStart
+        or isCompact or isFullySpectral or isChebyshev)) {
+    std::cout << "Vertical stretching is only available for nonlinear finite difference runs with dirichlet vertical boundary conditions" << std::endl;
+    return false;
+  }
+
+  if(verticalStretching != "uniform" and stretchingFactor <= 0.0) {
+    std::cout << "Stretching factor (" << stretchingFactor << ") should be positive" << std::endl;
+    return false;
+  }
+
   if(saveFolder == "" or icFile == "") {
     std::cout <<"Save folder and initial conditions file should be present.\n" << std::endl;
     return -1;
   }
 
-  if(initialDt >= pow(dz,2)/4.0) {
-    std::cout << "Diffusive timescale must be lower than " << pow(dz, 2)/4.0 << std::endl;
+  real minDz = dz;
+  if(verticalStretching != "uniform") {
+    minDz = StretchedGrid(verticalStretching, stretchingFactor, nZ).minSpacing();
+  }
+  if(initialDt >= pow(minDz,2)/4.0) {
+    std::cout << "Diffusive timescale must be lower than " << pow(minDz, 2)/4.0 << std::endl;
     return -1;
   }
   return 1;
@@ -193,6 +422,102 @@ void Constants::readJson(const std::string &filePath) {
   }
   icFile = j["icFile"];
 
+  if (j.find("isEigenvalueSolverEnabled") != j.end()) {
+    isEigenvalueSolverEnabled = j["isEigenvalueSolverEnabled"];
+  } else {
+    isEigenvalueSolverEnabled = false;
+  }
+
+  if (j.find("isSlabTransformEnabled") != j.end()) {
+    isSlabTransformEnabled = j["isSlabTransformEnabled"];
+  } else {
+    isSlabTransformEnabled = false;
+  }
+
+  if (j.find("isFullySpectral") != j.end()) {
+    isFullySpectral = j["isFullySpectral"];
+  } else {
+    isFullySpectral = false;
+  }
+
+  if (j.find("isChebyshev") != j.end()) {
+    isChebyshev = j["isChebyshev"];
+  } else {
+    isChebyshev = false;
+  }
+
+  if (j.find("isCompact") != j.end()) {
+    isCompact = j["isCompact"];
+  } else {
+    isCompact = false;
+  }
+
+  if (j.find("isSpectralX") != j.end()) {
+    isSpectralX = j["isSpectralX"];
+  } else {
+    isSpectralX = false;
+  }
+
+  if (j.find("isFftFriendlyNX") != j.end()) {
+    isFftFriendlyNX = j["isFftFriendlyNX"];
+  } else {
+    isFftFriendlyNX = false;
+  }
+
+  if (j.find("isSplitComplexKernels") != j.end()) {
+    isSplitComplexKernels = j["isSplitComplexKernels"];
+  } else {
+    isSplitComplexKernels = false;
+  }
+
+  if (j.find("isFieldInterleaved") != j.end()) {
+    isFieldInterleaved = j["isFieldInterleaved"];
+  } else {
+    isFieldInterleaved = false;
+  }
+
+  if (j.find("transformBackend") != j.end()) {
+    transformBackend = j["transformBackend"];
+  } else {
+    transformBackend = "fftw";
+  }
+
+  if (j.find("verticalStretching") != j.end()) {
+    verticalStretching = j["verticalStretching"];
+  } else {
+    verticalStretching = "uniform";
+  }
+
+  if (j.find("stretchingFactor") != j.end()) {
+    stretchingFactor = j["stretchingFactor"];
+  } else {
+    stretchingFactor = 0.0;
+  }
+
+  if (j.find("warmStart") != j.end()) {
+    warmStart = j["warmStart"];
+  } else {
+    warmStart = false;
+  }
+
+  if (j.find("stateCacheFolder") != j.end()) {
+    stateCacheFolder = j["stateCacheFolder"];
+  } else {
+    stateCacheFolder = "state_cache";
+  }
+
+  if (j.find("ensembleSize") != j.end()) {
+    ensembleSize = j["ensembleSize"];
+  } else {
+    ensembleSize = 1;
+  }
+
+  if (j.find("ensemblePerturbation") != j.end()) {
+    ensemblePerturbation = j["ensemblePerturbation"];
+  } else {
+    ensemblePerturbation = 0.0;
+  }
+
   if (j.find("verticalBoundaryConditions") != j.end()) {
     verticalBoundaryConditions_in = j["verticalBoundaryConditions"];
   } else {
@@ -230,6 +555,9 @@ void Constants::writeJson(const std::string &filePath) const {
 
   j["nZ"] = nZ;
   j["nN"] = nN;
+  if(isPhysicalResSpecfified) {
+    j["nX"] = nX;
+  }
   j["initialDt"] = initialDt;
   j["Ra"] = Ra;
   j["Pr"] = Pr;
@@ -238,8 +566,49 @@ void Constants::writeJson(const std::string &filePath) const {
   j["totalTime"] = totalTime;
   j["saveFolder"] = saveFolder;
   j["isNonlinear"] = isNonlinear;
+  j["isDoubleDiffusion"] = isDoubleDiffusion;
   j["isCudaEnabled"] = isCudaEnabled;
   j["icFile"] = icFile;
+  j["isEigenvalueSolverEnabled"] = isEigenvalueSolverEnabled;
+  if(isSlabTransformEnabled) {
+    j["isSlabTransformEnabled"] = isSlabTransformEnabled;
+  }
+  if(isFullySpectral) {
+    j["isFullySpectral"] = isFullySpectral;
+  }
+  if(isChebyshev) {
+    j["isChebyshev"] = isChebyshev;
+  }
+  if(isCompact) {
+    j["isCompact"] = isCompact;
+  }
+  if(isSpectralX) {
+    j["isSpectralX"] = isSpectralX;
+  }
+  if(isFftFriendlyNX) {
+    j["isFftFriendlyNX"] = isFftFriendlyNX;
+  }
+  if(isSplitComplexKernels) {
+    j["isSplitComplexKernels"] = isSplitComplexKernels;
+  }
+  if(isFieldInterleaved) {
+    j["isFieldInterleaved"] = isFieldInterleaved;
+  }
+  if(transformBackend != "fftw") {
+    j["transformBackend"] = transformBackend;
+  }
+  if(verticalStretching != "uniform") {
+    j["verticalStretching"] = verticalStretching;
+    j["stretchingFactor"] = stretchingFactor;
+  }
+  if(warmStart) {
+    j["warmStart"] = warmStart;
+    j["stateCacheFolder"] = stateCacheFolder;
+  }
+  if(ensembleSize > 1) {
+    j["ensembleSize"] = ensembleSize;
+    j["ensemblePerturbation"] = ensemblePerturbation;
+  }
   j["verticalBoundaryConditions"] = verticalBoundaryConditions_in;
   j["horizontalBoundaryConditions"] = horizontalBoundaryConditions_in;
   if(verticalBoundaryConditions_in == "periodic") {
@@ -27,6 +27,58 @@ real CriticalRayleighChecker::calculateCriticalRayleigh() {
   }
 }
 
+bool CriticalRayleighChecker::isCriticalModeDecoupled(LinearModeSim &sim, const Variables<Variable> &initialVars,
+    const real testRa, const int nCrit) {
+  // Integrates only the critical mode, reusing sim and the initial
+  // conditions read once for every Ra
+  c.Ra = testRa;
+  c.calculateDerivedConstants();
+  sim.reset(c);
+  sim.load(initialVars);
+
+  const int k = 32;
+  real tmpPrev = std::abs(sim.tmp(0,k));
+  real omgPrev = std::abs(sim.omg(0,k));
+  real psiPrev = std::abs(sim.psi(0,k));
+
+  real logTmpPrev = 0.0, logOmgPrev = 0.0, logPsiPrev = 0.0;
+
+  real tolerance = 1e-8;
+  int steps = 0;
+  while (sim.t[0]<c.totalTime) {
+    if(steps%500 == 0) {
+      real logTmp = std::log(std::abs(sim.tmp(0,k))) - std::log(tmpPrev);
+      real logOmg = std::log(std::abs(sim.omg(0,k))) - std::log(omgPrev);
+      real logPsi = std::log(std::abs(sim.psi(0,k))) - std::log(psiPrev);
+      if(steps > 0 and
+         std::abs(logTmp - logTmpPrev)<tolerance and
+         std::abs(logOmg - logOmgPrev)<tolerance and
+         std::abs(logPsi - logPsiPrev)<tolerance) {
+        didTestFinish = false;
+        return logTmp > 0.0;
+      }
+      logTmpPrev = logTmp;
+      logOmgPrev = logOmg;
+      logPsiPrev = logPsi;
+      tmpPrev = std::abs(sim.tmp(0,k));
+      omgPrev = std::abs(sim.omg(0,k));
+      psiPrev = std::abs(sim.psi(0,k));
+    }
+    steps++;
+    sim.runStep(0);
+  }
+  didTestFinish = true;
+  return false;
+}
+
+bool CriticalRayleighChecker::isCriticalEigenvalue(LinearStabilitySolver &solver, const real testRa, const int nCrit) {
+  solver.c.Ra = testRa;
+  real growthRate = solver.calcGrowthRate(nCrit);
+  cout << "Growth rate of mode " << nCrit << " is " << growthRate << endl;
+  didTestFinish = false;
+  return growthRate > 0.0;
+}
+
 int CriticalRayleighChecker::testCriticalRayleigh() {
   real RaCrit = calculateCriticalRayleigh();
   int nCritAnalytical = calculateCriticalWavenumber();
@@ -34,17 +86,48 @@ int CriticalRayleighChecker::testCriticalRayleigh() {
   cout << "Critical mode should be " << nCritAnalytical << endl;
   cout << "And RaCrit is " << RaCrit << endl;
 
+  LinearStabilitySolver *solver = nullptr;
+  if(c.isEigenvalueSolverEnabled) {
+    // Background gradients are taken from the initial conditions, as in Sim
+    Variables<Variable> vars(c);
+    vars.load(c.icFile);
+    solver = new LinearStabilitySolver(c);
+    solver->setBackground(vars.tmp, vars.xi);
+
+    real bracket = 0.5*std::abs(RaCrit) + 1.0;
+    real RaCritNumerical = solver->findCriticalRayleigh(nCritAnalytical, RaCrit - bracket, RaCrit + bracket);
+    cout << "Numerical RaCrit is " << RaCritNumerical << endl;
+  }
+
+  // The simulation and initial conditions are shared by both tests
+#ifdef CUDA
+  SimGPU *simGPU = nullptr;
+#endif
+  LinearModeSim *modeSim = nullptr;
+  Variables<Variable> *initialVars = nullptr;
+  if(solver == nullptr and c.isCudaEnabled) {
+#ifdef CUDA
+    simGPU = new SimGPU(c);
+#endif
+  } else if(solver == nullptr) {
+    initialVars = new Variables<Variable>(c);
+    initialVars->load(c.icFile);
+    modeSim = new LinearModeSim(c, std::vector<int>(1, nCritAnalytical));
+  }
+
   // Test below calculated critical number
 
   real testRa = RaCrit - 2;
   cout << "Testing Ra = " << testRa << endl;
   bool isBelowCritical = false;
-  if(c.isCudaEnabled) {
+  if(solver != nullptr) {
+    isBelowCritical = isCriticalEigenvalue(*solver, testRa, nCritAnalytical);
+  } else if(c.isCudaEnabled) {
 #ifdef CUDA
-    isBelowCritical = isCritical<SimGPU>(testRa, nCritAnalytical);
+    isBelowCritical = isCritical(*simGPU, testRa, nCritAnalytical);
 #endif
   } else {
-    isBelowCritical = isCritical<Sim>(testRa, nCritAnalytical);
+    isBelowCritical = isCriticalModeDecoupled(*modeSim, *initialVars, testRa, nCritAnalytical);
   }
   cout << "Below this, critical = " << isBelowCritical << endl;
   if(didTestFinish) {
@@ -56,18 +139,29 @@ int CriticalRayleighChecker::testCriticalRayleigh() {
   testRa = RaCrit + 2;
   cout << "Testing Ra = " << testRa << endl;
   bool isAboveCritical = false;
-  if(c.isCudaEnabled) {
+  if(solver != nullptr) {
+    isAboveCritical = isCriticalEigenvalue(*solver, testRa, nCritAnalytical);
+  } else if(c.isCudaEnabled) {
 #ifdef CUDA
-    isAboveCritical = isCritical<SimGPU>(testRa, nCritAnalytical);
+    isAboveCritical = isCritical(*simGPU, testRa, nCritAnalytical);
 #endif
   } else {
-    isAboveCritical = isCritical<Sim>(testRa, nCritAnalytical);
+    isAboveCritical = isCriticalModeDecoupled(*modeSim, *initialVars, testRa, nCritAnalytical);
   }
   cout << "Above this, critical = " << isAboveCritical << endl;
   if(didTestFinish) {
     cout << "Total time breached." << endl;
   }
 
+  if(solver != nullptr) {
+    delete solver;
+  }
+#ifdef CUDA
+  delete simGPU;
+#endif
+  delete modeSim;
+  delete initialVars;
+
   bool success = false;
   if(c.isDoubleDiffusion) {
     success = (not isAboveCritical) and isBelowCritical;
@@ -0,0 +1,642 @@
+#ifdef USE_MPI
+
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+
+#include <distributed_sim.hpp>
+#include <precision.hpp>
+#include <boundary_conditions.hpp>
+#include <numerical_methods.hpp>
+
+using std::cout;
+using std::endl;
+
+namespace {
+  void partition(const int total, const int nParts, std::vector<int> &starts, std::vector<int> &counts) {
+    // Splits [0, total) into nParts contiguous pieces differing in size by at most one
+    starts.resize(nParts);
+    counts.resize(nParts);
+    int start = 0;
+    for(int i=0; i<nParts; ++i) {
+      counts[i] = total/nParts + (i < total%nParts ? 1 : 0);
+      starts[i] = start;
+      start += counts[i];
+    }
+  }
+
+  Constants slabConstants(const Constants &c, const int nRanks, const int rank) {
+    // Same grid spacing as the full domain, but only this rank's rows
+    std::vector<int> starts, counts;
+    partition(c.nZ, nRanks, starts, counts);
+    Constants cLocal(c);
+    cLocal.nZ = counts[rank];
+    return cLocal;
+  }
+
+  int commRank() {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    return rank;
+  }
+
+  int commSize() {
+    int nRanks;
+    MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+    return nRanks;
+  }
+}
+
+DistributedSim::DistributedSim(const Constants &c_in)
+  : c(c_in)
+  , cLocal(slabConstants(c_in, commSize(), commRank()))
+  , rank(commRank())
+  , nRanks(commSize())
+  , vars(cLocal)
+  , nonlinearSineTerm(cLocal, 1, true)
+  , nonlinearCosineTerm(cLocal, 1, false)
+  , saveNumber(0)
+{
+  dt = c.initialDt;
+  t = 0;
+
+  partition(c.nZ, nRanks, rowStarts, rowCounts);
+  partition(c.nN, nRanks, modeStarts, modeCounts);
+  kStart = rowStarts[rank];
+  nLocalZ = rowCounts[rank];
+  nStart = modeStarts[rank];
+  nLocalN = modeCounts[rank];
+
+  if(c.nZ < 2*nRanks) {
+    cout << "Each rank needs at least two rows (nZ = " << c.nZ
+      << ", " << nRanks << " ranks). Aborting." << endl;
+    MPI_Abort(MPI_COMM_WORLD, -1);
+  }
+
+  // Ranks at the edges of a dirichlet domain have no neighbour there
+  lowerRank = rank-1;
+  upperRank = rank+1;
+  if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
+    lowerRank = (rank-1+nRanks)%nRanks;
+    upperRank = (rank+1)%nRanks;
+  } else {
+    if(isBottomRank()) {
+      lowerRank = MPI_PROC_NULL;
+    }
+    if(isTopRank()) {
+      upperRank = MPI_PROC_NULL;
+    }
+  }
+
+  // The tridiagonal factorisation is for full columns
+  thomasAlgorithm = new ThomasAlgorithm(c);
+
+  slabBuffer.resize(nLocalZ*c.nN);
+  columnBuffer.resize(c.nZ*nLocalN);
+  columns.resize(c.nZ*nLocalN);
+  solution.resize(c.nZ*nLocalN);
+}
+
+bool DistributedSim::isSupported(const Constants &c) {
+  return not c.isCompact
+    and not c.isSpectralX
+    and c.verticalStretching == "uniform"
+    and not c.isFullySpectral
+    and not c.isChebyshev
+    and c.ensembleSize <= 1
+    and not c.warmStart
+    and not c.isSplitComplexKernels;
+}
+
+DistributedSim::~DistributedSim() {
+  delete thomasAlgorithm;
+}
+
+bool DistributedSim::isBottomRank() const {
+  return rank == 0;
+}
+
+bool DistributedSim::isTopRank() const {
+  return rank == nRanks-1;
+}
+
+std::vector<Variable*> DistributedSim::activeVariables() {
+  std::vector<Variable*> active = {&vars.tmp, &vars.omg};
+  if(c.isDoubleDiffusion) {
+    active.push_back(&vars.xi);
+  }
+  return active;
+}
+
+void DistributedSim::startGhostExchange(const std::vector<Variable*> &exchangeVars, const bool isSpatial, std::vector<MPI_Request> &requests) {
+  // Sends the first and last owned rows (including ghost columns) to the
+  // neighbouring ranks and receives theirs into the ghost rows
+  for(int i=0; i<exchangeVars.size(); ++i) {
+    Variable &var = *exchangeVars[i];
+    int rowBytes;
+    char *below, *first, *last, *above;
+    if(isSpatial) {
+      rowBytes = var.rowSize()*sizeof(transform_real);
+      below = reinterpret_cast<char*>(&var.spatial(-var.nG, -1));
+      first = reinterpret_cast<char*>(&var.spatial(-var.nG, 0));
+      last = reinterpret_cast<char*>(&var.spatial(-var.nG, nLocalZ-1));
+      above = reinterpret_cast<char*>(&var.spatial(-var.nG, nLocalZ));
+    } else {
+      rowBytes = var.rowSize()*sizeof(mode);
+      below = reinterpret_cast<char*>(&var(-var.nG, -1));
+      first = reinterpret_cast<char*>(&var(-var.nG, 0));
+      last = reinterpret_cast<char*>(&var(-var.nG, nLocalZ-1));
+      above = reinterpret_cast<char*>(&var(-var.nG, nLocalZ));
+    }
+
+    MPI_Request request[4];
+    MPI_Irecv(below, rowBytes, MPI_BYTE, lowerRank, 2*i, MPI_COMM_WORLD, &request[0]);
+    MPI_Irecv(above, rowBytes, MPI_BYTE, upperRank, 2*i+1, MPI_COMM_WORLD, &request[1]);
+    MPI_Isend(first, rowBytes, MPI_BYTE, lowerRank, 2*i+1, MPI_COMM_WORLD, &request[2]);
+    MPI_Isend(last, rowBytes, MPI_BYTE, upperRank, 2*i, MPI_COMM_WORLD, &request[3]);
+    requests.insert(requests.end(), request, request+4);
+  }
+}
+
+void DistributedSim::finishGhostExchange(std::vector<MPI_Request> &requests) {
+  MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+  requests.clear();
+}
+
+void DistributedSim::loadInitialConditions() {
+  // Rank 0 reads icFile one variable at a time and scatters the rows
+  std::ifstream file;
+  if(rank == 0) {
+    file.open(c.icFile, std::ios::in | std::ios::binary);
+    if(not file.is_open()) {
+      cout << "Couldn't open " << c.icFile << " for reading. Aborting." << endl;
+      MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+  }
+
+  std::vector<mode> full;
+  std::vector<mode> packed;
+  std::vector<int> byteCounts(nRanks), byteDispls(nRanks);
+  for(int s=0; s<nRanks; ++s) {
+    byteCounts[s] = rowCounts[s]*c.nN*sizeof(mode);
+    byteDispls[s] = rowStarts[s]*c.nN*sizeof(mode);
+  }
+  if(rank == 0) {
+    full.resize(c.nN*c.nZ);
+    packed.resize(c.nN*c.nZ);
+  }
+
+  for(Variable *var : vars.variableList) {
+    for(int i=0; i<var->getTotalSteps(); ++i) {
+      if(rank == 0) {
+        // Same ordering as Variable::readFromFile
+        file.read(reinterpret_cast<char*>(full.data()), full.size()*sizeof(mode));
+        for(int s=0; s<nRanks; ++s) {
+          for(int n=0; n<c.nN; ++n) {
+            for(int kk=0; kk<rowCounts[s]; ++kk) {
+              packed[rowStarts[s]*c.nN + n*rowCounts[s] + kk] = full[n*c.nZ + rowStarts[s] + kk];
+            }
+          }
+        }
+      }
+      MPI_Scatterv(packed.data(), byteCounts.data(), byteDispls.data(), MPI_BYTE,
+          slabBuffer.data(), nLocalZ*c.nN*sizeof(mode), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+      mode *data = var->getPlus(i);
+      for(int n=0; n<c.nN; ++n) {
+        for(int kk=0; kk<nLocalZ; ++kk) {
+          data[var->calcIndex(n,kk)] = slabBuffer[n*nLocalZ + kk];
+        }
+      }
+    }
+
+    // Boundary values live on the edge ranks
+    var->bottomBoundary = (*var)(0,0);
+    var->topBoundary = (*var)(0,nLocalZ-1);
+    MPI_Bcast(&var->bottomBoundary, sizeof(mode), MPI_BYTE, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&var->topBoundary, sizeof(mode), MPI_BYTE, nRanks-1, MPI_COMM_WORLD);
+  }
+}
+
+std::string DistributedSim::createSaveFilename() const {
+  // Format save number
+  char buff[10];
+  sprintf(buff, "%04d", saveNumber);
+
+  return c.saveFolder+std::string("dump")+std::string(buff)+std::string(".dat");
+}
+
+void DistributedSim::save() {
+  // Rows are gathered on rank 0 one variable at a time, so no rank ever
+  // holds the whole state
+  std::ofstream file;
+  if(rank == 0) {
+    file.open(createSaveFilename(), std::ios::out | std::ios::binary);
+    if(not file.is_open()) {
+      cout << "Couldn't open " << c.saveFolder << " for writing. Aborting." << endl;
+      MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+  }
+
+  std::vector<mode> full;
+  std::vector<mode> packed;
+  std::vector<int> byteCounts(nRanks), byteDispls(nRanks);
+  for(int s=0; s<nRanks; ++s) {
+    byteCounts[s] = rowCounts[s]*c.nN*sizeof(mode);
+    byteDispls[s] = rowStarts[s]*c.nN*sizeof(mode);
+  }
+  if(rank == 0) {
+    full.resize(c.nN*c.nZ);
+    packed.resize(c.nN*c.nZ);
+  }
+
+  for(Variable *var : vars.variableList) {
+    for(int i=0; i<var->getTotalSteps(); ++i) {
+      const mode *data = var->getPlus(i);
+      for(int n=0; n<c.nN; ++n) {
+        for(int kk=0; kk<nLocalZ; ++kk) {
+          slabBuffer[n*nLocalZ + kk] = data[var->calcIndex(n,kk)];
+        }
+      }
+      MPI_Gatherv(slabBuffer.data(), nLocalZ*c.nN*sizeof(mode), MPI_BYTE,
+          packed.data(), byteCounts.data(), byteDispls.data(), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+      if(rank == 0) {
+        // Same ordering as Variable::writeToFile
+        for(int s=0; s<nRanks; ++s) {
+          for(int n=0; n<c.nN; ++n) {
+            for(int kk=0; kk<rowCounts[s]; ++kk) {
+              full[n*c.nZ + rowStarts[s] + kk] = packed[rowStarts[s]*c.nN + n*rowCounts[s] + kk];
+            }
+          }
+        }
+        file.write(reinterpret_cast<const char*>(full.data()), full.size()*sizeof(mode));
+      }
+    }
+  }
+
+  if(rank == 0) {
+    file.close();
+  }
+  ++saveNumber;
+}
+
+void DistributedSim::computeLinearDerivatives(const int kFirst, const int kLast) {
+  // Same as Sim::computeLinearDerivatives for rows [kFirst, kLast)
+  for(int k=kFirst; k<kLast; ++k) {
+    for(int n=0; n<c.nN; ++n) {
+      vars.dTmpdt(n,k) = vars.tmp.laplacian(n,k);
+      vars.dOmgdt(n,k) = c.Pr*vars.omg.laplacian(n,k) - n*c.wavelength*c.xCosDerivativeFactor*c.Pr*c.Ra*vars.tmp(n,k);
+    }
+  }
+  if(c.isDoubleDiffusion) {
+    for(int k=kFirst; k<kLast; ++k) {
+      for(int n=0; n<c.nN; ++n) {
+        vars.dXidt(n,k) = c.tau*vars.xi.laplacian(n,k);
+        vars.dOmgdt(n,k) += n*c.wavelength*c.xCosDerivativeFactor*c.RaXi*c.tau*c.Pr*vars.xi(n,k);
+      }
+    }
+  }
+}
+
+void DistributedSim::applyPhysicalBoundaryConditions() {
+  // Horizontal boundaries of the owned rows. The vertical ghost rows come
+  // from the neighbouring ranks.
+  int nX = c.nX;
+  if(c.horizontalBoundaryConditions == BoundaryConditions::impermeable) {
+    for(int k=0; k<nLocalZ; ++k) {
+      // Non-conducting
+      vars.tmp.spatial(-1,k) = vars.tmp.spatial(1, k);
+      vars.tmp.spatial(nX,k) = vars.tmp.spatial(nX-2, k);
+
+      // Impermeable
+      vars.psi.spatial(0,k) = 0.0;
+      vars.psi.spatial(nX-1,k) = 0.0;
+
+      // Stress free
+      vars.psi.spatial(-1,k) = 2.0*vars.psi.spatial(0,k) - vars.psi.spatial(1,k);
+      vars.psi.spatial(nX,k) = 2.0*vars.psi.spatial(nX-1,k) - vars.psi.spatial(nX-2,k);
+      vars.omg.spatial(0,k) = 0.0;
+      vars.omg.spatial(nX-1,k) = 0.0;
+
+      if(c.isDoubleDiffusion) {
+        // No flux of salt
+        vars.xi.spatial(-1,k) = vars.xi.spatial(1, k);
+        vars.xi.spatial(nX,k) = vars.xi.spatial(nX-2, k);
+      }
+    }
+  } else if(c.horizontalBoundaryConditions == BoundaryConditions::periodic) {
+    for(int k=0; k<nLocalZ; ++k) {
+      vars.tmp.spatial(-1,k) = vars.tmp.spatial(nX-1, k);
+      vars.tmp.spatial(nX,k) = vars.tmp.spatial(0, k);
+
+      vars.omg.spatial(-1,k) = vars.omg.spatial(nX-1, k);
+      vars.omg.spatial(nX,k) = vars.omg.spatial(0, k);
+
+      vars.psi.spatial(-1,k) = vars.psi.spatial(nX-1, k);
+      vars.psi.spatial(nX,k) = vars.psi.spatial(0, k);
+
+      if(c.isDoubleDiffusion) {
+        vars.xi.spatial(-1,k) = vars.xi.spatial(nX-1, k);
+        vars.xi.spatial(nX,k) = vars.xi.spatial(0, k);
+      }
+    }
+  }
+}
+
+void DistributedSim::computeJacobian(Variable &nonlinearTerm, const Variable &var, const int kFirst, const int kLast) {
+  // Same stencil as Sim::computeNonlinearDerivative for rows [kFirst, kLast)
+  #pragma omp parallel for schedule(dynamic)
+  for(int k=kFirst; k<kLast; ++k) {
+    for(int ix=0; ix<var.nX; ++ix) {
+      nonlinearTerm.spatial(ix,k) =
+        -(
+            (
+             var.spatial(ix+1,k)*(-vars.psi.dfdzSpatial(ix+1,k)) -
+             var.spatial(ix-1,k)*(-vars.psi.dfdzSpatial(ix-1,k))
+            )*c.oodx*0.5 +
+            (
+             var.spatial(ix,k+1)*vars.psi.dfdx(ix,k+1) -
+             var.spatial(ix,k-1)*vars.psi.dfdx(ix,k-1)
+            )*c.oodz*0.5
+         );
+    }
+  }
+}
+
+void DistributedSim::addNonlinearTerm(Variable &dVardt, Variable &nonlinearTerm) {
+  nonlinearTerm.toSpectral();
+
+  for(int k=0; k<nLocalZ; ++k) {
+    for(int n=0; n<c.nN; ++n) {
+      dVardt(n,k) += nonlinearTerm(n,k);
+    }
+  }
+}
+
+void DistributedSim::computeNonlinearDerivatives() {
+  vars.tmp.toPhysical();
+  vars.omg.toPhysical();
+  vars.psi.toPhysical();
+  if(c.isDoubleDiffusion) {
+    vars.xi.toPhysical();
+  }
+  applyPhysicalBoundaryConditions();
+
+  std::vector<Variable*> exchangeVars = activeVariables();
+  exchangeVars.push_back(&vars.psi);
+  std::vector<MPI_Request> requests;
+  startGhostExchange(exchangeVars, true, requests);
+
+  // Temperature and vorticity use different work arrays, so the interior
+  // rows of both can be computed while the ghost rows arrive
+  computeJacobian(nonlinearCosineTerm, vars.tmp, 1, nLocalZ-1);
+  computeJacobian(nonlinearSineTerm, vars.omg, 1, nLocalZ-1);
+  finishGhostExchange(requests);
+  for(int k : {0, nLocalZ-1}) {
+    computeJacobian(nonlinearCosineTerm, vars.tmp, k, k+1);
+    computeJacobian(nonlinearSineTerm, vars.omg, k, k+1);
+  }
+
+  addNonlinearTerm(vars.dTmpdt, nonlinearCosineTerm);
+  if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
+    for(int k=0; k<nLocalZ; ++k) {
+      vars.dTmpdt(0,k) = c.temperatureGradient;
+    }
+  }
+  addNonlinearTerm(vars.dOmgdt, nonlinearSineTerm);
+
+  if(c.isDoubleDiffusion) {
+    computeJacobian(nonlinearCosineTerm, vars.xi, 0, nLocalZ);
+    addNonlinearTerm(vars.dXidt, nonlinearCosineTerm);
+    if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
+      for(int k=0; k<nLocalZ; ++k) {
+        vars.dXidt(0,k) = c.salinityGradient;
+      }
+    }
+  }
+}
+
+void DistributedSim::solveForPsi() {
+  // Transpose omega from z-slabs to whole columns of this rank's modes
+  std::vector<int> sendCounts(nRanks), sendDispls(nRanks);
+  std::vector<int> recvCounts(nRanks), recvDispls(nRanks);
+  int sendOffset = 0;
+  int recvOffset = 0;
+  for(int s=0; s<nRanks; ++s) {
+    sendCounts[s] = nLocalZ*modeCounts[s]*sizeof(mode);
+    sendDispls[s] = sendOffset;
+    sendOffset += sendCounts[s];
+    recvCounts[s] = rowCounts[s]*nLocalN*sizeof(mode);
+    recvDispls[s] = recvOffset;
+    recvOffset += recvCounts[s];
+  }
+
+  int index = 0;
+  for(int s=0; s<nRanks; ++s) {
+    for(int k=0; k<nLocalZ; ++k) {
+      for(int n=modeStarts[s]; n<modeStarts[s]+modeCounts[s]; ++n) {
+        slabBuffer[index++] = vars.omg(n,k);
+      }
+    }
+  }
+
+  MPI_Alltoallv(slabBuffer.data(), sendCounts.data(), sendDispls.data(), MPI_BYTE,
+      columnBuffer.data(), recvCounts.data(), recvDispls.data(), MPI_BYTE, MPI_COMM_WORLD);
+
+  index = 0;
+  for(int s=0; s<nRanks; ++s) {
+    for(int kk=0; kk<rowCounts[s]; ++kk) {
+      for(int nn=0; nn<nLocalN; ++nn) {
+        columns[nn*c.nZ + rowStarts[s] + kk] = columnBuffer[index++];
+      }
+    }
+  }
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int nn=0; nn<nLocalN; ++nn) {
+    thomasAlgorithm->solve(solution.data() + nn*c.nZ, columns.data() + nn*c.nZ, nStart+nn);
+  }
+
+  // And back again
+  index = 0;
+  for(int s=0; s<nRanks; ++s) {
+    for(int kk=0; kk<rowCounts[s]; ++kk) {
+      for(int nn=0; nn<nLocalN; ++nn) {
+        columnBuffer[index++] = solution[nn*c.nZ + rowStarts[s] + kk];
+      }
+    }
+  }
+
+  MPI_Alltoallv(columnBuffer.data(), recvCounts.data(), recvDispls.data(), MPI_BYTE,
+      slabBuffer.data(), sendCounts.data(), sendDispls.data(), MPI_BYTE, MPI_COMM_WORLD);
+
+  index = 0;
+  for(int s=0; s<nRanks; ++s) {
+    for(int k=0; k<nLocalZ; ++k) {
+      for(int n=modeStarts[s]; n<modeStarts[s]+modeCounts[s]; ++n) {
+        vars.psi(n,k) = slabBuffer[index++];
+      }
+    }
+  }
+}
+
+void DistributedSim::applyTemperatureBoundaryConditions() {
+  // Periodic ghost rows are exchanged when they are needed
+  if(c.verticalBoundaryConditions == BoundaryConditions::dirichlet) {
+    if(isBottomRank()) {
+      vars.tmp(0,0) = vars.tmp.bottomBoundary;
+      for(int n=1; n<c.nN; ++n) {
+        vars.tmp(n,0) = 0.0;
+      }
+    }
+    if(isTopRank()) {
+      vars.tmp(0,nLocalZ-1) = vars.tmp.topBoundary;
+      for(int n=1; n<c.nN; ++n) {
+        vars.tmp(n,nLocalZ-1) = 0.0;
+      }
+    }
+  }
+}
+
+void DistributedSim::applyXiBoundaryConditions() {
+  if(c.verticalBoundaryConditions == BoundaryConditions::dirichlet) {
+    if(isBottomRank()) {
+      vars.xi(0,0) = vars.xi.bottomBoundary;
+      for(int n=1; n<c.nN; ++n) {
+        vars.xi(n,0) = 0.0;
+      }
+    }
+    if(isTopRank()) {
+      vars.xi(0,nLocalZ-1) = vars.xi.topBoundary;
+      for(int n=1; n<c.nN; ++n) {
+        vars.xi(n,nLocalZ-1) = 0.0;
+      }
+    }
+  }
+}
+
+void DistributedSim::applyVorticityBoundaryConditions() {
+  if(c.verticalBoundaryConditions == BoundaryConditions::dirichlet) {
+    for(int n=0; n<c.nN; ++n) {
+      // Results from stress-free
+      if(isBottomRank()) {
+        vars.omg(n,0) = 0.0;
+      }
+      if(isTopRank()) {
+        vars.omg(n,nLocalZ-1) = 0.0;
+      }
+    }
+  }
+}
+
+void DistributedSim::applyPsiBoundaryConditions() {
+  if(c.verticalBoundaryConditions == BoundaryConditions::dirichlet) {
+    for(int n=0; n<c.nN; ++n) {
+      // v_z = 0 (impermeable) and d(v_x)/dz = 0 (stress-free)
+      if(isBottomRank()) {
+        vars.psi(n,0) = 0.0;
+        vars.psi(n,-1) = 2.0*vars.psi(n,0) - vars.psi(n,1);
+      }
+      if(isTopRank()) {
+        vars.psi(n,nLocalZ-1) = 0.0;
+        vars.psi(n,nLocalZ) = 2.0*vars.psi(n,nLocalZ-1) - vars.psi(n,nLocalZ-2);
+      }
+    }
+  }
+}
+
+real DistributedSim::checkCFL() {
+  // As checkCFL in numerical_methods, with the maximum velocities reduced
+  // over all ranks so every rank agrees on the timestep
+  vars.psi.toPhysical();
+  std::vector<MPI_Request> requests;
+  startGhostExchange({&vars.psi}, true, requests);
+  finishGhostExchange(requests);
+
+  real velocityMax[2] = {0.0, 0.0};
+  for(int k=0; k<nLocalZ; ++k) {
+    for(int j=0; j<c.nX; ++j) {
+      real vx = vars.psi.dfdzSpatial(j,k);
+      real vz = vars.psi.dfdx(j,k);
+      if(std::isnan(vx) or std::isnan(vz)){
+        cout << "CFL Condition Breached" << endl;
+        MPI_Abort(MPI_COMM_WORLD, -1);
+      }
+      velocityMax[0] = std::max(velocityMax[0], std::abs(vx));
+      velocityMax[1] = std::max(velocityMax[1], std::abs(vz));
+    }
+  }
+  MPI_Datatype realType = sizeof(real) == sizeof(double) ? MPI_DOUBLE : MPI_FLOAT;
+  MPI_Allreduce(MPI_IN_PLACE, velocityMax, 2, realType, MPI_MAX, MPI_COMM_WORLD);
+  real vxMax = velocityMax[0];
+  real vzMax = velocityMax[1];
+
+  if(dt > c.dz/vzMax or dt > c.dx/vxMax){
+    cout << "CFL Condition Breached" << endl;
+    MPI_Abort(MPI_COMM_WORLD, -1);
+  }
+
+  return cflTimestepFactor(dt, c.dz/vzMax, c.dx/vxMax, rank == 0);
+}
+
+void DistributedSim::runNonLinearStep(real f) {
+  // Linear terms need the spectral rows either side of the slab
+  std::vector<MPI_Request> requests;
+  startGhostExchange(activeVariables(), false, requests);
+  computeLinearDerivatives(1, nLocalZ-1);
+  finishGhostExchange(requests);
+  computeLinearDerivatives(0, 1);
+  computeLinearDerivatives(nLocalZ-1, nLocalZ);
+
+  computeNonlinearDerivatives();
+  vars.updateVars(dt, f);
+  applyTemperatureBoundaryConditions();
+  applyVorticityBoundaryConditions();
+  if(c.isDoubleDiffusion) {
+    applyXiBoundaryConditions();
+  }
+  vars.advanceDerivatives();
+  solveForPsi();
+  applyPsiBoundaryConditions();
+}
+
+void DistributedSim::runNonLinear() {
+  loadInitialConditions();
+
+  applyTemperatureBoundaryConditions();
+  applyVorticityBoundaryConditions();
+  applyPsiBoundaryConditions();
+  if(c.isDoubleDiffusion) {
+    applyXiBoundaryConditions();
+  }
+
+  real saveTime = 0;
+  real CFLCheckTime = 0;
+  real f = 1.0f; // Fractional change in dt (if CFL condition being breached)
+  t = 0;
+  while (c.totalTime-t>EPSILON) {
+    if(CFLCheckTime-t < EPSILON) {
+      CFLCheckTime += 1e1*dt;
+      f = checkCFL();
+      dt *= f;
+    }
+    if(saveTime-t < EPSILON) {
+      if(rank == 0) {
+        cout << t << " of " << c.totalTime << "(" << t/c.totalTime*100 << "%)" << endl;
+      }
+      saveTime+=c.timeBetweenSaves;
+      save();
+    }
+    runNonLinearStep(f);
+    t+=dt;
+    f=1.0f;
+  }
+  if(rank == 0) {
+    printf("%e of %e (%.2f%%)\n", t, c.totalTime, t/c.totalTime*100);
+  }
+  save();
+}
+
+#endif
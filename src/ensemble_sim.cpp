@@ -0,0 +1,539 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <random>
+#include <sys/stat.h>
+
+#include <ensemble_sim.hpp>
+#include <precision.hpp>
+#include <numerical_methods.hpp>
+#include <boundary_conditions.hpp>
+
+using std::cout;
+using std::endl;
+
+namespace {
+  std::string memberFolder(const int m) {
+    // member000, member001, ...
+    std::ostringstream folder;
+    folder << "member" << std::setw(3) << std::setfill('0') << m;
+    return folder.str();
+  }
+}
+
+EnsembleSim::EnsembleSim(const Constants &c_in, const int nMembers_in, const real perturbation_in)
+  : c(c_in)
+  , nMembers(nMembers_in)
+  , tmp(c_in, nMembers_in, 1, false)
+  , omg(c_in, nMembers_in, 1, true)
+  , psi(c_in, nMembers_in, 1, true)
+  , xi(c_in, nMembers_in, 1, false)
+  , dTmpdt(c_in, nMembers_in, 2)
+  , dOmgdt(c_in, nMembers_in, 2)
+  , dXidt(c_in, nMembers_in, 2)
+  , nonlinearSineTerm(c_in, nMembers_in, 1, true)
+  , nonlinearCosineTerm(c_in, nMembers_in, 1, false)
+  , perturbation(perturbation_in)
+  , saveNumber(0)
+{
+  dt = c.initialDt;
+  t = 0;
+
+  thomasAlgorithm = new ThomasAlgorithm(c);
+  if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
+    precalculatePeriodicCorrection();
+  }
+}
+
+EnsembleSim::~EnsembleSim() {
+  delete thomasAlgorithm;
+}
+
+void EnsembleSim::precalculatePeriodicCorrection() {
+  // The correction vector of the Sherman-Morrison periodic solve only depends
+  // on n, so it is solved once here rather than once per step per member
+  int matrixN = c.nZ-1;
+  periodicCorrection.assign(c.nN*matrixN, 0.0);
+  const real *wk1 = thomasAlgorithm->wk1;
+  const real *wk2 = thomasAlgorithm->wk2;
+  const real *sub = thomasAlgorithm->sub;
+  for(int n=0; n<c.nN; ++n) {
+    int iN = n*c.nZ;
+    real *sol2 = periodicCorrection.data() + n*matrixN;
+    for(int k=0; k<matrixN; ++k) {
+      real rhs2 = (k == 0 or k == matrixN-1) ? c.oodz2 : 0.0;
+      if(k == 0) {
+        sol2[k] = rhs2*wk1[iN];
+      } else {
+        sol2[k] = (rhs2 - sub[k-1+iN]*sol2[k-1])*wk1[k+iN];
+      }
+    }
+    for(int k=matrixN-2; k>=0; --k) {
+      sol2[k] -= wk2[k+iN]*sol2[k+1];
+    }
+  }
+}
+
+void EnsembleSim::loadInitialConditions() {
+  // Every member starts from icFile
+  for(int m=0; m<nMembers; ++m) {
+    std::ifstream file (c.icFile, std::ios::in | std::ios::binary);
+    if(file.is_open()) {
+      tmp.readMemberFromFile(file, m);
+      omg.readMemberFromFile(file, m);
+      psi.readMemberFromFile(file, m);
+      dTmpdt.readMemberFromFile(file, m);
+      dOmgdt.readMemberFromFile(file, m);
+      if(c.isDoubleDiffusion) {
+        xi.readMemberFromFile(file, m);
+        dXidt.readMemberFromFile(file, m);
+      }
+    } else {
+      cout << "Couldn't open " << c.icFile << " for reading. Aborting." << endl;
+      exit(-1);
+    }
+  }
+
+  // Members other than 0 get a reproducible perturbation of the interior
+  // temperature modes
+  std::uniform_real_distribution<real> distribution(-1.0, 1.0);
+  for(int m=1; m<nMembers; ++m) {
+    std::mt19937 generator(m);
+    for(int k=1; k<c.nZ-1; ++k) {
+      for(int n=1; n<c.nN; ++n) {
+        tmp(n,k,m) += perturbation*distribution(generator);
+      }
+    }
+  }
+}
+
+std::string EnsembleSim::createSaveFilename(const int m) const {
+  // Format member and save number
+  char buff[10];
+  sprintf(buff, "%04d", saveNumber);
+
+  return c.saveFolder+memberFolder(m)+std::string("/dump")+std::string(buff)+std::string(".dat");
+}
+
+void EnsembleSim::save() {
+  // One file per member in the same format as Variables::save
+  for(int m=0; m<nMembers; ++m) {
+    mkdir((c.saveFolder + memberFolder(m)).c_str(), 0755);
+
+    std::ofstream file (createSaveFilename(m), std::ios::out | std::ios::binary);
+    if(file.is_open()) {
+      tmp.writeMemberToFile(file, m);
+      omg.writeMemberToFile(file, m);
+      psi.writeMemberToFile(file, m);
+      dTmpdt.writeMemberToFile(file, m);
+      dOmgdt.writeMemberToFile(file, m);
+      if(c.isDoubleDiffusion) {
+        xi.writeMemberToFile(file, m);
+        dXidt.writeMemberToFile(file, m);
+      }
+    } else {
+      cout << "Couldn't open " << c.saveFolder << " for writing. Aborting." << endl;
+      exit(-1);
+    }
+    file.close();
+  }
+
+  ++saveNumber;
+}
+
+void EnsembleSim::computeLinearDerivatives() {
+  // Same as Sim::computeLinearDerivatives, vectorised over members
+  #pragma omp parallel for schedule(dynamic)
+  for(int k=0; k<c.nZ; ++k) {
+    for(int n=0; n<c.nN; ++n) {
+      real kx2 = pow(real(n)*c.wavelength, 2);
+      mode tmpFactor = -n*c.wavelength*c.xCosDerivativeFactor*c.Pr*c.Ra;
+      const mode *tmpC = tmp.members(n,k);
+      const mode *tmpU = tmp.members(n,k+1);
+      const mode *tmpD = tmp.members(n,k-1);
+      const mode *omgC = omg.members(n,k);
+      const mode *omgU = omg.members(n,k+1);
+      const mode *omgD = omg.members(n,k-1);
+      mode *dTmp = dTmpdt.members(n,k);
+      mode *dOmg = dOmgdt.members(n,k);
+      for(int m=0; m<nMembers; ++m) {
+        dTmp[m] = (tmpU[m] - 2.0*tmpC[m] + tmpD[m])*c.oodz2 - kx2*tmpC[m];
+        dOmg[m] = c.Pr*((omgU[m] - 2.0*omgC[m] + omgD[m])*c.oodz2 - kx2*omgC[m]) + tmpFactor*tmpC[m];
+      }
+
+      if(c.isDoubleDiffusion) {
+        mode xiFactor = n*c.wavelength*c.xCosDerivativeFactor*c.RaXi*c.tau*c.Pr;
+        const mode *xiC = xi.members(n,k);
+        const mode *xiU = xi.members(n,k+1);
+        const mode *xiD = xi.members(n,k-1);
+        mode *dXi = dXidt.members(n,k);
+        for(int m=0; m<nMembers; ++m) {
+          dXi[m] = c.tau*((xiU[m] - 2.0*xiC[m] + xiD[m])*c.oodz2 - kx2*xiC[m]);
+          dOmg[m] += xiFactor*xiC[m];
+        }
+      }
+    }
+  }
+}
+
+void EnsembleSim::applyPhysicalBoundaryConditions() {
+  int nX = c.nX;
+  for(int m=0; m<nMembers; ++m) {
+    if(c.horizontalBoundaryConditions == BoundaryConditions::impermeable) {
+      for(int k=0; k<c.nZ; ++k) {
+        // Non-conducting
+        tmp.spatial(-1,k,m) = tmp.spatial(1,k,m);
+        tmp.spatial(nX,k,m) = tmp.spatial(nX-2,k,m);
+
+        // Impermeable
+        psi.spatial(0,k,m) = 0.0;
+        psi.spatial(nX-1,k,m) = 0.0;
+
+        // Stress free
+        psi.spatial(-1,k,m) = 2.0*psi.spatial(0,k,m) - psi.spatial(1,k,m);
+        psi.spatial(nX,k,m) = 2.0*psi.spatial(nX-1,k,m) - psi.spatial(nX-2,k,m);
+        omg.spatial(0,k,m) = 0.0;
+        omg.spatial(nX-1,k,m) = 0.0;
+
+        if(c.isDoubleDiffusion) {
+          // No flux of salt
+          xi.spatial(-1,k,m) = xi.spatial(1,k,m);
+          xi.spatial(nX,k,m) = xi.spatial(nX-2,k,m);
+        }
+      }
+    } else if(c.horizontalBoundaryConditions == BoundaryConditions::periodic) {
+      for(int k=0; k<c.nZ; ++k) {
+        tmp.spatial(-1,k,m) = tmp.spatial(nX-1,k,m);
+        tmp.spatial(nX,k,m) = tmp.spatial(0,k,m);
+
+        omg.spatial(-1,k,m) = omg.spatial(nX-1,k,m);
+        omg.spatial(nX,k,m) = omg.spatial(0,k,m);
+
+        psi.spatial(-1,k,m) = psi.spatial(nX-1,k,m);
+        psi.spatial(nX,k,m) = psi.spatial(0,k,m);
+
+        if(c.isDoubleDiffusion) {
+          xi.spatial(-1,k,m) = xi.spatial(nX-1,k,m);
+          xi.spatial(nX,k,m) = xi.spatial(0,k,m);
+        }
+      }
+    }
+    if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
+      for(int i=0; i<nX; ++i) {
+        tmp.spatial(i,-1,m) = tmp.spatial(i,c.nZ-1,m);
+        tmp.spatial(i,c.nZ,m) = tmp.spatial(i,0,m);
+
+        omg.spatial(i,-1,m) = omg.spatial(i,c.nZ-1,m);
+        omg.spatial(i,c.nZ,m) = omg.spatial(i,0,m);
+
+        psi.spatial(i,-1,m) = psi.spatial(i,c.nZ-1,m);
+        psi.spatial(i,c.nZ,m) = psi.spatial(i,0,m);
+
+        if(c.isDoubleDiffusion) {
+          xi.spatial(i,-1,m) = xi.spatial(i,c.nZ-1,m);
+          xi.spatial(i,c.nZ,m) = xi.spatial(i,0,m);
+        }
+      }
+    }
+  }
+}
+
+void EnsembleSim::computeNonlinearDerivatives() {
+  tmp.toPhysical();
+  omg.toPhysical();
+  psi.toPhysical();
+  if(c.isDoubleDiffusion) {
+    xi.toPhysical();
+  }
+  applyPhysicalBoundaryConditions();
+
+  computeNonlinearDerivative(dTmpdt, tmp);
+  if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
+    for(int k=0; k<c.nZ; ++k) {
+      for(int m=0; m<nMembers; ++m) {
+        dTmpdt(0,k,m) = c.temperatureGradient;
+      }
+    }
+  }
+
+  computeNonlinearDerivative(dOmgdt, omg);
+
+  if(c.isDoubleDiffusion) {
+    computeNonlinearDerivative(dXidt, xi);
+    if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
+      for(int k=0; k<c.nZ; ++k) {
+        for(int m=0; m<nMembers; ++m) {
+          dXidt(0,k,m) = c.salinityGradient;
+        }
+      }
+    }
+  }
+}
+
+void EnsembleSim::computeNonlinearDerivative(EnsembleVariable &dVardt, const EnsembleVariable &var) {
+  EnsembleVariable *nonlinearTerm;
+  if(var.useSinTransform) {
+    nonlinearTerm = &nonlinearSineTerm;
+  } else {
+    nonlinearTerm = &nonlinearCosineTerm;
+  }
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int k=0; k<c.nZ; ++k) {
+    for(int ix=0; ix<c.nX; ++ix) {
+      real *out = nonlinearTerm->spatialMembers(ix,k);
+      const real *varR = var.spatialMembers(ix+1,k);
+      const real *varL = var.spatialMembers(ix-1,k);
+      const real *varU = var.spatialMembers(ix,k+1);
+      const real *varD = var.spatialMembers(ix,k-1);
+      const real *psiRU = psi.spatialMembers(ix+1,k+1);
+      const real *psiRD = psi.spatialMembers(ix+1,k-1);
+      const real *psiLU = psi.spatialMembers(ix-1,k+1);
+      const real *psiLD = psi.spatialMembers(ix-1,k-1);
+      for(int m=0; m<nMembers; ++m) {
+        out[m] =
+          -(
+              (
+               varR[m]*(-(psiRU[m] - psiRD[m])*c.oodz*0.5) -
+               varL[m]*(-(psiLU[m] - psiLD[m])*c.oodz*0.5)
+              )*c.oodx*0.5 +
+              (
+               varU[m]*((psiRU[m] - psiLU[m])*c.oodx*0.5) -
+               varD[m]*((psiRD[m] - psiLD[m])*c.oodx*0.5)
+              )*c.oodz*0.5
+           );
+      }
+    }
+  }
+
+  nonlinearTerm->toSpectral();
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int k=0; k<c.nZ; ++k) {
+    for(int n=0; n<c.nN; ++n) {
+      mode *dVar = dVardt.members(n,k);
+      const mode *term = nonlinearTerm->members(n,k);
+      for(int m=0; m<nMembers; ++m) {
+        dVar[m] += term[m];
+      }
+    }
+  }
+}
+
+void EnsembleSim::solveForPsi() {
+  // Thomas algorithm with the member loop innermost, reusing the
+  // factorisation of the single simulation solver
+  const bool isPeriodic = c.verticalBoundaryConditions == BoundaryConditions::periodic;
+  const int matrixN = isPeriodic ? c.nZ-1 : c.nZ;
+  const real *wk1 = thomasAlgorithm->wk1;
+  const real *wk2 = thomasAlgorithm->wk2;
+  const real *sub = thomasAlgorithm->sub;
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int n=0; n<c.nN; ++n) {
+    int iN = n*c.nZ;
+
+    // Forward substitution
+    mode *sol = psi.members(n,0);
+    const mode *rhs = omg.members(n,0);
+    for(int m=0; m<nMembers; ++m) {
+      sol[m] = rhs[m]*wk1[iN];
+    }
+    for(int k=1; k<matrixN; ++k) {
+      sol = psi.members(n,k);
+      rhs = omg.members(n,k);
+      const mode *solBelow = psi.members(n,k-1);
+      for(int m=0; m<nMembers; ++m) {
+        sol[m] = (rhs[m] - sub[k-1+iN]*solBelow[m])*wk1[k+iN];
+      }
+    }
+    // Backward substitution
+    for(int k=matrixN-2; k>=0; --k) {
+      sol = psi.members(n,k);
+      const mode *solAbove = psi.members(n,k+1);
+      for(int m=0; m<nMembers; ++m) {
+        sol[m] -= wk2[k+iN]*solAbove[m];
+      }
+    }
+
+    if(isPeriodic) {
+      const real *sol2 = periodicCorrection.data() + n*matrixN;
+      real a = -c.oodz2;
+      real b = pow(c.wavelength*real(n), 2) + 2*c.oodz2;
+      const mode *solFirst = psi.members(n,0);
+      const mode *solLast = psi.members(n,c.nZ-2);
+      mode *top = psi.members(n,c.nZ-1);
+      rhs = omg.members(n,c.nZ-1);
+      for(int m=0; m<nMembers; ++m) {
+        top[m] = (rhs[m] - a*solFirst[m] - a*solLast[m])/(b + a*sol2[matrixN-1] + a*sol2[0]);
+      }
+      for(int k=0; k<matrixN; ++k) {
+        sol = psi.members(n,k);
+        for(int m=0; m<nMembers; ++m) {
+          sol[m] += top[m]*sol2[k];
+        }
+      }
+    }
+  }
+}
+
+void EnsembleSim::applyTemperatureBoundaryConditions() {
+  for(int m=0; m<nMembers; ++m) {
+    if(c.verticalBoundaryConditions == BoundaryConditions::dirichlet) {
+      tmp(0,0,m) = tmp.bottomBoundary[m];
+      tmp(0,c.nZ-1,m) = tmp.topBoundary[m];
+      for(int n=1; n<c.nN; ++n) {
+        tmp(n,0,m) = 0.0;
+        tmp(n,c.nZ-1,m) = 0.0;
+      }
+    } else if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
+      for(int n=0; n<c.nN; ++n) {
+        tmp(n,-1,m) = tmp(n,c.nZ-1,m);
+        tmp(n,c.nZ,m) = tmp(n,0,m);
+      }
+    }
+  }
+}
+
+void EnsembleSim::applyXiBoundaryConditions() {
+  for(int m=0; m<nMembers; ++m) {
+    if(c.verticalBoundaryConditions == BoundaryConditions::dirichlet) {
+      xi(0,0,m) = xi.bottomBoundary[m];
+      xi(0,c.nZ-1,m) = xi.topBoundary[m];
+      for(int n=1; n<c.nN; ++n) {
+        xi(n,0,m) = 0.0;
+        xi(n,c.nZ-1,m) = 0.0;
+      }
+    } else if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
+      for(int n=0; n<c.nN; ++n) {
+        xi(n,-1,m) = xi(n,c.nZ-1,m);
+        xi(n,c.nZ,m) = xi(n,0,m);
+      }
+    }
+  }
+}
+
+void EnsembleSim::applyVorticityBoundaryConditions() {
+  for(int m=0; m<nMembers; ++m) {
+    if(c.verticalBoundaryConditions == BoundaryConditions::dirichlet) {
+      for(int n=0; n<c.nN; ++n) {
+        // Results from stress-free
+        omg(n,0,m) = 0.0;
+        omg(n,c.nZ-1,m) = 0.0;
+      }
+    } else if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
+      for(int n=0; n<c.nN; ++n) {
+        omg(n,-1,m) = omg(n,c.nZ-1,m);
+        omg(n,c.nZ,m) = omg(n,0,m);
+      }
+    }
+  }
+}
+
+void EnsembleSim::applyPsiBoundaryConditions() {
+  for(int m=0; m<nMembers; ++m) {
+    if(c.verticalBoundaryConditions == BoundaryConditions::dirichlet) {
+      for(int n=0; n<c.nN; ++n) {
+        // v_z = 0 (impermeable)
+        psi(n,0,m) = 0.0;
+        psi(n,c.nZ-1,m) = 0.0;
+
+        // d(v_x)/dz = 0 (stress-free)
+        psi(n,-1,m) = 2.0*psi(n,0,m) - psi(n,1,m);
+        psi(n,c.nZ,m) = 2.0*psi(n,c.nZ-1,m) - psi(n,c.nZ-2,m);
+      }
+    } else if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
+      for(int n=0; n<c.nN; ++n) {
+        psi(n,-1,m) = psi(n,c.nZ-1,m);
+        psi(n,c.nZ,m) = psi(n,0,m);
+      }
+    }
+  }
+}
+
+real EnsembleSim::checkCFL() {
+  // As checkCFL in numerical_methods, but the shared timestep has to satisfy
+  // the condition for the fastest member
+  real vxMax = 0.0;
+  real vzMax = 0.0;
+  bool isNan = false;
+
+  psi.toPhysical();
+
+  #pragma omp parallel for schedule(dynamic) reduction(max:vxMax,vzMax) reduction(||:isNan)
+  for(int k=0; k<c.nZ; ++k) {
+    for(int j=0; j<c.nX; ++j) {
+      for(int m=0; m<nMembers; ++m) {
+        real vx = (psi.spatial(j,k+1,m) - psi.spatial(j,k-1,m))*c.oodz*0.5;
+        real vz = (psi.spatial(j+1,k,m) - psi.spatial(j-1,k,m))*c.oodx*0.5;
+        isNan = isNan or std::isnan(vx) or std::isnan(vz);
+        vxMax = std::max(vxMax, std::abs(vx));
+        vzMax = std::max(vzMax, std::abs(vz));
+      }
+    }
+  }
+
+  if(isNan or dt > c.dz/vzMax or dt > c.dx/vxMax) {
+    cout << "CFL Condition Breached" << endl;
+    exit(-1);
+  }
+
+  return cflTimestepFactor(dt, c.dz/vzMax, c.dx/vxMax);
+}
+
+void EnsembleSim::runNonLinearStep(real f) {
+  computeLinearDerivatives();
+  computeNonlinearDerivatives();
+  tmp.update(dTmpdt, dt, f);
+  omg.update(dOmgdt, dt, f);
+  if(c.isDoubleDiffusion) {
+    xi.update(dXidt, dt, f);
+  }
+  applyTemperatureBoundaryConditions();
+  applyVorticityBoundaryConditions();
+  if(c.isDoubleDiffusion) {
+    applyXiBoundaryConditions();
+  }
+  dTmpdt.advanceTimestep();
+  dOmgdt.advanceTimestep();
+  if(c.isDoubleDiffusion) {
+    dXidt.advanceTimestep();
+  }
+  solveForPsi();
+  applyPsiBoundaryConditions();
+}
+
+void EnsembleSim::runNonLinear() {
+  loadInitialConditions();
+
+  applyTemperatureBoundaryConditions();
+  applyVorticityBoundaryConditions();
+  applyPsiBoundaryConditions();
+  if(c.isDoubleDiffusion) {
+    applyXiBoundaryConditions();
+  }
+
+  real saveTime = 0;
+  real CFLCheckTime = 0;
+  real f = 1.0; // Fractional change in dt (if CFL condition being breached)
+  t = 0;
+  while (c.totalTime-t>EPSILON) {
+    if(CFLCheckTime-t < EPSILON) {
+      CFLCheckTime += 1e1*dt;
+      f = checkCFL();
+      dt *= f;
+    }
+    if(saveTime-t < EPSILON) {
+      cout << t << " of " << c.totalTime << "(" << t/c.totalTime*100 << "%)" << endl;
+      saveTime+=c.timeBetweenSaves;
+      save();
+    }
+    runNonLinearStep(f);
+    t+=dt;
+    f=1.0;
+  }
+  printf("%e of %e (%.2f%%)\n", t, c.totalTime, t/c.totalTime*100);
+  save();
+}
@@ -0,0 +1,241 @@
+#include <ensemble_variable.hpp>
+#include <numerical_methods.hpp>
+#include <boundary_conditions.hpp>
+
+#include <cmath>
+#include <omp.h>
+
+EnsembleVariable::EnsembleVariable(const Constants &c_in, const int nMembers_in, const int totalSteps_in, const bool useSinTransform_in):
+  nN(c_in.nN),
+  nZ(c_in.nZ),
+  nX(c_in.nX),
+  nG(c_in.nG),
+  nMembers(nMembers_in),
+  useSinTransform(useSinTransform_in),
+  data(nullptr),
+  spatialData(nullptr),
+  topBoundary(nMembers_in, 0.0),
+  bottomBoundary(nMembers_in, 0.0),
+  c(c_in),
+  totalSteps(totalSteps_in),
+  current(0),
+  previous(totalSteps_in > 1 ? 1 : 0)
+{
+  data = new mode[totalSize()];
+  spatialData = new real[varSize()];
+  // Planning with FFTW_MEASURE overwrites the arrays
+  setupFFTW();
+  fill(0.0);
+}
+
+EnsembleVariable::~EnsembleVariable() {
+  // Shares the planner's state, as in FftwBackend
+  #pragma omp critical
+  {
+  FftwApi<real>::destroy_plan(fftwForwardPlan);
+  FftwApi<real>::destroy_plan(fftwBackwardPlan);
+  }
+  delete [] data;
+  delete [] spatialData;
+}
+
+void EnsembleVariable::fill(mode value) {
+  for(int i=0; i<totalSize(); ++i) {
+    data[i] = value;
+  }
+  for(int i=0; i<varSize(); ++i) {
+    spatialData[i] = value.real();
+  }
+}
+
+void EnsembleVariable::advanceTimestep() {
+  previous = current;
+  current = (current + 1)%totalSteps;
+}
+
+void EnsembleVariable::update(const EnsembleVariable& dVardt, const real dt, const real f) {
+  #pragma omp parallel for schedule(dynamic)
+  for(int k=0; k<nZ; ++k) {
+    for(int n=0; n<nN; ++n) {
+      mode *var = members(n,k);
+      const mode *dCurrent = dVardt.members(n,k);
+      const mode *dPrev = dVardt.prevMembers(n,k);
+      for(int m=0; m<nMembers; ++m) {
+        var[m] += adamsBashforth(dCurrent[m], dPrev[m], f, dt);
+      }
+    }
+  }
+}
+
+void EnsembleVariable::readMember(const Variable &var, const int m) {
+  // Copies the current step of a single simulation into member m
+  for(int k=-nG; k<nZ+nG; ++k) {
+    for(int n=-nG; n<nX+nG; ++n) {
+      (*this)(n,k,m) = var(n,k);
+    }
+  }
+  topBoundary[m] = var.topBoundary;
+  bottomBoundary[m] = var.bottomBoundary;
+}
+
+void EnsembleVariable::writeMember(Variable &var, const int m) const {
+  for(int k=-nG; k<nZ+nG; ++k) {
+    for(int n=-nG; n<nX+nG; ++n) {
+      var(n,k) = (*this)(n,k,m);
+    }
+  }
+}
+
+void EnsembleVariable::writeMemberToFile(std::ofstream& file, const int m) const {
+  // Same layout as Variable::writeToFile
+  for(int i=0; i<totalSteps; ++i) {
+    int step = (current+i)%totalSteps;
+    for(int n=0; n<nN; ++n) {
+      for(int k=0; k<nZ; ++k) {
+        file.write(reinterpret_cast<const char*>(data + step*varSize() + calcIndex(n,k) + m), sizeof(data[0]));
+      }
+    }
+  }
+}
+
+void EnsembleVariable::readMemberFromFile(std::ifstream& file, const int m) {
+  for(int i=0; i<totalSteps; ++i) {
+    int step = (current+i)%totalSteps;
+    for(int n=0; n<nN; ++n) {
+      for(int k=0; k<nZ; ++k) {
+        file.read(reinterpret_cast<char*>(data + step*varSize() + calcIndex(n,k) + m), sizeof(data[0]));
+      }
+    }
+  }
+  topBoundary[m] = (*this)(0,nZ-1,m);
+  bottomBoundary[m] = (*this)(0,0,m);
+}
+
+void EnsembleVariable::toSpectral() {
+  FftwApi<real>::execute(fftwForwardPlan);
+
+  if(c.horizontalBoundaryConditions == BoundaryConditions::impermeable) {
+    #pragma omp parallel for schedule(dynamic)
+    for(int k=0; k<nZ; ++k) {
+      mode *row = members(0,k);
+      for(int m=0; m<nMembers; ++m) {
+        row[m] /= 2.0*(nX-1.0);
+      }
+      for(int n=1; n<nX; ++n) {
+        row = members(n,k);
+        for(int m=0; m<nMembers; ++m) {
+          row[m] /= nX-1.0;
+        }
+      }
+    }
+  } else if(c.horizontalBoundaryConditions == BoundaryConditions::periodic) {
+    #pragma omp parallel for schedule(dynamic)
+    for(int k=0; k<nZ; ++k) {
+      for(int n=0; n<nX; ++n) {
+        mode *row = members(n,k);
+        for(int m=0; m<nMembers; ++m) {
+          row[m] *= 1.0/nX;
+        }
+      }
+    }
+  }
+}
+
+void EnsembleVariable::toPhysical() {
+  FftwApi<real>::execute(fftwBackwardPlan);
+
+  if(c.horizontalBoundaryConditions == BoundaryConditions::impermeable) {
+    if(useSinTransform) {
+      #pragma omp parallel for schedule(dynamic)
+      for(int k=0; k<nZ; ++k) {
+        for(int i=0; i<nX; ++i) {
+          real *row = spatialMembers(i,k);
+          for(int m=0; m<nMembers; ++m) {
+            row[m] *= 0.5;
+          }
+        }
+      }
+    } else {
+      #pragma omp parallel for schedule(dynamic)
+      for(int k=0; k<nZ; ++k) {
+        const mode *first = members(0,k);
+        const mode *last = members(nX-1,k);
+        for(int i=0; i<nX; ++i) {
+          real *row = spatialMembers(i,k);
+          real sign = (i%2 == 0) ? 1.0 : -1.0;
+          for(int m=0; m<nMembers; ++m) {
+            row[m] = (row[m] + first[m].real() + sign*last[m].real())*0.5;
+          }
+        }
+      }
+    }
+  }
+}
+
+void EnsembleVariable::setupFFTW() {
+  // Transforms run along x with stride nMembers. The howmany dimensions
+  // cover every row (z) of every member in one plan.
+  FftwApi<real>::iodim dims[1];
+  FftwApi<real>::iodim howmanyDims[2];
+  real *spatial = spatialData + calcIndex(0,0);
+  mode *spectral = data + calcIndex(0,0);
+
+  if(c.horizontalBoundaryConditions == BoundaryConditions::impermeable) {
+    FftwApi<real>::r2r_kind kind[1];
+    if(useSinTransform) {
+      kind[0] = FFTW_RODFT00;
+      dims[0].n = nX-2;
+      spatial += nMembers;
+      spectral += nMembers;
+    } else {
+      kind[0] = FFTW_REDFT00;
+      dims[0].n = nX;
+    }
+    dims[0].is = nMembers;
+    dims[0].os = 2*nMembers;
+    howmanyDims[0].n = nZ;
+    howmanyDims[0].is = rowSize()*nMembers;
+    howmanyDims[0].os = 2*rowSize()*nMembers;
+    howmanyDims[1].n = nMembers;
+    howmanyDims[1].is = 1;
+    howmanyDims[1].os = 2;
+
+    FftwApi<real>::iodim backwardDims[1] = {{dims[0].n, dims[0].os, dims[0].is}};
+    FftwApi<real>::iodim backwardHowmanyDims[2] = {
+      {howmanyDims[0].n, howmanyDims[0].os, howmanyDims[0].is},
+      {howmanyDims[1].n, howmanyDims[1].os, howmanyDims[1].is}
+    };
+
+    #pragma omp critical
+    {
+#ifdef _OPENMP
+    FftwApi<real>::plan_with_nthreads(omp_get_max_threads());
+#endif
+    fftwForwardPlan = FftwApi<real>::plan_guru_r2r(1, dims, 2, howmanyDims,
+        spatial, (real*)spectral, kind, FFTW_MEASURE);
+    fftwBackwardPlan = FftwApi<real>::plan_guru_r2r(1, backwardDims, 2, backwardHowmanyDims,
+        (real*)spectral, spatial, kind, FFTW_MEASURE);
+    }
+  } else if(c.horizontalBoundaryConditions == BoundaryConditions::periodic) {
+    dims[0].n = nX;
+    dims[0].is = nMembers;
+    dims[0].os = nMembers;
+    howmanyDims[0].n = nZ;
+    howmanyDims[0].is = rowSize()*nMembers;
+    howmanyDims[0].os = rowSize()*nMembers;
+    howmanyDims[1].n = nMembers;
+    howmanyDims[1].is = 1;
+    howmanyDims[1].os = 1;
+
+    #pragma omp critical
+    {
+#ifdef _OPENMP
+    FftwApi<real>::plan_with_nthreads(omp_get_max_threads());
+#endif
+    fftwForwardPlan = FftwApi<real>::plan_guru_dft_r2c(1, dims, 2, howmanyDims,
+        spatial, (FftwApi<real>::complex*)spectral, FFTW_MEASURE);
+    fftwBackwardPlan = FftwApi<real>::plan_guru_dft_c2r(1, dims, 2, howmanyDims,
+        (FftwApi<real>::complex*)spectral, spatial, FFTW_MEASURE | FFTW_PRESERVE_INPUT);
+    }
+  }
+}
@@ -0,0 +1,79 @@
+#include <fftw_backend.hpp>
+
+template<class T>
+FftwBackend<T>::FftwBackend(const TransformKind kind, const int n_in, const int nRows,
+    T *spatial, std::complex<T> *spectral, const int rowStride, const int nThreads) {
+  int n[] = {n_in};
+
+  if(kind == TransformKind::fourier) {
+    #pragma omp critical
+    {
+#ifdef _OPENMP
+    Fftw::plan_with_nthreads(nThreads);
+#endif
+
+    forwardPlan = Fftw::plan_many_dft_r2c(1, n, nRows,
+        spatial, nullptr, 1, rowStride,
+        (typename Fftw::complex*)spectral, nullptr, 1, rowStride,
+        FFTW_MEASURE);
+
+#ifdef _OPENMP
+    Fftw::plan_with_nthreads(nThreads);
+#endif
+
+    backwardPlan = Fftw::plan_many_dft_c2r(1, n, nRows,
+        (typename Fftw::complex*)spectral, nullptr, 1, rowStride,
+        spatial, nullptr, 1, rowStride,
+        FFTW_MEASURE | FFTW_PRESERVE_INPUT);
+    }
+  } else {
+    typename Fftw::r2r_kind r2rKind[] = {kind == TransformKind::sine ? FFTW_RODFT00 : FFTW_REDFT00};
+
+    #pragma omp critical
+    {
+#ifdef _OPENMP
+    Fftw::plan_with_nthreads(nThreads);
+#endif
+
+    forwardPlan = Fftw::plan_many_r2r(1, n, nRows,
+        spatial, nullptr, 1, rowStride,
+        (T*)spectral, nullptr, 2, 2*rowStride,
+        r2rKind, FFTW_MEASURE);
+
+#ifdef _OPENMP
+    Fftw::plan_with_nthreads(nThreads);
+#endif
+
+    backwardPlan = Fftw::plan_many_r2r(1, n, nRows,
+        (T*)spectral, nullptr, 2, 2*rowStride,
+        spatial, nullptr, 1, rowStride,
+        r2rKind, FFTW_MEASURE);
+    }
+  }
+}
+
+template<class T>
+FftwBackend<T>::~FftwBackend() {
+  // The planner's state is shared with destroy_plan, and other threads may
+  // be planning
+  #pragma omp critical
+  {
+  Fftw::destroy_plan(forwardPlan);
+  Fftw::destroy_plan(backwardPlan);
+  }
+}
+
+template<class T>
+void FftwBackend<T>::forward() {
+  Fftw::execute(forwardPlan);
+}
+
+template<class T>
+void FftwBackend<T>::backward() {
+  Fftw::execute(backwardPlan);
+}
+
+template class FftwBackend<double>;
+#if defined PRECISION_SINGLE or defined PRECISION_MIXED
+template class FftwBackend<float>;
+#endif
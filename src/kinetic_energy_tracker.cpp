@@ -9,11 +9,20 @@ KineticEnergyTracker::KineticEnergyTracker(const Constants &c_in):
   keDens.initialiseData();
 }
 
+void KineticEnergyTracker::reset(const Constants &c_in) {
+  c = c_in;
+  keDens.reparameterise(c_in);
+  kineticEnergies.clear();
+}
+
 void KineticEnergyTracker::calcKineticEnergyDensity(const Variable &psi) {
+  // Weighted by dz/ds, so that the trapezoid rule over the uniform
+  // computational grid integrates over z
   int nX = c.nX;
   for(int k=0; k<c.nZ; ++k) {
+    const real dzds = 1.0/psi.verticalMetric(k);
     for(int i=0; i<nX; ++i) {
-      keDens.spatial(i,k) = pow(psi.dfdzSpatial(i,k), 2) + pow(psi.dfdx(i,k), 2);
+      keDens.spatial(i,k) = (pow(psi.dfdzSpatial(i,k), 2) + pow(psi.dfdx(i,k), 2))*dzds;
     }
   }
 }
@@ -23,10 +32,10 @@ real KineticEnergyTracker::calcKineticEnergyForMode(const Variable &psi, int n)
   real z1 = 1.0;
   real ke = 0; // Kinetic energy
 
-  ke += pow(n*M_PI/c.aspectRatio*psi.magnitude(n,0), 2)/2.0; // f(0)/2
-  ke += pow(n*M_PI/c.aspectRatio*psi.magnitude(n,c.nZ-1), 2)/2.0; // f(1)/2
+  ke += pow(n*M_PI/c.aspectRatio*psi.magnitude(n,0), 2)/psi.verticalMetric(0)/2.0; // f(0)/2
+  ke += pow(n*M_PI/c.aspectRatio*psi.magnitude(n,c.nZ-1), 2)/psi.verticalMetric(c.nZ-1)/2.0; // f(1)/2
   for(int k=1; k<c.nZ-1; ++k) {
-    ke += pow(std::abs(psi.dfdz(n,k)), 2) + pow(n*M_PI/c.aspectRatio*psi.magnitude(n,k), 2);
+    ke += (pow(std::abs(psi.dfdz(n,k)), 2) + pow(n*M_PI/c.aspectRatio*psi.magnitude(n,k), 2))/psi.verticalMetric(k);
   }
 
   ke *= (z1-z0)*c.aspectRatio/(4*(c.nZ-1));
@@ -0,0 +1,73 @@
+#include <layout_benchmark.hpp>
+#include <sim.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+LayoutBenchmark::LayoutBenchmark(const Constants &c_in):
+  c(c_in)
+{}
+
+void LayoutBenchmark::time(const bool isFieldInterleaved, const int nRepeats,
+    real &stepTime, real &spectralTime) const {
+  Constants cLayout = c;
+  cLayout.isFieldInterleaved = isFieldInterleaved;
+  Sim sim(cLayout);
+
+  // Small enough to stay linear over the repeats
+  for(int k=0; k<c.nZ; ++k) {
+    for(int n=0; n<c.nN; ++n) {
+      sim.vars.tmp(n,k) = 1e-3/(n+1.0)*sin(M_PI*k*c.dz);
+      sim.vars.omg(n,k) = 1e-3/(n+1.0)*sin(M_PI*k*c.dz);
+      if(c.isDoubleDiffusion) {
+        sim.vars.xi(n,k) = 1e-3/(n+1.0)*sin(M_PI*k*c.dz);
+      }
+    }
+  }
+  sim.applyTemperatureBoundaryConditions();
+  sim.applyVorticityBoundaryConditions();
+  if(c.isDoubleDiffusion) {
+    sim.applyXiBoundaryConditions();
+  }
+  sim.solveForPsi();
+  sim.applyPsiBoundaryConditions();
+  sim.runNonLinearStep();
+
+  auto start = std::chrono::steady_clock::now();
+  for(int i=0; i<nRepeats; ++i) {
+    sim.runNonLinearStep();
+  }
+  auto end = std::chrono::steady_clock::now();
+  stepTime = std::chrono::duration<real, std::micro>(end - start).count()/nRepeats;
+
+  start = std::chrono::steady_clock::now();
+  for(int i=0; i<nRepeats; ++i) {
+    sim.computeLinearDerivatives();
+    sim.updateVars();
+  }
+  end = std::chrono::steady_clock::now();
+  spectralTime = std::chrono::duration<real, std::micro>(end - start).count()/nRepeats;
+}
+
+void LayoutBenchmark::run(const int nRepeats) const {
+  cout << "Layout times per call for " << c.nN << " modes on " << c.nZ << " rows (us)" << endl;
+  cout << "layout\t\tstep\tspectral" << endl;
+
+  bool fastest = false;
+  real fastestTime = INFINITY;
+  for(const bool isFieldInterleaved : {false, true}) {
+    real stepTime, spectralTime;
+    time(isFieldInterleaved, nRepeats, stepTime, spectralTime);
+    cout << (isFieldInterleaved ? "interleaved" : "separate") << "\t"
+      << stepTime << "\t" << spectralTime << endl;
+    if(stepTime < fastestTime) {
+      fastestTime = stepTime;
+      fastest = isFieldInterleaved;
+    }
+  }
+  cout << "Fastest: \"isFieldInterleaved\": " << (fastest ? "true" : "false") << endl;
+}
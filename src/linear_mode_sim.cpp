@@ -0,0 +1,191 @@
+#include <linear_mode_sim.hpp>
+#include <numerical_methods.hpp>
+#include <boundary_conditions.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+LinearModeSim::LinearModeSim(const Constants &c_in, const std::vector<int> &modes_in):
+  c(c_in),
+  modes(modes_in),
+  fieldSize(c_in.nZ + 2),
+  dTmpdz(c_in.nZ, 0.0),
+  dXidz(c_in.nZ, 0.0)
+{
+  if(c.verticalBoundaryConditions != BoundaryConditions::dirichlet) {
+    cout << "Mode-decoupled linear simulation only implemented for dirichlet vertical boundary conditions. Aborting." << endl;
+    exit(-1);
+  }
+
+  if(modes.empty()) {
+    for(int n=1; n<c.nN; ++n) {
+      modes.push_back(n);
+    }
+  }
+
+  data.resize(modes.size());
+  currentSlot.resize(modes.size(), 0);
+  for(int i=0; i<modes.size(); ++i) {
+    data[i].assign(10*fieldSize, 0.0);
+  }
+  setTimesteps();
+
+  thomasAlgorithm = new ThomasAlgorithm(c);
+}
+
+LinearModeSim::~LinearModeSim() {
+  delete thomasAlgorithm;
+}
+
+void LinearModeSim::reset(const Constants &c_in) {
+  assert(c_in.nN == c.nN and c_in.nZ == c.nZ);
+  c = c_in;
+  thomasAlgorithm->reparameterise(c);
+  setTimesteps();
+}
+
+void LinearModeSim::setTimesteps() {
+  // Explicit diffusion limits the timestep more strongly for higher modes
+  real maxDiffusivity = std::max(real(1.0), c.Pr);
+  if(c.isDoubleDiffusion) {
+    maxDiffusivity = std::max(maxDiffusivity, c.tau);
+  }
+
+  dt.resize(modes.size());
+  t.assign(modes.size(), 0.0);
+  for(int i=0; i<modes.size(); ++i) {
+    real kx = modes[i]*c.wavelength;
+    dt[i] = std::min(c.initialDt, real(0.5/(maxDiffusivity*(4.0*c.oodz2 + kx*kx))));
+  }
+}
+
+void LinearModeSim::load(const Variables<Variable> &vars) {
+  for(int k=0; k<c.nZ; ++k) {
+    dTmpdz[k] = vars.tmp.dfdz(0,k).real();
+    if(c.isDoubleDiffusion) {
+      dXidz[k] = vars.xi.dfdz(0,k).real();
+    }
+  }
+
+  for(int i=0; i<modes.size(); ++i) {
+    int n = modes[i];
+    currentSlot[i] = 0;
+    for(int k=-1; k<=c.nZ; ++k) {
+      tmp(i,k) = vars.tmp(n,k);
+      omg(i,k) = vars.omg(n,k);
+      psi(i,k) = vars.psi(n,k);
+      data[i][derivativeIndex(0, 0, k)] = vars.dTmpdt(n,k);
+      data[i][derivativeIndex(0, 1, k)] = vars.dTmpdt.getPrev(n,k);
+      data[i][derivativeIndex(1, 0, k)] = vars.dOmgdt(n,k);
+      data[i][derivativeIndex(1, 1, k)] = vars.dOmgdt.getPrev(n,k);
+      if(c.isDoubleDiffusion) {
+        xi(i,k) = vars.xi(n,k);
+        data[i][derivativeIndex(2, 0, k)] = vars.dXidt(n,k);
+        data[i][derivativeIndex(2, 1, k)] = vars.dXidt.getPrev(n,k);
+      }
+    }
+  }
+}
+
+void LinearModeSim::store(Variables<Variable> &vars) const {
+  // Derivative history is not stored, as modes may be at different times
+  for(int i=0; i<modes.size(); ++i) {
+    int n = modes[i];
+    for(int k=-1; k<=c.nZ; ++k) {
+      vars.tmp(n,k) = tmp(i,k);
+      vars.omg(n,k) = omg(i,k);
+      vars.psi(n,k) = psi(i,k);
+      if(c.isDoubleDiffusion) {
+        vars.xi(n,k) = xi(i,k);
+      }
+    }
+  }
+}
+
+void LinearModeSim::computeDerivatives(const int i) {
+  const real kx = modes[i]*c.wavelength;
+  const real kx2 = kx*kx;
+  const int s = currentSlot[i];
+  mode *dTmpdt = data[i].data() + derivativeIndex(0, s, 0);
+  mode *dOmgdt = data[i].data() + derivativeIndex(1, s, 0);
+  mode *dXidt = data[i].data() + derivativeIndex(2, s, 0);
+  const mode *T = data[i].data() + fieldIndex(0, 0);
+  const mode *O = data[i].data() + fieldIndex(1, 0);
+  const mode *P = data[i].data() + fieldIndex(2, 0);
+  const mode *X = data[i].data() + fieldIndex(3, 0);
+
+  const mode advectionFactor = -c.xSinDerivativeFactor*kx;
+  const mode buoyancyFactor = -kx*c.xCosDerivativeFactor*c.Pr*c.Ra;
+
+  for(int k=0; k<c.nZ; ++k) {
+    mode lapTmp = (T[k+1] - 2.0*T[k] + T[k-1])*c.oodz2 - kx2*T[k];
+    mode lapOmg = (O[k+1] - 2.0*O[k] + O[k-1])*c.oodz2 - kx2*O[k];
+    dTmpdt[k] = lapTmp + advectionFactor*dTmpdz[k]*P[k];
+    dOmgdt[k] = c.Pr*lapOmg + buoyancyFactor*T[k];
+  }
+
+  if(c.isDoubleDiffusion) {
+    const mode saltFactor = kx*c.xCosDerivativeFactor*c.RaXi*c.tau*c.Pr;
+    for(int k=0; k<c.nZ; ++k) {
+      mode lapXi = (X[k+1] - 2.0*X[k] + X[k-1])*c.oodz2 - kx2*X[k];
+      dXidt[k] = c.tau*lapXi + advectionFactor*dXidz[k]*P[k];
+      dOmgdt[k] += saltFactor*X[k];
+    }
+  }
+}
+
+void LinearModeSim::updateVars(const int i) {
+  const int s = currentSlot[i];
+  const int nFields = c.isDoubleDiffusion ? 3 : 2;
+  // Derivative field f advances variable field (tmp, omg, xi)
+  const int fields[] = {0, 1, 3};
+  for(int f=0; f<nFields; ++f) {
+    mode *var = data[i].data() + fieldIndex(fields[f], 0);
+    const mode *dVardt = data[i].data() + derivativeIndex(f, s, 0);
+    const mode *dVardtPrev = data[i].data() + derivativeIndex(f, 1-s, 0);
+    for(int k=0; k<c.nZ; ++k) {
+      var[k] += adamsBashforth(dVardt[k], dVardtPrev[k], 1.0, dt[i]);
+    }
+  }
+  currentSlot[i] = 1-s;
+}
+
+void LinearModeSim::applyBoundaryConditions(const int i) {
+  // Only modes n > 0 are integrated, so all boundary values are zero
+  tmp(i,0) = tmp(i,c.nZ-1) = 0.0;
+  omg(i,0) = omg(i,c.nZ-1) = 0.0;
+  if(c.isDoubleDiffusion) {
+    xi(i,0) = xi(i,c.nZ-1) = 0.0;
+  }
+}
+
+void LinearModeSim::solveForPsi(const int i) {
+  thomasAlgorithm->solve(&psi(i,0), &omg(i,0), modes[i]);
+
+  psi(i,0) = 0.0;
+  psi(i,c.nZ-1) = 0.0;
+  psi(i,-1) = 2.0*psi(i,0) - psi(i,1);
+  psi(i,c.nZ) = 2.0*psi(i,c.nZ-1) - psi(i,c.nZ-2);
+}
+
+void LinearModeSim::runStep(const int i) {
+  computeDerivatives(i);
+  updateVars(i);
+  applyBoundaryConditions(i);
+  solveForPsi(i);
+  t[i] += dt[i];
+}
+
+void LinearModeSim::run(const real totalTime) {
+  #pragma omp parallel for schedule(dynamic)
+  for(int i=0; i<modes.size(); ++i) {
+    while(totalTime - t[i] > EPSILON) {
+      runStep(i);
+    }
+  }
+}
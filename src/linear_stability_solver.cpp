@@ -0,0 +1,399 @@
+#include <linear_stability_solver.hpp>
+#include <boundary_conditions.hpp>
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+LinearStabilitySolver::LinearStabilitySolver(const Constants &c_in):
+  c(c_in),
+  shift(0.0),
+  nKrylov(60),
+  dTmpdz(c_in.nZ, 0.0),
+  dXidz(c_in.nZ, 0.0)
+{
+  if(c.verticalBoundaryConditions != BoundaryConditions::dirichlet) {
+    cout << "Linear stability solver only implemented for dirichlet vertical boundary conditions. Aborting." << endl;
+    exit(-1);
+  }
+
+  // Unknowns are stored interleaved per interior gridpoint as tmp|omg|psi|xi
+  // so that the operator is banded with bandwidth of one block
+  blockSize = c.isDoubleDiffusion ? 4 : 3;
+  nUnknowns = blockSize*(c.nZ-2);
+  kl = ku = blockSize;
+  bandWidth = 2*kl + ku + 1;
+
+  band.resize(nUnknowns*bandWidth);
+  pivots.resize(nUnknowns);
+  work.resize(nUnknowns);
+
+  setConductionBackground();
+}
+
+void LinearStabilitySolver::setConductionBackground() {
+  // Matches the linear background set up by make_initial_conditions.py
+  for(int k=0; k<c.nZ; ++k) {
+    dTmpdz[k] = -1.0;
+    dXidz[k] = 1.0;
+  }
+  if(c.isDoubleDiffusion) {
+    // Salt-fingering: stable temperature
+    for(int k=0; k<c.nZ; ++k) {
+      dTmpdz[k] = 1.0;
+    }
+  }
+}
+
+void LinearStabilitySolver::setBackground(const Variable &tmp, const Variable &xi) {
+  // Uses the same background gradient as Sim::addAdvectionApproximation
+  for(int k=1; k<c.nZ-1; ++k) {
+    dTmpdz[k] = tmp.dfdz(0,k).real();
+    if(c.isDoubleDiffusion) {
+      dXidz[k] = xi.dfdz(0,k).real();
+    }
+  }
+}
+
+inline int LinearStabilitySolver::tmpIndex(int k) const {
+  return (k-1)*blockSize;
+}
+
+inline int LinearStabilitySolver::omgIndex(int k) const {
+  return (k-1)*blockSize + 1;
+}
+
+inline int LinearStabilitySolver::psiIndex(int k) const {
+  return (k-1)*blockSize + 2;
+}
+
+inline int LinearStabilitySolver::xiIndex(int k) const {
+  return (k-1)*blockSize + 3;
+}
+
+inline mode& LinearStabilitySolver::bandEntry(int i, int j) {
+  return band[i*bandWidth + j - i + kl];
+}
+
+void LinearStabilitySolver::assembleOperator(const int n) {
+  // Forms A - shift*B where dx/dt = Ax subject to the constraint rows for psi.
+  // B is the identity except on the psi rows, where it is zero.
+  std::fill(band.begin(), band.end(), mode(0.0));
+
+  const real kx = n*c.wavelength;
+  const real kx2 = kx*kx;
+  const int nZ = c.nZ;
+
+  for(int k=1; k<nZ-1; ++k) {
+    // Temperature
+    int i = tmpIndex(k);
+    bandEntry(i, i) = -2.0*c.oodz2 - kx2 - shift;
+    if(k>1) { bandEntry(i, tmpIndex(k-1)) = c.oodz2; }
+    if(k<nZ-2) { bandEntry(i, tmpIndex(k+1)) = c.oodz2; }
+    bandEntry(i, psiIndex(k)) = -c.xSinDerivativeFactor*kx*dTmpdz[k];
+
+    // Vorticity
+    i = omgIndex(k);
+    bandEntry(i, i) = c.Pr*(-2.0*c.oodz2 - kx2) - shift;
+    if(k>1) { bandEntry(i, omgIndex(k-1)) = c.Pr*c.oodz2; }
+    if(k<nZ-2) { bandEntry(i, omgIndex(k+1)) = c.Pr*c.oodz2; }
+    bandEntry(i, tmpIndex(k)) = -kx*c.xCosDerivativeFactor*c.Pr*c.Ra;
+
+    // Stream function (constraint, matches ThomasAlgorithm)
+    i = psiIndex(k);
+    bandEntry(i, i) = kx2 + 2.0*c.oodz2;
+    if(k>1) { bandEntry(i, psiIndex(k-1)) = -c.oodz2; }
+    if(k<nZ-2) { bandEntry(i, psiIndex(k+1)) = -c.oodz2; }
+    bandEntry(i, omgIndex(k)) = -1.0;
+
+    if(c.isDoubleDiffusion) {
+      bandEntry(omgIndex(k), xiIndex(k)) = kx*c.xCosDerivativeFactor*c.RaXi*c.tau*c.Pr;
+
+      i = xiIndex(k);
+      bandEntry(i, i) = c.tau*(-2.0*c.oodz2 - kx2) - shift;
+      if(k>1) { bandEntry(i, xiIndex(k-1)) = c.tau*c.oodz2; }
+      if(k<nZ-2) { bandEntry(i, xiIndex(k+1)) = c.tau*c.oodz2; }
+      bandEntry(i, psiIndex(k)) = -c.xSinDerivativeFactor*kx*dXidz[k];
+    }
+  }
+}
+
+void LinearStabilitySolver::factorise() {
+  // Banded LU decomposition with partial pivoting. Row swaps are only applied
+  // to columns >= j, so the multipliers are applied interleaved with the swaps
+  // when solving.
+  const int N = nUnknowns;
+  for(int j=0; j<N; ++j) {
+    int iLast = std::min(N-1, j+kl);
+    int jLast = std::min(N-1, j+kl+ku);
+
+    int p = j;
+    for(int i=j+1; i<=iLast; ++i) {
+      if(std::abs(bandEntry(i,j)) > std::abs(bandEntry(p,j))) {
+        p = i;
+      }
+    }
+    pivots[j] = p;
+    if(p != j) {
+      for(int col=j; col<=jLast; ++col) {
+        std::swap(bandEntry(p,col), bandEntry(j,col));
+      }
+    }
+
+    mode pivot = bandEntry(j,j);
+    for(int i=j+1; i<=iLast; ++i) {
+      mode l = bandEntry(i,j)/pivot;
+      bandEntry(i,j) = l;
+      for(int col=j+1; col<=jLast; ++col) {
+        bandEntry(i,col) -= l*bandEntry(j,col);
+      }
+    }
+  }
+}
+
+void LinearStabilitySolver::solveFactorised(mode *x) const {
+  const int N = nUnknowns;
+  const mode *ab = band.data();
+
+  // Forward substitution
+  for(int j=0; j<N; ++j) {
+    std::swap(x[j], x[pivots[j]]);
+    for(int i=j+1; i<=std::min(N-1, j+kl); ++i) {
+      x[i] -= ab[i*bandWidth + j - i + kl]*x[j];
+    }
+  }
+
+  // Backward substitution
+  for(int i=N-1; i>=0; --i) {
+    for(int j=i+1; j<=std::min(N-1, i+kl+ku); ++j) {
+      x[i] -= ab[i*bandWidth + j - i + kl]*x[j];
+    }
+    x[i] /= ab[i*bandWidth + kl];
+  }
+}
+
+void LinearStabilitySolver::applyShiftInvert(const mode *in, mode *out) {
+  // out = (A - shift*B)^-1 B in
+  for(int i=0; i<nUnknowns; ++i) {
+    out[i] = (i%blockSize == 2) ? mode(0.0) : in[i];
+  }
+  solveFactorised(out);
+}
+
+std::vector<mode> LinearStabilitySolver::calcRitzValues() {
+  // Arnoldi iteration with modified Gram-Schmidt (applied twice)
+  const int N = nUnknowns;
+  const int m = std::min(nKrylov, N);
+  krylovBasis.resize((m+1)*N);
+  hessenberg.assign((m+1)*m, 0.0);
+
+  // Deterministic starting vector
+  real norm = 0.0;
+  for(int i=0; i<N; ++i) {
+    krylovBasis[i] = 1.0 + 0.5*std::sin(real(i));
+    norm += std::norm(krylovBasis[i]);
+  }
+  norm = std::sqrt(norm);
+  for(int i=0; i<N; ++i) {
+    krylovBasis[i] /= norm;
+  }
+
+  int mUsed = m;
+  for(int j=0; j<m; ++j) {
+    mode *w = krylovBasis.data() + (j+1)*N;
+    applyShiftInvert(krylovBasis.data() + j*N, w);
+
+    for(int pass=0; pass<2; ++pass) {
+      for(int i=0; i<=j; ++i) {
+        const mode *v = krylovBasis.data() + i*N;
+        mode h = 0.0;
+        for(int l=0; l<N; ++l) {
+          h += std::conj(v[l])*w[l];
+        }
+        for(int l=0; l<N; ++l) {
+          w[l] -= h*v[l];
+        }
+        hessenberg[i*m + j] += h;
+      }
+    }
+
+    norm = 0.0;
+    for(int l=0; l<N; ++l) {
+      norm += std::norm(w[l]);
+    }
+    norm = std::sqrt(norm);
+    if(j+1 < m) {
+      hessenberg[(j+1)*m + j] = norm;
+    }
+    if(norm < 1e-14*std::abs(hessenberg[j*m + j])) {
+      // Invariant subspace found
+      mUsed = j+1;
+      break;
+    }
+    for(int l=0; l<N; ++l) {
+      w[l] /= norm;
+    }
+  }
+
+  // Compact the leading mUsed x mUsed block
+  std::vector<mode> H(mUsed*mUsed);
+  for(int i=0; i<mUsed; ++i) {
+    for(int j=0; j<mUsed; ++j) {
+      H[i*mUsed + j] = hessenberg[i*m + j];
+    }
+  }
+  return calcHessenbergEigenvalues(H, mUsed);
+}
+
+mode LinearStabilitySolver::calcLeadingEigenvalue(const int n) {
+  assert(n > 0);
+  assembleOperator(n);
+  factorise();
+
+  std::vector<mode> mu = calcRitzValues();
+
+  // Ritz values of small magnitude are far from the shift and poorly converged
+  real muMax = 0.0;
+  for(auto m : mu) {
+    muMax = std::max(muMax, std::abs(m));
+  }
+
+  mode leading = -std::numeric_limits<real>::max();
+  for(auto m : mu) {
+    if(std::abs(m) < 1e-2*muMax) {
+      continue;
+    }
+    mode lambda = shift + 1.0/m;
+    if(lambda.real() > leading.real()) {
+      leading = lambda;
+    }
+  }
+  return leading;
+}
+
+real LinearStabilitySolver::calcGrowthRate(const int n) {
+  return calcLeadingEigenvalue(n).real();
+}
+
+real LinearStabilitySolver::findCriticalRayleigh(const int n, real RaLow, real RaHigh, const real tolerance) {
+  // Bisects on the sign of the growth rate between RaLow and RaHigh
+  const real RaInitial = c.Ra;
+
+  c.Ra = RaLow;
+  bool isLowUnstable = calcGrowthRate(n) > 0.0;
+  c.Ra = RaHigh;
+  bool isHighUnstable = calcGrowthRate(n) > 0.0;
+
+  if(isLowUnstable == isHighUnstable) {
+    cout << "Growth rate does not change sign between Ra = " << RaLow << " and " << RaHigh << endl;
+    c.Ra = RaInitial;
+    return std::nan("");
+  }
+
+  while(RaHigh - RaLow > tolerance*std::abs(RaHigh)) {
+    c.Ra = 0.5*(RaLow + RaHigh);
+    if((calcGrowthRate(n) > 0.0) == isLowUnstable) {
+      RaLow = c.Ra;
+    } else {
+      RaHigh = c.Ra;
+    }
+  }
+
+  c.Ra = RaInitial;
+  return 0.5*(RaLow + RaHigh);
+}
+
+std::vector<mode> calcHessenbergEigenvalues(std::vector<mode> H, const int m) {
+  // Shifted QR algorithm with Wilkinson shifts and deflation, operating on
+  // the active block of an upper Hessenberg matrix stored row-major.
+  std::vector<mode> eigenvalues;
+  std::vector<mode> cs(m), sn(m);
+  const real eps = std::numeric_limits<real>::epsilon();
+
+  int hi = m-1;
+  int iterations = 0;
+  while(hi >= 0) {
+    if(hi == 0) {
+      eigenvalues.push_back(H[0]);
+      break;
+    }
+
+    // Look for a negligible subdiagonal element
+    int lo = hi;
+    while(lo > 0) {
+      real scale = std::abs(H[(lo-1)*m + lo-1]) + std::abs(H[lo*m + lo]);
+      if(std::abs(H[lo*m + lo-1]) <= eps*scale) {
+        H[lo*m + lo-1] = 0.0;
+        break;
+      }
+      --lo;
+    }
+
+    if(lo == hi or iterations > 100*m) {
+      eigenvalues.push_back(H[hi*m + hi]);
+      --hi;
+      iterations = 0;
+      continue;
+    }
+    ++iterations;
+
+    // Wilkinson shift from trailing 2x2 block
+    mode a = H[(hi-1)*m + hi-1];
+    mode b = H[(hi-1)*m + hi];
+    mode cc = H[hi*m + hi-1];
+    mode d = H[hi*m + hi];
+    mode tr = 0.5*(a + d);
+    mode disc = std::sqrt(0.25*(a - d)*(a - d) + b*cc);
+    mode mu1 = tr + disc;
+    mode mu2 = tr - disc;
+    mode mu = (std::abs(mu1 - d) < std::abs(mu2 - d)) ? mu1 : mu2;
+    if(iterations%11 == 0) {
+      // Exceptional shift to break cycles
+      mu = d + std::abs(cc);
+    }
+
+    for(int i=lo; i<=hi; ++i) {
+      H[i*m + i] -= mu;
+    }
+
+    // QR via Givens rotations
+    for(int i=lo; i<hi; ++i) {
+      mode x = H[i*m + i];
+      mode y = H[(i+1)*m + i];
+      real r = std::sqrt(std::norm(x) + std::norm(y));
+      if(r == 0.0) {
+        cs[i] = 1.0;
+        sn[i] = 0.0;
+        continue;
+      }
+      cs[i] = x/r;
+      sn[i] = y/r;
+      for(int j=i; j<=hi; ++j) {
+        mode hij = H[i*m + j];
+        mode hi1j = H[(i+1)*m + j];
+        H[i*m + j] = std::conj(cs[i])*hij + std::conj(sn[i])*hi1j;
+        H[(i+1)*m + j] = -sn[i]*hij + cs[i]*hi1j;
+      }
+    }
+
+    // RQ
+    for(int i=lo; i<hi; ++i) {
+      for(int j=lo; j<=std::min(i+2, hi); ++j) {
+        mode hji = H[j*m + i];
+        mode hji1 = H[j*m + i+1];
+        H[j*m + i] = hji*cs[i] + hji1*sn[i];
+        H[j*m + i+1] = -hji*std::conj(sn[i]) + hji1*std::conj(cs[i]);
+      }
+    }
+
+    for(int i=lo; i<=hi; ++i) {
+      H[i*m + i] += mu;
+    }
+  }
+
+  return eigenvalues;
+}
@@ -6,27 +6,131 @@
 #include <precision.hpp>
 #include <variable.hpp>
 #include <critical_rayleigh_checker.hpp>
+#include <stability_sweep.hpp>
+#include <batch_runner.hpp>
+#include <transform_benchmark.hpp>
+#include <layout_benchmark.hpp>
+#include <fftw_api.hpp>
+
+#include <type_traits>
+
+#ifdef USE_MPI
+#include <mpi.h>
+#include <distributed_sim.hpp>
+#endif
 
 #define strVar(variable) #variable
 #define OMEGA 2*M_PI*4
 
+namespace {
+  // With mixed precision the x transforms use single precision FFTW, which
+  // has its own threads and wisdom, kept in wisdomFile + ".float"
+  const bool isMixedPrecision = not std::is_same<real, transform_real>::value;
+
+  void importWisdom(const std::string &wisdomFile) {
+    FftwApi<real>::import_wisdom_from_filename(wisdomFile.c_str());
+    if(isMixedPrecision) {
+      FftwApi<transform_real>::import_wisdom_from_filename((wisdomFile + ".float").c_str());
+    }
+  }
+
+  void exportWisdom(const std::string &wisdomFile) {
+    FftwApi<real>::export_wisdom_to_filename(wisdomFile.c_str());
+    if(isMixedPrecision) {
+      FftwApi<transform_real>::export_wisdom_to_filename((wisdomFile + ".float").c_str());
+    }
+  }
+
+  void initThreads() {
+#ifdef _OPENMP
+    FftwApi<real>::init_threads();
+    if(isMixedPrecision) {
+      FftwApi<transform_real>::init_threads();
+    }
+#endif
+  }
+
+  void cleanupThreads() {
+#ifdef _OPENMP
+    FftwApi<real>::cleanup_threads();
+    if(isMixedPrecision) {
+      FftwApi<transform_real>::cleanup_threads();
+    }
+#endif
+  }
+}
+
 using namespace std;
 
 int main(int argc, char** argv) {
+  int rank = 0;
+#ifdef USE_MPI
+  int nRanks = 1;
+  int threadSupport;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threadSupport);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+#endif
+
   cout <<"STARTING SIMULATION\n" << endl;
 
-#ifdef _OPENMP
-  fftw_init_threads();
-#endif
+  initThreads();
 
   std::string constantsFile = "";
+  std::string sweepFile = "";
+  std::string batchPath = "";
+  std::string wisdomFile = "";
+  std::string summaryFile = "batch_summary.dat";
+  int threadsPerRun = 1;
+  int benchmarkRepeats = 0;
+  int layoutBenchmarkRepeats = 0;
   for (int i = 1; i < argc; ++i) {
     std::string arg = argv[i];
     if (arg == "--constants") {
       constantsFile = argv[++i];
+    } else if (arg == "--sweep") {
+      sweepFile = argv[++i];
+    } else if (arg == "--batch") {
+      batchPath = argv[++i];
+    } else if (arg == "--threads-per-run") {
+      threadsPerRun = std::stoi(argv[++i]);
+    } else if (arg == "--wisdom") {
+      wisdomFile = argv[++i];
+    } else if (arg == "--summary") {
+      summaryFile = argv[++i];
+    } else if (arg == "--benchmark-transforms") {
+      benchmarkRepeats = std::stoi(argv[++i]);
+    } else if (arg == "--benchmark-layouts") {
+      layoutBenchmarkRepeats = std::stoi(argv[++i]);
     }
   }
 
+  if(wisdomFile != "") {
+    // Plans measured by previous processes
+    importWisdom(wisdomFile);
+  }
+
+  if(batchPath != "") {
+    BatchRunner batch(batchPath, threadsPerRun);
+#ifdef USE_MPI
+    int nFailed = batch.runDistributed();
+#else
+    int nFailed = batch.run();
+#endif
+    if(rank == 0) {
+      batch.writeSummary(summaryFile);
+    }
+    if(wisdomFile != "" and rank == 0) {
+      exportWisdom(wisdomFile);
+    }
+    cleanupThreads();
+#ifdef USE_MPI
+    MPI_Finalize();
+#endif
+    cout << "ENDING SIMULATION" << endl;
+    return nFailed == 0 ? 0 : -1;
+  }
+
   if(constantsFile == "") {
     std::cout << "No constants file found. Aborting." << std::endl;
     return -1;
@@ -46,25 +150,61 @@ int main(int argc, char** argv) {
   }
 #endif
 
-  if(c.isNonlinear) {
-    cout << "NONLINEAR" << endl;
-    if(c.isCudaEnabled) {
-#ifdef CUDA
-      SimGPU simulation(c);
-      simulation.runNonLinear();
+#ifdef USE_MPI
+  const bool isDistributed = c.isNonlinear and nRanks > 1 and DistributedSim::isSupported(c);
+  if(c.isNonlinear and nRanks > 1 and not isDistributed and rank == 0) {
+    cout << "Some options aren't implemented for distributed runs, so only rank 0 runs the simulation" << endl;
+  }
+#endif
+
+  if(benchmarkRepeats > 0) {
+    if(rank == 0) {
+      cout << "TRANSFORM BENCHMARK" << endl;
+      TransformBenchmark benchmark(c);
+      benchmark.run(benchmarkRepeats);
+    }
+  } else if(layoutBenchmarkRepeats > 0) {
+    if(rank == 0) {
+      cout << "LAYOUT BENCHMARK" << endl;
+      LayoutBenchmark benchmark(c);
+      benchmark.run(layoutBenchmarkRepeats);
+    }
+  } else if(sweepFile != "") {
+    cout << "LINEAR STABILITY SWEEP" << endl;
+    StabilitySweep sweep(c, sweepFile);
+#ifdef USE_MPI
+    sweep.runDistributed();
+#else
+    sweep.run();
 #endif
-    } else {
-      Sim simulation(c);
-      simulation.runNonLinear();
+#ifdef USE_MPI
+  } else if(isDistributed) {
+    if(rank == 0) {
+      cout << "NONLINEAR DISTRIBUTED OVER " << nRanks << " RANKS" << endl;
     }
+    DistributedSim simulation(c);
+    simulation.runNonLinear();
+#endif
+  } else if(rank != 0) {
+    // Other single simulations only run on the first rank
+  } else if(c.isNonlinear) {
+    cout << "NONLINEAR" << endl;
+    Sim *sim = nullptr;
+    BatchRunner::runNonLinear(c, sim);
+    delete sim;
   } else {
     cout << "LINEAR" << endl;
     CriticalRayleighChecker crChecker(c);
     crChecker.testCriticalRayleigh();
   }
 
-#ifdef _OPENMP
-  fftw_cleanup_threads();
+  if(wisdomFile != "" and rank == 0) {
+    exportWisdom(wisdomFile);
+  }
+
+  cleanupThreads();
+#ifdef USE_MPI
+  MPI_Finalize();
 #endif
 
   cout << "ENDING SIMULATION" << endl;
@@ -0,0 +1,99 @@
+#ifdef USE_MPI
+
+#include <mpi_work_queue.hpp>
+
+#include <mpi.h>
+
+namespace {
+  const int finishedTag = 1;
+  const int resultTag = 2;
+  const int taskTag = 3;
+}
+
+MpiWorkQueue::MpiWorkQueue(const int nTasks_in, const int nResults_in):
+  nTasks(nTasks_in),
+  nResults(nResults_in)
+{
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+}
+
+bool MpiWorkQueue::isRoot() const {
+  return rank == 0;
+}
+
+bool MpiWorkQueue::isRunningTasks() const {
+  return nRanks == 1 or not isRoot();
+}
+
+void MpiWorkQueue::run(std::function<void(int, real*)> task) {
+  if(isRoot()) {
+    results.assign(nTasks*nResults, 0.0);
+    taskRanks.assign(nTasks, 0);
+  }
+
+  if(nRanks == 1) {
+    for(int i=0; i<nTasks; ++i) {
+      task(i, results.data() + i*nResults);
+    }
+  } else if(isRoot()) {
+    runMaster();
+  } else {
+    runWorker(task);
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+}
+
+void MpiWorkQueue::runMaster() {
+  // Each request from a worker carries the index of the task it finished
+  // (-1 for its first request), followed by that task's results
+  std::vector<real> buffer(nResults);
+  int nextTask = 0;
+  int nActiveWorkers = nRanks-1;
+  while(nActiveWorkers > 0) {
+    MPI_Status status;
+    int finishedTask;
+    MPI_Recv(&finishedTask, 1, MPI_INT, MPI_ANY_SOURCE, finishedTag, MPI_COMM_WORLD, &status);
+
+    if(finishedTask >= 0) {
+      MPI_Recv(buffer.data(), nResults*sizeof(real), MPI_BYTE,
+          status.MPI_SOURCE, resultTag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      for(int j=0; j<nResults; ++j) {
+        results[finishedTask*nResults + j] = buffer[j];
+      }
+      taskRanks[finishedTask] = status.MPI_SOURCE;
+    }
+
+    int assignedTask = -1;
+    if(nextTask < nTasks) {
+      assignedTask = nextTask++;
+    } else {
+      --nActiveWorkers;
+    }
+    MPI_Send(&assignedTask, 1, MPI_INT, status.MPI_SOURCE, taskTag, MPI_COMM_WORLD);
+  }
+}
+
+void MpiWorkQueue::runWorker(std::function<void(int, real*)> task) {
+  std::vector<real> buffer(nResults, 0.0);
+  int finishedTask = -1;
+  while(true) {
+    MPI_Send(&finishedTask, 1, MPI_INT, 0, finishedTag, MPI_COMM_WORLD);
+    if(finishedTask >= 0) {
+      MPI_Send(buffer.data(), nResults*sizeof(real), MPI_BYTE,
+          0, resultTag, MPI_COMM_WORLD);
+    }
+
+    int assignedTask;
+    MPI_Recv(&assignedTask, 1, MPI_INT, 0, taskTag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    if(assignedTask < 0) {
+      break;
+    }
+
+    task(assignedTask, buffer.data());
+    finishedTask = assignedTask;
+  }
+}
+
+#endif
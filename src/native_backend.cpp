@@ -0,0 +1,207 @@
+#include <native_backend.hpp>
+
+#include <cmath>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+  int extendedLength(const TransformKind kind, const int n) {
+    if(kind == TransformKind::sine) {
+      return 2*(n+1);
+    } else if(kind == TransformKind::cosine) {
+      return 2*(n-1);
+    }
+    return n;
+  }
+}
+
+template<class T>
+NativeBackend<T>::NativeBackend(const TransformKind kind_in, const int n_in, const int nRows_in,
+    T *spatial_in, Complex *spectral_in, const int rowStride_in, const int nThreads_in)
+  : kind(kind_in)
+  , n(n_in)
+  , nRows(nRows_in)
+  , spatial(spatial_in)
+  , spectral(spectral_in)
+  , rowStride(rowStride_in)
+  , nThreads(nThreads_in)
+  , M(extendedLength(kind_in, n_in))
+  , isPacked(M%2 == 0)
+  , fft(isPacked ? M/2 : M)
+{
+  if(isPacked) {
+    packingTwiddles.resize(M/2+1);
+    for(int k=0; k<=M/2; ++k) {
+      const double phase = -2.0*M_PI*k/M;
+      packingTwiddles[k] = Complex(cos(phase), sin(phase));
+    }
+  }
+  scratch.resize(nThreads*4*(M+2));
+}
+
+template<class T>
+void NativeBackend<T>::realForward(const T *x, Complex *Y, Complex *work) const {
+  Complex *in = work;
+  Complex *out = work + M+2;
+  if(isPacked) {
+    // Even and odd points as the real and imaginary parts of half the length
+    const int L = M/2;
+    for(int m=0; m<L; ++m) {
+      in[m] = Complex(x[2*m], x[2*m+1]);
+    }
+    fft.forward(in, out);
+    for(int k=0; k<=L; ++k) {
+      const Complex Z = out[k%L];
+      const Complex Zc = std::conj(out[(L-k)%L]);
+      const Complex even = T(0.5)*(Z + Zc);
+      const Complex odd = Complex(0.0, -0.5)*(Z - Zc);
+      Y[k] = even + packingTwiddles[k]*odd;
+    }
+  } else {
+    for(int j=0; j<M; ++j) {
+      in[j] = x[j];
+    }
+    fft.forward(in, out);
+    for(int k=0; k<=M/2; ++k) {
+      Y[k] = out[k];
+    }
+  }
+}
+
+template<class T>
+void NativeBackend<T>::realBackward(const Complex *Y, T *x, Complex *work) const {
+  // The inverse is the conjugate of the forward FFT of the conjugate. As
+  // in FFTW, the imaginary parts of the zero and Nyquist modes are ignored.
+  Complex *in = work;
+  Complex *out = work + M+2;
+  if(isPacked) {
+    const int L = M/2;
+    for(int k=0; k<L; ++k) {
+      const Complex X = k == 0 ? Complex(Y[0].real()) : Y[k];
+      const Complex Xc = k == 0 ? Complex(Y[L].real()) : std::conj(Y[L-k]);
+      const Complex even = T(0.5)*(X + Xc);
+      const Complex odd = T(0.5)*(X - Xc)*std::conj(packingTwiddles[k]);
+      in[k] = std::conj(even + Complex(0.0, 1.0)*odd);
+    }
+    fft.forward(in, out);
+    for(int m=0; m<L; ++m) {
+      x[2*m] = 2.0*out[m].real();
+      x[2*m+1] = -2.0*out[m].imag();
+    }
+  } else {
+    in[0] = Y[0].real();
+    for(int k=1; k<=M/2; ++k) {
+      in[k] = std::conj(Y[k]);
+      in[M-k] = Y[k];
+    }
+    fft.forward(in, out);
+    for(int j=0; j<M; ++j) {
+      x[j] = out[j].real();
+    }
+  }
+}
+
+template<class T>
+void NativeBackend<T>::forwardRow(const int row, Complex *work) {
+  T *x = spatial + row*rowStride;
+  Complex *Y = work + 2*(M+2);
+  T *z = reinterpret_cast<T*>(work + 3*(M+2));
+  // Spectral values are the real parts of the modes
+  T *result = reinterpret_cast<T*>(spectral + row*rowStride);
+
+  if(kind == TransformKind::sine) {
+    const int N = n+1;
+    z[0] = 0.0;
+    z[N] = 0.0;
+    for(int j=1; j<N; ++j) {
+      z[j] = x[j-1];
+      z[M-j] = -x[j-1];
+    }
+    realForward(z, Y, work);
+    for(int k=1; k<N; ++k) {
+      result[2*(k-1)] = -Y[k].imag();
+    }
+  } else if(kind == TransformKind::cosine) {
+    const int N = n-1;
+    for(int j=0; j<=N; ++j) {
+      z[j] = x[j];
+    }
+    for(int j=1; j<N; ++j) {
+      z[M-j] = x[j];
+    }
+    realForward(z, Y, work);
+    for(int k=0; k<=N; ++k) {
+      result[2*k] = Y[k].real();
+    }
+  } else {
+    realForward(x, spectral + row*rowStride, work);
+  }
+}
+
+template<class T>
+void NativeBackend<T>::backwardRow(const int row, Complex *work) {
+  // RODFT00 and REDFT00 are their own inverses, up to normalisation
+  const T *values = reinterpret_cast<const T*>(spectral + row*rowStride);
+  T *x = spatial + row*rowStride;
+  Complex *Y = work + 2*(M+2);
+  T *z = reinterpret_cast<T*>(work + 3*(M+2));
+
+  if(kind == TransformKind::sine) {
+    const int N = n+1;
+    z[0] = 0.0;
+    z[N] = 0.0;
+    for(int j=1; j<N; ++j) {
+      z[j] = values[2*(j-1)];
+      z[M-j] = -values[2*(j-1)];
+    }
+    realForward(z, Y, work);
+    for(int k=1; k<N; ++k) {
+      x[k-1] = -Y[k].imag();
+    }
+  } else if(kind == TransformKind::cosine) {
+    const int N = n-1;
+    for(int j=0; j<=N; ++j) {
+      z[j] = values[2*j];
+    }
+    for(int j=1; j<N; ++j) {
+      z[M-j] = values[2*j];
+    }
+    realForward(z, Y, work);
+    for(int k=0; k<=N; ++k) {
+      x[k] = Y[k].real();
+    }
+  } else {
+    realBackward(spectral + row*rowStride, x, work);
+  }
+}
+
+template<class T>
+void NativeBackend<T>::forward() {
+  #pragma omp parallel for num_threads(nThreads) schedule(static) if(nThreads > 1)
+  for(int row=0; row<nRows; ++row) {
+#ifdef _OPENMP
+    const int thread = omp_get_thread_num();
+#else
+    const int thread = 0;
+#endif
+    forwardRow(row, scratch.data() + thread*4*(M+2));
+  }
+}
+
+template<class T>
+void NativeBackend<T>::backward() {
+  #pragma omp parallel for num_threads(nThreads) schedule(static) if(nThreads > 1)
+  for(int row=0; row<nRows; ++row) {
+#ifdef _OPENMP
+    const int thread = omp_get_thread_num();
+#else
+    const int thread = 0;
+#endif
+    backwardRow(row, scratch.data() + thread*4*(M+2));
+  }
+}
+
+template class NativeBackend<double>;
+template class NativeBackend<float>;
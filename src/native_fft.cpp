@@ -0,0 +1,121 @@
+#include <native_fft.hpp>
+
+#include <cmath>
+
+template<class T>
+NativeFft<T>::NativeFft(const int n_in)
+  : n(n_in)
+{
+  twiddles.resize(n);
+  for(int i=0; i<n; ++i) {
+    const double phase = -2.0*M_PI*i/n;
+    twiddles[i] = Complex(cos(phase), sin(phase));
+  }
+
+  // Radix 4 first, then 2, then odd numbers, as in KISS FFT
+  int remaining = n;
+  int p = 4;
+  while(remaining > 1) {
+    while(remaining%p != 0) {
+      if(p == 4) {
+        p = 2;
+      } else if(p == 2) {
+        p = 3;
+      } else {
+        p += 2;
+      }
+      if(p*p > remaining) {
+        p = remaining;
+      }
+    }
+    remaining /= p;
+    factors.push_back(p);
+    factors.push_back(remaining);
+  }
+}
+
+template<class T>
+void NativeFft<T>::forward(const Complex *in, Complex *out) const {
+  if(n == 1) {
+    out[0] = in[0];
+    return;
+  }
+  work(out, in, 1, factors.data());
+}
+
+template<class T>
+void NativeFft<T>::work(Complex *out, const Complex *in, const int stride, const int *factor) const {
+  const int p = factor[0];
+  const int m = factor[1];
+
+  if(m == 1) {
+    for(int q=0; q<p; ++q) {
+      out[q] = in[q*stride];
+    }
+  } else {
+    // Each of the p interleaved subsequences into its own block of m
+    for(int q=0; q<p; ++q) {
+      work(out + q*m, in + q*stride, stride*p, factor+2);
+    }
+  }
+
+  if(p == 2) {
+    butterfly2(out, stride, m);
+  } else if(p == 4) {
+    butterfly4(out, stride, m);
+  } else {
+    butterflyGeneric(out, stride, m, p);
+  }
+}
+
+template<class T>
+void NativeFft<T>::butterfly2(Complex *out, const int stride, const int m) const {
+  for(int k=0; k<m; ++k) {
+    const Complex t = out[k+m]*twiddles[k*stride];
+    out[k+m] = out[k] - t;
+    out[k] += t;
+  }
+}
+
+template<class T>
+void NativeFft<T>::butterfly4(Complex *out, const int stride, const int m) const {
+  for(int k=0; k<m; ++k) {
+    const Complex s0 = out[k+m]*twiddles[k*stride];
+    const Complex s1 = out[k+2*m]*twiddles[2*k*stride];
+    const Complex s2 = out[k+3*m]*twiddles[3*k*stride];
+    const Complex s5 = out[k] - s1;
+    out[k] += s1;
+    const Complex s3 = s0 + s2;
+    const Complex s4 = s0 - s2;
+    out[k+2*m] = out[k] - s3;
+    out[k] += s3;
+    out[k+m] = Complex(s5.real() + s4.imag(), s5.imag() - s4.real());
+    out[k+3*m] = Complex(s5.real() - s4.imag(), s5.imag() + s4.real());
+  }
+}
+
+template<class T>
+void NativeFft<T>::butterflyGeneric(Complex *out, const int stride, const int m, const int p) const {
+  std::vector<Complex> scratch(p);
+  for(int u=0; u<m; ++u) {
+    for(int q=0; q<p; ++q) {
+      scratch[q] = out[u + q*m];
+    }
+    for(int q1=0; q1<p; ++q1) {
+      const int k = u + q1*m;
+      int twiddleIndex = 0;
+      Complex sum = scratch[0];
+      for(int q=1; q<p; ++q) {
+        twiddleIndex += stride*k;
+        if(twiddleIndex >= n) {
+          twiddleIndex %= n;
+        }
+        sum += scratch[q]*twiddles[twiddleIndex];
+      }
+      out[k] = sum;
+    }
+  }
+}
+
+template class NativeFft<double>;
+template class NativeFft<float>;
@@ -15,15 +15,19 @@ mode adamsBashforth(mode dfdt_current, mode dfdt_prev, real frac, real dt) {
 real checkCFL(Variable &psi, real dz, real dx, real dt, int a, int nN, int nX, int nZ) {
   real vxMax = 0.0f;
   real vzMax = 0.0f;
-  real f=1.0f;
 
   psi.toPhysical();
+  if(psi.isCompact()) {
+    psi.computeCompactSpatialDerivative();
+  }
 
   #pragma omp parallel for schedule(dynamic)
   for(int k=0; k<nZ; ++k) {
     for(int j=0; j<nX; ++j) {
       real vx = psi.dfdzSpatial(j,k);
-      real vz = psi.dfdx(j,k);
+      // Scaled to the computational grid, so that stretched rows are
+      // compared against their own spacing
+      real vz = psi.dfdx(j,k)*psi.verticalMetric(k);
       if(isnan(vx) or isnan(vz)){
         cout << "CFL Condition Breached" << endl;
         exit(-1);
@@ -42,20 +46,26 @@ real checkCFL(Variable &psi, real dz, real dx, real dt, int a, int nN, int nX, i
     exit(-1);
   }
 
-  real threshold = 0.8;
-
-  while(dt > threshold*dz/vzMax or dt > threshold*dx/vxMax) {
-    dt*=threshold;
-    f*=threshold;
-  } 
-
   //if(vzMax < 0.2*dz/dt and vxMax < 0.2*(float(a)/nN)/dt) {
     //dt*=1.1;
     //f*=1.1;
   //} 
 
-  if(f!=1.0f) {
-    cout << "New time step is " << dt << endl;
+  return cflTimestepFactor(dt, dz/vzMax, dx/vxMax);
+}
+
+real cflTimestepFactor(const real dt, const real zCrossingTime, const real xCrossingTime, const bool isVerbose) {
+  real threshold = 0.8;
+  real newDt = dt;
+  real f = 1.0;
+
+  while(newDt > threshold*zCrossingTime or newDt > threshold*xCrossingTime) {
+    newDt*=threshold;
+    f*=threshold;
+  }
+
+  if(f!=1.0 and isVerbose) {
+    cout << "New time step is " << newDt << endl;
   }
   return f;
 }
@@ -3,8 +3,11 @@
 #include <cmath>
 #include <algorithm>
 #include <cassert>
+#include <omp.h>
 
 #include <sim.hpp>
+#include <field_expression.hpp>
+#include <state_cache.hpp>
 #include <precision.hpp>
 #include <utility.hpp>
 #include <numerical_methods.hpp>
@@ -18,23 +21,116 @@ Sim::Sim(const Constants &c_in)
   , vars(c_in)
   , nonlinearSineTerm(c_in, 1, true)
   , nonlinearCosineTerm(c_in, 1, false)
+  , nonlinearXiTerm(c_in, 1, false)
   , keTracker(c_in)
+  , splitComplexKernels(nullptr)
+  , dPsidx(nullptr)
+  , dTmpdx(nullptr)
+  , dOmgdx(nullptr)
+  , dXidx(nullptr)
 {
   dt = c.initialDt;
 
   thomasAlgorithm = new ThomasAlgorithm(c);
+  if(c.isSplitComplexKernels) {
+    splitComplexKernels = new SplitComplexKernels(c);
+  }
+
+  if(c.isSpectralX) {
+    dPsidx = new Variable(c, 1, false);
+    dTmpdx = new Variable(c, 1, true);
+    dOmgdx = new Variable(c, 1, false);
+    if(c.isDoubleDiffusion) {
+      dXidx = new Variable(c, 1, true);
+    }
+  }
+
+  // Nothing above nN is ever set or read
+  for(Variable *var : {&vars.tmp, &vars.omg, &vars.psi, &vars.xi,
+      &nonlinearSineTerm, &nonlinearCosineTerm, &nonlinearXiTerm,
+      dPsidx, dTmpdx, dOmgdx, dXidx}) {
+    if(var != nullptr) {
+      var->isPruned = true;
+    }
+  }
+
+  // The transform normalisation is applied as the Jacobians are added
+  for(Variable *nonlinearTerm : {&nonlinearSineTerm, &nonlinearCosineTerm, &nonlinearXiTerm}) {
+    nonlinearTerm->isNormalisationDeferred = true;
+  }
+
+  if(c.isSlabTransformEnabled) {
+    setupSlabTransforms();
+  }
 }
 
 Sim::~Sim() {
   delete thomasAlgorithm;
+  if(splitComplexKernels != nullptr) {
+    delete splitComplexKernels;
+  }
+  for(Variable *dVardx : {dPsidx, dTmpdx, dOmgdx, dXidx}) {
+    if(dVardx != nullptr) {
+      delete dVardx;
+    }
+  }
+}
+
+bool Sim::reset(const Constants &c_in) {
+  // Reuses all allocations and FFTW plans, so only parameters that do not
+  // change the grid shape may differ
+  if(not c.isSameGridShape(c_in)) {
+    cout << "Grid shape changed. Cannot reset simulation." << endl;
+    return false;
+  }
+
+  c = c_in;
+  vars.reparameterise(c);
+  nonlinearSineTerm.reparameterise(c);
+  nonlinearCosineTerm.reparameterise(c);
+  nonlinearXiTerm.reparameterise(c);
+  keTracker.reset(c);
+  thomasAlgorithm->reparameterise(c);
+  if(splitComplexKernels != nullptr) {
+    splitComplexKernels->reparameterise(c);
+  } else if(c.isSplitComplexKernels) {
+    splitComplexKernels = new SplitComplexKernels(c);
+  }
+  for(Variable *dVardx : {dPsidx, dTmpdx, dOmgdx, dXidx}) {
+    if(dVardx != nullptr) {
+      dVardx->reparameterise(c);
+    }
+  }
+  if(c.isSlabTransformEnabled and slabStarts.empty()) {
+    setupSlabTransforms();
+  }
+
+  dt = c.initialDt;
+  t = 0;
+  return true;
+}
+
+void Sim::loadInitialConditions() {
+  if(c.warmStart) {
+    // The cache gains entries as runs finish, so it is searched every time
+    StateCache cache(c.stateCacheFolder);
+    if(cache.load(c, vars)) {
+      return;
+    }
+  }
+
+  if(initialStateFile != c.icFile) {
+    vars.load(c.icFile);
+    vars.writeState(initialState);
+    initialStateFile = c.icFile;
+  } else {
+    vars.readState(initialState);
+  }
 }
 
 void Sim::solveForPsi(){
   // Solve for Psi using Thomas algorithm
-  #pragma omp parallel for schedule(dynamic)
-  for(int n=0; n<c.nN; ++n) {
-    thomasAlgorithm->solve(vars.psi, vars.omg, n);
-  }
+  thomasAlgorithm->solveAllModes(vars.psi, vars.omg);
 }
 
 void Sim::printBenchmarkData() const {
@@ -46,36 +142,44 @@ void Sim::printBenchmarkData() const {
 
 void Sim::computeLinearDerivatives() {
   // Computes the (linear) derivatives of Tmp and vars.omg
-  computeLinearTemperatureDerivative();
-  computeLinearVorticityDerivative();
+  if(c.isCompact) {
+    vars.tmp.computeCompactDerivatives();
+    vars.omg.computeCompactDerivatives();
+    if(c.isDoubleDiffusion) {
+      vars.xi.computeCompactDerivatives();
+    }
+  }
+  computeLinearTemperatureDerivative(0, c.nZ);
+  computeLinearVorticityDerivative(0, c.nZ);
   if(c.isDoubleDiffusion) {
-    computeLinearXiDerivative();
+    computeLinearXiDerivative(0, c.nZ);
   }
 }
 
-void Sim::computeLinearTemperatureDerivative() {
-  for(int k=0; k<c.nZ; ++k) {
-    for(int n=0; n<c.nN; ++n) {
-      vars.dTmpdt(n,k) = vars.tmp.laplacian(n,k);
-    }
+void Sim::computeLinearTemperatureDerivative(const int kFirst, const int kLast) {
+  if(c.isSplitComplexKernels) {
+    splitComplexKernels->computeLinearTemperatureDerivative(vars, kFirst, kLast);
+    return;
   }
+  rows(vars.dTmpdt, kFirst, kLast) = lap(vars.tmp);
 }
 
-void Sim::computeLinearVorticityDerivative() {
-  for(int k=0; k<c.nZ; ++k) {
-    for(int n=0; n<c.nN; ++n) {
-      vars.dOmgdt(n,k) = c.Pr*vars.omg.laplacian(n,k) - n*c.wavelength*c.xCosDerivativeFactor*c.Pr*c.Ra*vars.tmp(n,k);
-    }
+void Sim::computeLinearVorticityDerivative(const int kFirst, const int kLast) {
+  if(c.isSplitComplexKernels) {
+    splitComplexKernels->computeLinearVorticityDerivative(vars, kFirst, kLast);
+    return;
   }
+  rows(vars.dOmgdt, kFirst, kLast) =
+    c.Pr*lap(vars.omg) - kx(c)*c.xCosDerivativeFactor*c.Pr*c.Ra*vars.tmp;
 }
 
-void Sim::computeLinearXiDerivative() {
-  for(int k=0; k<c.nZ; ++k) {
-    for(int n=0; n<c.nN; ++n) {
-      vars.dXidt(n,k) = c.tau*vars.xi.laplacian(n,k);
-      vars.dOmgdt(n,k) += n*c.wavelength*c.xCosDerivativeFactor*c.RaXi*c.tau*c.Pr*vars.xi(n,k);
-    }
+void Sim::computeLinearXiDerivative(const int kFirst, const int kLast) {
+  if(c.isSplitComplexKernels) {
+    splitComplexKernels->computeLinearXiDerivative(vars, kFirst, kLast);
+    return;
   }
+  rows(vars.dXidt, kFirst, kLast) = c.tau*lap(vars.xi);
+  rows(vars.dOmgdt, kFirst, kLast) += kx(c)*c.xCosDerivativeFactor*c.RaXi*c.tau*c.Pr*vars.xi;
 }
 
 void Sim::addAdvectionApproximation() {
@@ -101,10 +205,29 @@ void Sim::addAdvectionApproximation() {
   }
 }
 
+void Sim::updateVars(real f) {
+  if(c.isSplitComplexKernels) {
+    splitComplexKernels->updateVars(vars, dt, f);
+  } else {
+    vars.updateVars(dt, f);
+  }
+}
+
 void Sim::applyPhysicalBoundaryConditions() {
+  applyHorizontalPhysicalBoundaryConditions(0, c.nZ);
+  if (c.verticalBoundaryConditions == BoundaryConditions::periodic) {
+    copyPeriodicGhostRow(-1, c.nZ-1);
+    copyPeriodicGhostRow(c.nZ, 0);
+  }
+  if(c.isCompact) {
+    vars.psi.computeCompactSpatialDerivative();
+  }
+}
+
+void Sim::applyHorizontalPhysicalBoundaryConditions(const int kFirst, const int kLast) {
   real nX = c.nX;
   if(c.horizontalBoundaryConditions == BoundaryConditions::impermeable) {
-    for(int k=0; k<c.nZ; ++k) {
+    for(int k=kFirst; k<kLast; ++k) {
       // Non-conducting
       vars.tmp.spatial(-1,k) = vars.tmp.spatial(1, k);
       vars.tmp.spatial(nX,k) = vars.tmp.spatial(nX-2, k);
@@ -126,7 +249,7 @@ void Sim::applyPhysicalBoundaryConditions() {
       }
     }
   } else if(c.horizontalBoundaryConditions == BoundaryConditions::periodic) {
-    for(int k=0; k<c.nZ; ++k) {
+    for(int k=kFirst; k<kLast; ++k) {
       vars.tmp.spatial(-1,k) = vars.tmp.spatial(nX-1, k);
       vars.tmp.spatial(nX,k) = vars.tmp.spatial(0, k);
 
@@ -142,21 +265,15 @@ void Sim::applyPhysicalBoundaryConditions() {
       }
     }
   }
-  if (c.verticalBoundaryConditions == BoundaryConditions::periodic) {
-    for(int i=0; i<c.nX; ++i) {
-      vars.tmp.spatial(i, -1) = vars.tmp.spatial(i, c.nZ-1);
-      vars.tmp.spatial(i, c.nZ) = vars.tmp.spatial(i, 0);
-
-      vars.omg.spatial(i, -1) = vars.omg.spatial(i, c.nZ-1);
-      vars.omg.spatial(i, c.nZ) = vars.omg.spatial(i, 0);
-
-      vars.psi.spatial(i, -1) = vars.psi.spatial(i, c.nZ-1);
-      vars.psi.spatial(i, c.nZ) = vars.psi.spatial(i, 0);
+}
 
-      if(c.isDoubleDiffusion) {
-        vars.xi.spatial(i, -1) = vars.xi.spatial(i, c.nZ-1);
-        vars.xi.spatial(i, c.nZ) = vars.xi.spatial(i, 0);
-      }
+void Sim::copyPeriodicGhostRow(const int kGhost, const int kSource) {
+  for(int i=0; i<c.nX; ++i) {
+    vars.tmp.spatial(i, kGhost) = vars.tmp.spatial(i, kSource);
+    vars.omg.spatial(i, kGhost) = vars.omg.spatial(i, kSource);
+    vars.psi.spatial(i, kGhost) = vars.psi.spatial(i, kSource);
+    if(c.isDoubleDiffusion) {
+      vars.xi.spatial(i, kGhost) = vars.xi.spatial(i, kSource);
     }
   }
 }
@@ -169,6 +286,9 @@ void Sim::computeNonlinearDerivatives() {
     vars.xi.toPhysical();
   }
   applyPhysicalBoundaryConditions();
+  if(c.isSpectralX) {
+    computeSpectralXDerivatives();
+  }
   computeNonlinearTemperatureDerivative();
   computeNonlinearVorticityDerivative();
   if(c.isDoubleDiffusion) {
@@ -176,43 +296,395 @@ void Sim::computeNonlinearDerivatives() {
   }
 }
 
-void Sim::computeNonlinearDerivative(Variable &dVardt, const Variable &var) {
-  Variable *nonlinearTerm;
-  if(var.useSinTransform) {
-    nonlinearTerm = &nonlinearSineTerm;
-  } else {
-    nonlinearTerm = &nonlinearCosineTerm;
+void Sim::computeDerivatives() {
+  // Runs the linear and nonlinear derivative calculations as a task graph.
+  // The linear derivatives only read spectral data and the inverse
+  // transforms only write spatial data, so they overlap, and the three
+  // Jacobians and their forward transforms run concurrently once the
+  // physical boundary conditions are set. Each Jacobian is added to its
+  // derivative after the linear part, in the same order as before, so the
+  // result is unchanged. The char variables are only dependency tokens.
+  [[gnu::unused]] char tmpSpatial, omgSpatial, psiSpatial, xiSpatial;
+  [[gnu::unused]] char dTmpdt, dOmgdt, dXidt;
+  [[gnu::unused]] char tmpTerm, omgTerm, xiTerm;
+
+  #pragma omp parallel
+  #pragma omp single
+  {
+    #pragma omp task depend(out: dTmpdt)
+    {
+      if(c.isCompact) {
+        vars.tmp.computeCompactDerivatives();
+      }
+      computeLinearTemperatureDerivative(0, c.nZ);
+    }
+    #pragma omp task depend(out: dOmgdt)
+    {
+      if(c.isCompact) {
+        vars.omg.computeCompactDerivatives();
+      }
+      computeLinearVorticityDerivative(0, c.nZ);
+    }
+    if(c.isDoubleDiffusion) {
+      #pragma omp task depend(out: dXidt) depend(inout: dOmgdt)
+      {
+        if(c.isCompact) {
+          vars.xi.computeCompactDerivatives();
+        }
+        computeLinearXiDerivative(0, c.nZ);
+      }
+    }
+
+    #pragma omp task depend(out: tmpSpatial)
+    {
+      vars.tmp.toPhysical();
+      if(c.isSpectralX) {
+        computeSpectralXDerivative(vars.tmp, *dTmpdx);
+      }
+    }
+    #pragma omp task depend(out: omgSpatial)
+    {
+      vars.omg.toPhysical();
+      if(c.isSpectralX) {
+        computeSpectralXDerivative(vars.omg, *dOmgdx);
+      }
+    }
+    #pragma omp task depend(out: psiSpatial)
+    {
+      vars.psi.toPhysical();
+      if(c.isSpectralX) {
+        computeSpectralXDerivative(vars.psi, *dPsidx);
+      }
+    }
+    if(c.isDoubleDiffusion) {
+      #pragma omp task depend(out: xiSpatial)
+      {
+        vars.xi.toPhysical();
+        if(c.isSpectralX) {
+          computeSpectralXDerivative(vars.xi, *dXidx);
+        }
+      }
+    }
+
+    #pragma omp task depend(inout: tmpSpatial, omgSpatial, psiSpatial, xiSpatial)
+    applyPhysicalBoundaryConditions();
+
+    #pragma omp task depend(in: tmpSpatial, psiSpatial) depend(out: tmpTerm)
+    computeNonlinearTerm(nonlinearCosineTerm, vars.tmp);
+    #pragma omp task depend(in: omgSpatial, psiSpatial) depend(out: omgTerm)
+    computeNonlinearTerm(nonlinearSineTerm, vars.omg);
+    if(c.isDoubleDiffusion) {
+      #pragma omp task depend(in: xiSpatial, psiSpatial) depend(out: xiTerm)
+      computeNonlinearTerm(nonlinearXiTerm, vars.xi);
+    }
+
+    #pragma omp task depend(in: tmpTerm) depend(inout: dTmpdt)
+    {
+      addNonlinearTerm(vars.dTmpdt, nonlinearCosineTerm);
+      applyMeanTemperatureGradient();
+    }
+    #pragma omp task depend(in: omgTerm) depend(inout: dOmgdt)
+    addNonlinearTerm(vars.dOmgdt, nonlinearSineTerm);
+    if(c.isDoubleDiffusion) {
+      #pragma omp task depend(in: xiTerm) depend(inout: dXidt)
+      {
+        addNonlinearTerm(vars.dXidt, nonlinearXiTerm);
+        applyMeanSalinityGradient();
+      }
+    }
+  }
+}
+
+void Sim::setupSlabTransforms() {
+  // Contiguous slabs of rows, one per thread, as evenly sized as possible
+  const int nSlabs = std::max(1, std::min(omp_get_max_threads(), c.nZ));
+  slabStarts.resize(nSlabs+1);
+  for(int s=0; s<=nSlabs; ++s) {
+    slabStarts[s] = (s*c.nZ)/nSlabs;
+  }
+  slabReady.assign(nSlabs, 0);
+  slabEpoch = 0;
+
+  for(Variable *var : {&vars.tmp, &vars.omg, &vars.psi,
+      &nonlinearSineTerm, &nonlinearCosineTerm}) {
+    var->setupSlabTransforms(slabStarts);
+  }
+  if(c.isDoubleDiffusion) {
+    vars.xi.setupSlabTransforms(slabStarts);
+    nonlinearXiTerm.setupSlabTransforms(slabStarts);
+  }
+}
+
+void Sim::waitForSlab(const int s) const {
+  int epoch;
+  do {
+    #pragma omp atomic read seq_cst
+    epoch = slabReady[s];
+  } while(epoch != slabEpoch);
+}
+
+void Sim::computeDerivativesInSlabs() {
+  // Each thread owns a slab of rows, which it transforms with its own
+  // single threaded plans before going straight on to the Jacobians. There
+  // is no barrier between the transforms and the Jacobians: only the edge
+  // rows of a slab wait for the neighbouring slab to be in physical space.
+  // Slabs are handled in two passes so that a thread given several slabs
+  // never waits on one it has not transformed yet.
+  const int nSlabs = slabStarts.size() - 1;
+  const bool isVerticallyPeriodic = c.verticalBoundaryConditions == BoundaryConditions::periodic;
+  ++slabEpoch;
+
+  #pragma omp parallel num_threads(nSlabs)
+  {
+    const int thread = omp_get_thread_num();
+    const int nThreads = omp_get_num_threads();
+
+    for(int s=thread; s<nSlabs; s+=nThreads) {
+      const int kFirst = slabStarts[s];
+      const int kLast = slabStarts[s+1];
+
+      computeLinearTemperatureDerivative(kFirst, kLast);
+      computeLinearVorticityDerivative(kFirst, kLast);
+      if(c.isDoubleDiffusion) {
+        computeLinearXiDerivative(kFirst, kLast);
+      }
+
+      vars.tmp.toPhysical(s);
+      vars.omg.toPhysical(s);
+      vars.psi.toPhysical(s);
+      if(c.isDoubleDiffusion) {
+        vars.xi.toPhysical(s);
+      }
+      applyHorizontalPhysicalBoundaryConditions(kFirst, kLast);
+      if(isVerticallyPeriodic and kLast == c.nZ) {
+        copyPeriodicGhostRow(-1, c.nZ-1);
+      }
+      if(isVerticallyPeriodic and kFirst == 0) {
+        copyPeriodicGhostRow(c.nZ, 0);
+      }
+
+      #pragma omp atomic write seq_cst
+      slabReady[s] = slabEpoch;
+
+      // Interior rows only read this slab
+      for(int k=kFirst+1; k<kLast-1; ++k) {
+        computeJacobianRow(nonlinearCosineTerm, vars.tmp, k);
+        computeJacobianRow(nonlinearSineTerm, vars.omg, k);
+        if(c.isDoubleDiffusion) {
+          computeJacobianRow(nonlinearXiTerm, vars.xi, k);
+        }
+      }
+    }
+
+    for(int s=thread; s<nSlabs; s+=nThreads) {
+      const int kFirst = slabStarts[s];
+      const int kLast = slabStarts[s+1];
+
+      if(s > 0) {
+        waitForSlab(s-1);
+      } else if(isVerticallyPeriodic) {
+        waitForSlab(nSlabs-1);
+      }
+      if(s < nSlabs-1) {
+        waitForSlab(s+1);
+      } else if(isVerticallyPeriodic) {
+        waitForSlab(0);
+      }
+
+      for(int k : {kFirst, kLast-1}) {
+        computeJacobianRow(nonlinearCosineTerm, vars.tmp, k);
+        computeJacobianRow(nonlinearSineTerm, vars.omg, k);
+        if(c.isDoubleDiffusion) {
+          computeJacobianRow(nonlinearXiTerm, vars.xi, k);
+        }
+        if(kLast-1 == kFirst) {
+          break;
+        }
+      }
+
+      nonlinearCosineTerm.toSpectral(s);
+      nonlinearSineTerm.toSpectral(s);
+      if(c.isDoubleDiffusion) {
+        nonlinearXiTerm.toSpectral(s);
+      }
+
+      for(int k=kFirst; k<kLast; ++k) {
+        for(int n=0; n<c.nN; ++n) {
+          const real norm = nonlinearCosineTerm.spectralNormalisation(n);
+          vars.dTmpdt(n,k) += norm*nonlinearCosineTerm(n,k);
+          vars.dOmgdt(n,k) += norm*nonlinearSineTerm(n,k);
+        }
+        if(c.isDoubleDiffusion) {
+          for(int n=0; n<c.nN; ++n) {
+            vars.dXidt(n,k) += nonlinearXiTerm.spectralNormalisation(n)*nonlinearXiTerm(n,k);
+          }
+        }
+        if(isVerticallyPeriodic) {
+          vars.dTmpdt(0,k) = c.temperatureGradient;
+          if(c.isDoubleDiffusion) {
+            vars.dXidt(0,k) = c.salinityGradient;
+          }
+        }
+      }
+    }
+  }
+}
+
+void Sim::computeJacobianRow(Variable &nonlinearTerm, const Variable &var, const int k) {
+  // In transform_real, which is float with mixed precision
+  const transform_real half = 0.5;
+  const transform_real oodx = c.oodx;
+  const transform_real oodz = c.oodz;
+  const transform_real metric = vars.psi.verticalMetric(k);
+  for(int ix=0; ix<var.nX; ++ix) {
+    nonlinearTerm.spatial(ix,k) = 
+      -(
+          (
+           var.spatial(ix+1,k)*(-vars.psi.dfdzSpatial(ix+1,k)) -
+           var.spatial(ix-1,k)*(-vars.psi.dfdzSpatial(ix-1,k))
+          )*oodx*half +
+          (
+           var.spatial(ix,k+1)*vars.psi.dfdx(ix,k+1) -
+           var.spatial(ix,k-1)*vars.psi.dfdx(ix,k-1)
+          )*oodz*half*metric
+       );
+  }
+}
+
+void Sim::computeCompactJacobian(Variable &nonlinearTerm, const Variable &var) {
+  // The vertical flux var*dpsi/dx is differentiated with the compact scheme,
+  // using nonlinearTerm's spatial data as scratch
+  const transform_real half = 0.5;
+  const transform_real oodx = c.oodx;
+  for(int k=0; k<c.nZ; ++k) {
+    for(int ix=0; ix<var.nX; ++ix) {
+      nonlinearTerm.spatial(ix,k) = var.spatial(ix,k)*vars.psi.dfdx(ix,k);
+    }
   }
+  nonlinearTerm.computeCompactSpatialDerivative();
 
-  #pragma omp parallel for schedule(dynamic)
   for(int k=0; k<c.nZ; ++k) {
     for(int ix=0; ix<var.nX; ++ix) {
-      nonlinearTerm->spatial(ix,k) = 
+      nonlinearTerm.spatial(ix,k) =
         -(
             (
              var.spatial(ix+1,k)*(-vars.psi.dfdzSpatial(ix+1,k)) -
              var.spatial(ix-1,k)*(-vars.psi.dfdzSpatial(ix-1,k))
-            )*c.oodx*0.5 +
-            (
-             var.spatial(ix,k+1)*vars.psi.dfdx(ix,k+1) -
-             var.spatial(ix,k-1)*vars.psi.dfdx(ix,k-1)
-            )*c.oodz*0.5
+            )*oodx*half +
+            nonlinearTerm.dfdzSpatial(ix,k)
          );
+    }
+  }
+}
 
+void Sim::computeSpectralXDerivative(const Variable &var, Variable &dVardx) {
+  const mode factor = var.useSinTransform ? c.xSinDerivativeFactor : c.xCosDerivativeFactor;
+  for(int k=0; k<c.nZ; ++k) {
+    for(int n=0; n<c.nN; ++n) {
+      dVardx(n,k) = factor*(real(n)*c.wavelength)*var(n,k);
     }
   }
+  dVardx.toPhysical();
+}
 
-  nonlinearTerm->toSpectral();
+void Sim::computeSpectralXDerivatives() {
+  computeSpectralXDerivative(vars.psi, *dPsidx);
+  computeSpectralXDerivative(vars.tmp, *dTmpdx);
+  computeSpectralXDerivative(vars.omg, *dOmgdx);
+  if(c.isDoubleDiffusion) {
+    computeSpectralXDerivative(vars.xi, *dXidx);
+  }
+}
+
+const Variable& Sim::spectralXDerivativeOf(const Variable &var) const {
+  if(&var == &vars.tmp) {
+    return *dTmpdx;
+  } else if(&var == &vars.omg) {
+    return *dOmgdx;
+  }
+  return *dXidx;
+}
+
+void Sim::computeSpectralJacobianRow(Variable &nonlinearTerm, const Variable &var, const int k) {
+  // Advective form u.grad(var), which equals the flux form as u is
+  // divergence free. Only x derivatives on the grid would need the ghost
+  // columns, and there are none. The products are quadratic, so with nX
+  // from the 3/2 rule the truncation in toSpectral removes the aliasing.
+  const Variable &dVardx = spectralXDerivativeOf(var);
+  for(int ix=0; ix<var.nX; ++ix) {
+    nonlinearTerm.spatial(ix,k) =
+      -(
+          -vars.psi.dfdzSpatial(ix,k)*dVardx.spatial(ix,k) +
+          dPsidx->spatial(ix,k)*var.dfdzSpatial(ix,k)
+       );
+  }
+}
+
+void Sim::computeNonlinearTerm(Variable &nonlinearTerm, const Variable &var) {
+  if(c.isCompact) {
+    computeCompactJacobian(nonlinearTerm, var);
+    nonlinearTerm.toSpectral();
+    return;
+  }
+
+  if(c.isSpectralX) {
+    #pragma omp taskloop shared(nonlinearTerm, var)
+    for(int k=0; k<c.nZ; ++k) {
+      computeSpectralJacobianRow(nonlinearTerm, var, k);
+    }
+    nonlinearTerm.toSpectral();
+    return;
+  }
+
+  // Called from within a task, so the rows are split into further tasks
+  #pragma omp taskloop shared(nonlinearTerm, var)
+  for(int k=0; k<c.nZ; ++k) {
+    computeJacobianRow(nonlinearTerm, var, k);
+  }
 
+  nonlinearTerm.toSpectral();
+}
+
+void Sim::addNonlinearTerm(Variable &dVardt, const Variable &nonlinearTerm) {
+  if(c.isSplitComplexKernels) {
+    splitComplexKernels->addNonlinearTerm(dVardt, nonlinearTerm);
+    return;
+  }
   for(int k=0; k<c.nZ; ++k) {
     for(int n=0; n<c.nN; ++n) {
-      dVardt(n,k) += (*nonlinearTerm)(n,k);
+      dVardt(n,k) += nonlinearTerm.spectralNormalisation(n)*nonlinearTerm(n,k);
     }
   }
 }
 
-void Sim::computeNonlinearTemperatureDerivative() {
-  computeNonlinearDerivative(vars.dTmpdt, vars.tmp);
+void Sim::computeNonlinearDerivative(Variable &dVardt, const Variable &var) {
+  Variable *nonlinearTerm;
+  if(var.useSinTransform) {
+    nonlinearTerm = &nonlinearSineTerm;
+  } else {
+    nonlinearTerm = &nonlinearCosineTerm;
+  }
+
+  if(c.isCompact) {
+    computeCompactJacobian(*nonlinearTerm, var);
+  } else if(c.isSpectralX) {
+    #pragma omp parallel for schedule(dynamic)
+    for(int k=0; k<c.nZ; ++k) {
+      computeSpectralJacobianRow(*nonlinearTerm, var, k);
+    }
+  } else {
+    #pragma omp parallel for schedule(dynamic)
+    for(int k=0; k<c.nZ; ++k) {
+      computeJacobianRow(*nonlinearTerm, var, k);
+    }
+  }
+
+  nonlinearTerm->toSpectral();
+
+  addNonlinearTerm(dVardt, *nonlinearTerm);
+}
+
+void Sim::applyMeanTemperatureGradient() {
   if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
     for(int k=0; k<c.nZ; ++k) {
       vars.dTmpdt(0,k) = c.temperatureGradient;
@@ -220,17 +692,26 @@ void Sim::computeNonlinearTemperatureDerivative() {
   }
 }
 
+void Sim::applyMeanSalinityGradient() {
+  if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
+    for(int k=0; k<c.nZ; ++k) {
+      vars.dXidt(0,k) = c.salinityGradient;
+    }
+  }
+}
+
+void Sim::computeNonlinearTemperatureDerivative() {
+  computeNonlinearDerivative(vars.dTmpdt, vars.tmp);
+  applyMeanTemperatureGradient();
+}
+
 void Sim::computeNonlinearVorticityDerivative() {
   computeNonlinearDerivative(vars.dOmgdt, vars.omg);
 }
 
 void Sim::computeNonlinearXiDerivative() {
   computeNonlinearDerivative(vars.dXidt, vars.xi);
-  if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
-    for(int k=0; k<c.nZ; ++k) {
-      vars.dXidt(0,k) = c.salinityGradient;
-    }
-  }
+  applyMeanSalinityGradient();
 }
 
 void Sim::applyTemperatureBoundaryConditions() {
@@ -291,6 +772,17 @@ void Sim::applyPsiBoundaryConditions() {
       vars.psi(n,-1) = 2.0*vars.psi(n,0) - vars.psi(n,1);
       vars.psi(n,c.nZ) = 2.0*vars.psi(n,c.nZ-1) - vars.psi(n,c.nZ-2);
     }
+    const StretchedGrid *grid = vars.psi.getStretchedGrid();
+    if(grid != nullptr) {
+      // On a stretched grid d2psi/dz2 = 0 also has a d/ds term, with ratio
+      // r to the d2/ds2 term
+      const real rBottom = grid->d2sdz2[0]*c.dz*0.5/pow(grid->dsdz[0], 2);
+      const real rTop = grid->d2sdz2[c.nZ-1]*c.dz*0.5/pow(grid->dsdz[c.nZ-1], 2);
+      for(int n=0; n<c.nN; ++n) {
+        vars.psi(n,-1) = (2.0*vars.psi(n,0) - (1.0 + rBottom)*vars.psi(n,1))/(1.0 - rBottom);
+        vars.psi(n,c.nZ) = (2.0*vars.psi(n,c.nZ-1) - (1.0 - rTop)*vars.psi(n,c.nZ-2))/(1.0 + rTop);
+      }
+    }
   } else if(c.verticalBoundaryConditions == BoundaryConditions::periodic) {
     for(int n=0; n<c.nN; ++n) {
       vars.psi(n,-1) = vars.psi(n,c.nZ-1);
@@ -300,9 +792,12 @@ void Sim::applyPsiBoundaryConditions() {
 }
 
 void Sim::runNonLinearStep(real f) {
-  computeLinearDerivatives();
-  computeNonlinearDerivatives();
-  vars.updateVars(dt, f);
+  if(c.isSlabTransformEnabled) {
+    computeDerivativesInSlabs();
+  } else {
+    computeDerivatives();
+  }
+  updateVars(f);
   applyTemperatureBoundaryConditions();
   applyVorticityBoundaryConditions();
   if(c.isDoubleDiffusion) {
@@ -315,7 +810,7 @@ void Sim::runNonLinearStep(real f) {
 
 void Sim::runNonLinear() {
   // Load initial conditions
-  vars.load(c.icFile);
+  loadInitialConditions();
 
   applyTemperatureBoundaryConditions();
   applyVorticityBoundaryConditions();
@@ -332,6 +827,9 @@ void Sim::runNonLinear() {
   t = 0;
   while (c.totalTime-t>EPSILON) {
     if(KEcalcTime-t < EPSILON) {
+      if(c.isCompact) {
+        vars.psi.computeCompactDerivatives();
+      }
       keTracker.calcKineticEnergy(vars.psi);
       KEcalcTime += 1e2*dt;
     }
@@ -357,12 +855,17 @@ void Sim::runNonLinear() {
   printf("%e of %e (%.2f%%)\n", t, c.totalTime, t/c.totalTime*100);
   vars.save();
   keTracker.saveKineticEnergy();
+
+  if(c.warmStart) {
+    StateCache cache(c.stateCacheFolder);
+    cache.store(c, vars);
+  }
 }
 
 void Sim::runLinearStep() {
   computeLinearDerivatives();
   addAdvectionApproximation();
-  vars.updateVars(dt);
+  updateVars();
   applyTemperatureBoundaryConditions();
   applyVorticityBoundaryConditions();
   vars.advanceDerivatives();
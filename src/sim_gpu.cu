@@ -267,6 +267,24 @@ SimGPU::~SimGPU() {
   delete thomasAlgorithm;
 }
 
+bool SimGPU::reset(const Constants &c_in) {
+  if(not c.isSameGridShape(c_in)) {
+    cout << "Grid shape changed. Cannot reset simulation." << endl;
+    return false;
+  }
+
+  if(c_in.oodz2 != c.oodz2 or c_in.wavelength != c.wavelength) {
+    delete thomasAlgorithm;
+    thomasAlgorithm = new ThomasAlgorithmGPU(c_in);
+  }
+  c = c_in;
+  keTracker.reset(c);
+
+  dt = c.initialDt;
+  t = 0;
+  return true;
+}
+
 void SimGPU::computeLinearTemperatureDerivative() {
   gpu_computeLinearTemperatureDerivative<<<numBlocks2D,threadsPerBlock2D>>>(vars.dTmpdt.getCurrent(), vars.tmp.getCurrent());
 }
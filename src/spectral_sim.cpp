@@ -0,0 +1,352 @@
+#include <spectral_sim.hpp>
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <numerical_methods.hpp>
+
+using std::cout;
+using std::endl;
+
+SpectralSim::SpectralSim(const Constants &c_in)
+  : c(c_in)
+  , vars(c_in)
+  , nXh(c_in.nX/2 + 1)
+  , nSpectral(c_in.nZ*(c_in.nX/2 + 1))
+  , current(0)
+{
+  dt = c.initialDt;
+
+  for(mode **var : {&tmp, &omg, &psi, &xi,
+      &dTmpdt[0], &dTmpdt[1], &dOmgdt[0], &dOmgdt[1], &dXidt[0], &dXidt[1],
+      &spectralWork, &productHat}) {
+    *var = static_cast<mode*>(FftwApi<real>::malloc(sizeof(mode)*nSpectral));
+    std::fill(*var, *var + nSpectral, mode(0.0));
+  }
+  for(real **var : {&u, &w, &field, &product}) {
+    *var = static_cast<real*>(FftwApi<real>::malloc(sizeof(real)*c.nZ*c.nX));
+  }
+
+  // z wavenumbers wrap round to negative values past the Nyquist mode
+  kz.resize(c.nZ);
+  kx.resize(nXh);
+  for(int m=0; m<c.nZ; ++m) {
+    kz[m] = 2.0*M_PI*(m <= c.nZ/2 ? m : m - c.nZ);
+  }
+  for(int n=0; n<nXh; ++n) {
+    kx[n] = c.wavelength*n;
+  }
+
+  // Modes that survive the 2/3 rule, also limited to the nN modes kept in
+  // files
+  const int mMax = (c.nZ-1)/3;
+  const int nMax = std::min(c.nN-1, (c.nX-1)/3);
+  dealiasMask.resize(nSpectral);
+  for(int m=0; m<c.nZ; ++m) {
+    const int mWrapped = m <= c.nZ/2 ? m : c.nZ - m;
+    for(int n=0; n<nXh; ++n) {
+      dealiasMask[m*nXh + n] = (mWrapped <= mMax and n <= nMax) ? 1.0 : 0.0;
+    }
+  }
+
+  #pragma omp critical
+  {
+#ifdef _OPENMP
+  FftwApi<real>::plan_with_nthreads(omp_get_max_threads());
+#endif
+  forwardPlan = FftwApi<real>::plan_dft_r2c_2d(c.nZ, c.nX,
+      product, (FftwApi<real>::complex*)productHat, FFTW_MEASURE);
+#ifdef _OPENMP
+  FftwApi<real>::plan_with_nthreads(omp_get_max_threads());
+#endif
+  backwardPlan = FftwApi<real>::plan_dft_c2r_2d(c.nZ, c.nX,
+      (FftwApi<real>::complex*)spectralWork, field, FFTW_MEASURE);
+
+  // Transforms in z of the nN columns of a Variable, only used for I/O
+  int n[] = {c.nZ};
+  mode *columns = vars.tmp.getCurrent() + vars.tmp.calcIndex(0,0);
+#ifdef _OPENMP
+  FftwApi<real>::plan_with_nthreads(1);
+#endif
+  zForwardPlan = FftwApi<real>::plan_many_dft(1, n, c.nN,
+      (FftwApi<real>::complex*)columns, nullptr, vars.tmp.rowSize(), 1,
+      (FftwApi<real>::complex*)spectralWork, nullptr, nXh, 1,
+      FFTW_FORWARD, FFTW_ESTIMATE | FFTW_UNALIGNED);
+#ifdef _OPENMP
+  FftwApi<real>::plan_with_nthreads(1);
+#endif
+  zBackwardPlan = FftwApi<real>::plan_many_dft(1, n, c.nN,
+      (FftwApi<real>::complex*)spectralWork, nullptr, nXh, 1,
+      (FftwApi<real>::complex*)columns, nullptr, vars.tmp.rowSize(), 1,
+      FFTW_BACKWARD, FFTW_ESTIMATE | FFTW_UNALIGNED);
+  }
+}
+
+SpectralSim::~SpectralSim() {
+  // Shares the planner's state, as in FftwBackend
+  #pragma omp critical
+  {
+  FftwApi<real>::destroy_plan(forwardPlan);
+  FftwApi<real>::destroy_plan(backwardPlan);
+  FftwApi<real>::destroy_plan(zForwardPlan);
+  FftwApi<real>::destroy_plan(zBackwardPlan);
+  }
+
+  for(mode *var : {tmp, omg, psi, xi,
+      dTmpdt[0], dTmpdt[1], dOmgdt[0], dOmgdt[1], dXidt[0], dXidt[1],
+      spectralWork, productHat}) {
+    FftwApi<real>::free(var);
+  }
+  for(real *var : {u, w, field, product}) {
+    FftwApi<real>::free(var);
+  }
+}
+
+void SpectralSim::toSpectral(const real *physical, mode *spectral) const {
+  FftwApi<real>::execute_dft_r2c(forwardPlan, const_cast<real*>(physical), (FftwApi<real>::complex*)spectral);
+
+  const real normalisation = 1.0/(c.nX*c.nZ);
+  #pragma omp parallel for schedule(static)
+  for(int i=0; i<nSpectral; ++i) {
+    spectral[i] *= normalisation*dealiasMask[i];
+  }
+}
+
+void SpectralSim::toPhysical(const mode *spectral, real *physical) const {
+  // c2r transforms overwrite their input
+  std::copy(spectral, spectral + nSpectral, spectralWork);
+  FftwApi<real>::execute_dft_c2r(backwardPlan, (FftwApi<real>::complex*)spectralWork, physical);
+}
+
+void SpectralSim::columnsToSpectral(const Variable &var, const int step, mode *spectral) {
+  mode *columns = const_cast<mode*>(var.getPlus(step)) + var.calcIndex(0,0);
+  FftwApi<real>::execute_dft(zForwardPlan, (FftwApi<real>::complex*)columns, (FftwApi<real>::complex*)spectral);
+
+  for(int m=0; m<c.nZ; ++m) {
+    for(int n=0; n<nXh; ++n) {
+      const int i = m*nXh + n;
+      spectral[i] = n < c.nN ? spectral[i]*dealiasMask[i]/real(c.nZ) : 0.0;
+    }
+  }
+}
+
+void SpectralSim::spectralToColumns(const mode *spectral, Variable &var, const int step) {
+  mode *columns = var.getPlus(step) + var.calcIndex(0,0);
+  FftwApi<real>::execute_dft(zBackwardPlan, (FftwApi<real>::complex*)const_cast<mode*>(spectral), (FftwApi<real>::complex*)columns);
+}
+
+void SpectralSim::loadInitialConditions() {
+  vars.load(c.icFile);
+
+  // Derivative slot 0 is the one calculated next, slot 1 the previous step
+  columnsToSpectral(vars.tmp, 0, tmp);
+  columnsToSpectral(vars.omg, 0, omg);
+  for(int step=0; step<2; ++step) {
+    columnsToSpectral(vars.dTmpdt, step, dTmpdt[step]);
+    columnsToSpectral(vars.dOmgdt, step, dOmgdt[step]);
+  }
+  if(c.isDoubleDiffusion) {
+    columnsToSpectral(vars.xi, 0, xi);
+    for(int step=0; step<2; ++step) {
+      columnsToSpectral(vars.dXidt, step, dXidt[step]);
+    }
+  }
+  current = 0;
+
+  solveForPsi();
+}
+
+void SpectralSim::save() {
+  spectralToColumns(tmp, vars.tmp, 0);
+  spectralToColumns(omg, vars.omg, 0);
+  spectralToColumns(psi, vars.psi, 0);
+  spectralToColumns(dTmpdt[current], vars.dTmpdt, 0);
+  spectralToColumns(dTmpdt[1-current], vars.dTmpdt, 1);
+  spectralToColumns(dOmgdt[current], vars.dOmgdt, 0);
+  spectralToColumns(dOmgdt[1-current], vars.dOmgdt, 1);
+  if(c.isDoubleDiffusion) {
+    spectralToColumns(xi, vars.xi, 0);
+    spectralToColumns(dXidt[current], vars.dXidt, 0);
+    spectralToColumns(dXidt[1-current], vars.dXidt, 1);
+  }
+  vars.save();
+}
+
+void SpectralSim::solveForPsi() {
+  // -laplacian(psi) = omega is diagonal in this basis
+  #pragma omp parallel for schedule(static)
+  for(int m=0; m<c.nZ; ++m) {
+    for(int n=0; n<nXh; ++n) {
+      const int i = m*nXh + n;
+      const real k2 = kx[n]*kx[n] + kz[m]*kz[m];
+      psi[i] = k2 > 0.0 ? omg[i]/k2 : 0.0;
+    }
+  }
+}
+
+void SpectralSim::computeLinearDerivatives() {
+  mode *dTmp = dTmpdt[current];
+  mode *dOmg = dOmgdt[current];
+  mode *dXi = dXidt[current];
+
+  #pragma omp parallel for schedule(static)
+  for(int m=0; m<c.nZ; ++m) {
+    for(int n=0; n<nXh; ++n) {
+      const int i = m*nXh + n;
+      const real k2 = kx[n]*kx[n] + kz[m]*kz[m];
+      const mode ddx = kx[n]*c.xCosDerivativeFactor;
+      dTmp[i] = -k2*tmp[i];
+      dOmg[i] = -c.Pr*k2*omg[i] - ddx*c.Pr*c.Ra*tmp[i];
+      if(c.isDoubleDiffusion) {
+        dXi[i] = -c.tau*k2*xi[i];
+        dOmg[i] += ddx*c.RaXi*c.tau*c.Pr*xi[i];
+      }
+    }
+  }
+}
+
+void SpectralSim::computeVelocities() {
+  // u = -dpsi/dz and w = dpsi/dx
+  #pragma omp parallel for schedule(static)
+  for(int m=0; m<c.nZ; ++m) {
+    for(int n=0; n<nXh; ++n) {
+      const int i = m*nXh + n;
+      productHat[i] = -mode(0.0, kz[m])*psi[i];
+    }
+  }
+  toPhysical(productHat, u);
+
+  #pragma omp parallel for schedule(static)
+  for(int m=0; m<c.nZ; ++m) {
+    for(int n=0; n<nXh; ++n) {
+      const int i = m*nXh + n;
+      productHat[i] = mode(0.0, kx[n])*psi[i];
+    }
+  }
+  toPhysical(productHat, w);
+}
+
+void SpectralSim::computeNonlinearDerivative(mode *dVardt, const mode *var) {
+  // Adds -(d(u var)/dx + d(w var)/dz), the same conservative form as Sim.
+  // Expects computeVelocities to have been called.
+  toPhysical(var, field);
+
+  #pragma omp parallel for schedule(static)
+  for(int i=0; i<c.nZ*c.nX; ++i) {
+    product[i] = u[i]*field[i];
+  }
+  toSpectral(product, productHat);
+  #pragma omp parallel for schedule(static)
+  for(int m=0; m<c.nZ; ++m) {
+    for(int n=0; n<nXh; ++n) {
+      const int i = m*nXh + n;
+      dVardt[i] -= mode(0.0, kx[n])*productHat[i];
+    }
+  }
+
+  #pragma omp parallel for schedule(static)
+  for(int i=0; i<c.nZ*c.nX; ++i) {
+    product[i] = w[i]*field[i];
+  }
+  toSpectral(product, productHat);
+  #pragma omp parallel for schedule(static)
+  for(int m=0; m<c.nZ; ++m) {
+    for(int n=0; n<nXh; ++n) {
+      const int i = m*nXh + n;
+      dVardt[i] -= mode(0.0, kz[m])*productHat[i];
+    }
+  }
+}
+
+void SpectralSim::computeNonlinearDerivatives() {
+  computeVelocities();
+
+  computeNonlinearDerivative(dTmpdt[current], tmp);
+  computeNonlinearDerivative(dOmgdt[current], omg);
+  if(c.isDoubleDiffusion) {
+    computeNonlinearDerivative(dXidt[current], xi);
+  }
+
+  // Background gradients, as in Sim::computeNonlinearTemperatureDerivative
+  // and Sim::computeNonlinearXiDerivative for periodic vertical boundaries:
+  // the horizontal mean changes at a constant rate at every height
+  for(int m=0; m<c.nZ; ++m) {
+    dTmpdt[current][m*nXh] = m == 0 ? c.temperatureGradient : 0.0;
+    if(c.isDoubleDiffusion) {
+      dXidt[current][m*nXh] = m == 0 ? c.salinityGradient : 0.0;
+    }
+  }
+}
+
+real SpectralSim::checkCFL() {
+  // As checkCFL in numerical_methods, with exact velocities
+  computeVelocities();
+
+  real vxMax = 0.0;
+  real vzMax = 0.0;
+  bool isNan = false;
+
+  #pragma omp parallel for schedule(static) reduction(max:vxMax,vzMax) reduction(||:isNan)
+  for(int i=0; i<c.nZ*c.nX; ++i) {
+    isNan = isNan or std::isnan(u[i]) or std::isnan(w[i]);
+    vxMax = std::max(vxMax, std::abs(u[i]));
+    vzMax = std::max(vzMax, std::abs(w[i]));
+  }
+
+  if(isNan or dt > c.dz/vzMax or dt > c.dx/vxMax) {
+    cout << "CFL Condition Breached" << endl;
+    exit(-1);
+  }
+
+  return cflTimestepFactor(dt, c.dz/vzMax, c.dx/vxMax);
+}
+
+void SpectralSim::runNonLinearStep(real f) {
+  computeLinearDerivatives();
+  computeNonlinearDerivatives();
+
+  const int previous = 1-current;
+  #pragma omp parallel for schedule(static)
+  for(int i=0; i<nSpectral; ++i) {
+    tmp[i] += adamsBashforth(dTmpdt[current][i], dTmpdt[previous][i], f, dt);
+    omg[i] += adamsBashforth(dOmgdt[current][i], dOmgdt[previous][i], f, dt);
+    if(c.isDoubleDiffusion) {
+      xi[i] += adamsBashforth(dXidt[current][i], dXidt[previous][i], f, dt);
+    }
+  }
+  current = previous;
+
+  solveForPsi();
+}
+
+void SpectralSim::runNonLinear() {
+  loadInitialConditions();
+
+  real saveTime = 0;
+  real CFLCheckTime = 0;
+  real f = 1.0; // Fractional change in dt (if CFL condition being breached)
+  t = 0;
+  while (c.totalTime-t>EPSILON) {
+    if(CFLCheckTime-t < EPSILON) {
+      CFLCheckTime += 1e1*dt;
+      f = checkCFL();
+      dt *= f;
+    }
+    if(saveTime-t < EPSILON) {
+      cout << t << " of " << c.totalTime << "(" << t/c.totalTime*100 << "%)" << endl;
+      saveTime+=c.timeBetweenSaves;
+      save();
+    }
+    runNonLinearStep(f);
+    t+=dt;
+    f=1.0;
+  }
+  printf("%e of %e (%.2f%%)\n", t, c.totalTime, t/c.totalTime*100);
+  save();
+}
@@ -0,0 +1,184 @@
+#include <spike_solver.hpp>
+
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+SpikeSolver::SpikeSolver(const int nN_in, const int nRows_in, const int nPartitions_in) :
+  nPartitions {nPartitions_in},
+  nN {nN_in},
+  nRows {nRows_in},
+  nReduced {2*nPartitions_in}
+{
+  // Every partition needs distinct first and last rows
+  assert(nRows >= 2*nPartitions);
+
+  partitionStarts.resize(nPartitions+1);
+  for(int p=0; p<=nPartitions; ++p) {
+    partitionStarts[p] = (p*nRows)/nPartitions;
+  }
+
+  sub.resize(nN*nRows);
+  wk1.resize(nN*nRows);
+  wk2.resize(nN*nRows);
+  leftSpike.resize(nN*nRows);
+  rightSpike.resize(nN*nRows);
+  reducedLU.resize(nN*nReduced*nReduced);
+  reducedPivots.resize(nN*nReduced);
+}
+
+void SpikeSolver::factorise(const int n, const real *sub_in, const real *dia, const real *sup) {
+  real *s = sub.data() + n*nRows;
+  real *w1 = wk1.data() + n*nRows;
+  real *w2 = wk2.data() + n*nRows;
+  real *left = leftSpike.data() + n*nRows;
+  real *right = rightSpike.data() + n*nRows;
+
+  for(int i=0; i<nRows; ++i) {
+    s[i] = sub_in[i];
+  }
+
+  for(int p=0; p<nPartitions; ++p) {
+    const int a = partitionStarts[p];
+    const int b = partitionStarts[p+1];
+
+    // Thomas factorisation of the partition on its own
+    w1[a] = 1.0/dia[a];
+    w2[a] = sup[a]*w1[a];
+    for(int i=a+1; i<b; ++i) {
+      w1[i] = 1.0/(dia[i] - s[i-1]*w2[i-1]);
+      w2[i] = sup[i]*w1[i];
+    }
+
+    // The left spike couples to the last row of the previous partition and
+    // the right spike to the first row of the next
+    const real leftCoupling = p > 0 ? s[a-1] : 0.0;
+    const real rightCoupling = p < nPartitions-1 ? sup[b-1] : 0.0;
+    left[a] = leftCoupling*w1[a];
+    right[a] = 0.0;
+    for(int i=a+1; i<b; ++i) {
+      left[i] = (-s[i-1]*left[i-1])*w1[i];
+      right[i] = (-s[i-1]*right[i-1])*w1[i];
+    }
+    right[b-1] += rightCoupling*w1[b-1];
+    for(int i=b-2; i>=a; --i) {
+      left[i] -= w2[i]*left[i+1];
+      right[i] -= w2[i]*right[i+1];
+    }
+  }
+
+  // Reduced system for the first (2p) and last (2p+1) values of each
+  // partition:
+  //   x_p = g_p - left_p*last_{p-1} - right_p*first_{p+1}
+  real *lu = reducedLU.data() + n*nReduced*nReduced;
+  int *pivots = reducedPivots.data() + n*nReduced;
+  for(int i=0; i<nReduced*nReduced; ++i) {
+    lu[i] = 0.0;
+  }
+  for(int p=0; p<nPartitions; ++p) {
+    const int ends[] = {partitionStarts[p], partitionStarts[p+1]-1};
+    for(int e=0; e<2; ++e) {
+      const int row = 2*p + e;
+      lu[row*nReduced + row] = 1.0;
+      if(p > 0) {
+        lu[row*nReduced + 2*(p-1)+1] = left[ends[e]];
+      }
+      if(p < nPartitions-1) {
+        lu[row*nReduced + 2*(p+1)] = right[ends[e]];
+      }
+    }
+  }
+
+  // LU factorisation with partial pivoting
+  for(int j=0; j<nReduced; ++j) {
+    int pivot = j;
+    for(int i=j+1; i<nReduced; ++i) {
+      if(std::abs(lu[i*nReduced + j]) > std::abs(lu[pivot*nReduced + j])) {
+        pivot = i;
+      }
+    }
+    pivots[j] = pivot;
+    if(pivot != j) {
+      for(int k=0; k<nReduced; ++k) {
+        std::swap(lu[j*nReduced + k], lu[pivot*nReduced + k]);
+      }
+    }
+    for(int i=j+1; i<nReduced; ++i) {
+      lu[i*nReduced + j] /= lu[j*nReduced + j];
+      for(int k=j+1; k<nReduced; ++k) {
+        lu[i*nReduced + k] -= lu[i*nReduced + j]*lu[j*nReduced + k];
+      }
+    }
+  }
+}
+
+void SpikeSolver::solvePartition(const int n, const int p, Variable& sol, const Variable& rhs) const {
+  const real *s = sub.data() + n*nRows;
+  const real *w1 = wk1.data() + n*nRows;
+  const real *w2 = wk2.data() + n*nRows;
+  const int a = partitionStarts[p];
+  const int b = partitionStarts[p+1];
+
+  sol(n,a) = rhs(n,a)*w1[a];
+  for(int i=a+1; i<b; ++i) {
+    sol(n,i) = (rhs(n,i) - s[i-1]*sol(n,i-1))*w1[i];
+  }
+  for(int i=b-2; i>=a; --i) {
+    sol(n,i) -= w2[i]*sol(n,i+1);
+  }
+}
+
+void SpikeSolver::solveReduced(const int n, mode *ends) const {
+  const real *lu = reducedLU.data() + n*nReduced*nReduced;
+  const int *pivots = reducedPivots.data() + n*nReduced;
+
+  for(int j=0; j<nReduced; ++j) {
+    std::swap(ends[j], ends[pivots[j]]);
+  }
+  for(int j=0; j<nReduced; ++j) {
+    for(int i=j+1; i<nReduced; ++i) {
+      ends[i] -= lu[i*nReduced + j]*ends[j];
+    }
+  }
+  for(int i=nReduced-1; i>=0; --i) {
+    for(int k=i+1; k<nReduced; ++k) {
+      ends[i] -= lu[i*nReduced + k]*ends[k];
+    }
+    ends[i] /= lu[i*nReduced + i];
+  }
+}
+
+void SpikeSolver::solve(Variable& sol, const Variable& rhs, std::vector<mode> &ends) const {
+  // ends is shared workspace of size nN*nReduced
+
+  #pragma omp for schedule(static)
+  for(int p=0; p<nPartitions; ++p) {
+    for(int n=0; n<nN; ++n) {
+      solvePartition(n, p, sol, rhs);
+    }
+  }
+
+  #pragma omp for schedule(static)
+  for(int n=0; n<nN; ++n) {
+    mode *modeEnds = ends.data() + n*nReduced;
+    for(int p=0; p<nPartitions; ++p) {
+      modeEnds[2*p] = sol(n, partitionStarts[p]);
+      modeEnds[2*p+1] = sol(n, partitionStarts[p+1]-1);
+    }
+    solveReduced(n, modeEnds);
+  }
+
+  #pragma omp for schedule(static)
+  for(int p=0; p<nPartitions; ++p) {
+    for(int n=0; n<nN; ++n) {
+      const real *left = leftSpike.data() + n*nRows;
+      const real *right = rightSpike.data() + n*nRows;
+      const mode *modeEnds = ends.data() + n*nReduced;
+      const mode lastOfPrevious = p > 0 ? modeEnds[2*(p-1)+1] : 0.0;
+      const mode firstOfNext = p < nPartitions-1 ? modeEnds[2*(p+1)] : 0.0;
+      for(int i=partitionStarts[p]; i<partitionStarts[p+1]; ++i) {
+        sol(n,i) -= left[i]*lastOfPrevious + right[i]*firstOfNext;
+      }
+    }
+  }
+}
@@ -0,0 +1,143 @@
+#include <split_complex_kernels.hpp>
+#include <boundary_conditions.hpp>
+
+#include <cmath>
+
+SplitComplexKernels::SplitComplexKernels(const Constants &c_in) :
+  c {c_in}
+{
+  precalculate();
+}
+
+void SplitComplexKernels::reparameterise(const Constants &c_in) {
+  c = c_in;
+  precalculate();
+}
+
+void SplitComplexKernels::precalculate() {
+  dfdx2Factors.resize(2*c.nN);
+  normalisations.resize(2*c.nN);
+  tmpFactorsRe.resize(c.nN);
+  tmpFactorsIm.resize(c.nN);
+  xiFactorsRe.resize(c.nN);
+  xiFactorsIm.resize(c.nN);
+
+  for(int n=0; n<c.nN; ++n) {
+    // As in Variable::dfdx2Spectral and Variable::spectralNormalisation
+    const real dfdx2Factor = -pow(real(n)*c.wavelength, 2);
+    real normalisation = 1.0/c.nX;
+    if(c.horizontalBoundaryConditions == BoundaryConditions::impermeable) {
+      normalisation = (n == 0 ? 0.5 : 1.0)/(c.nX-1.0);
+    }
+    dfdx2Factors[2*n] = dfdx2Factors[2*n+1] = dfdx2Factor;
+    normalisations[2*n] = normalisations[2*n+1] = normalisation;
+
+    const mode tmpFactor = n*c.wavelength*c.xCosDerivativeFactor*c.Pr*c.Ra;
+    const mode xiFactor = n*c.wavelength*c.xCosDerivativeFactor*c.RaXi*c.tau*c.Pr;
+    tmpFactorsRe[n] = tmpFactor.real();
+    tmpFactorsIm[n] = tmpFactor.imag();
+    xiFactorsRe[n] = xiFactor.real();
+    xiFactorsIm[n] = xiFactor.imag();
+  }
+}
+
+void SplitComplexKernels::computeLinearTemperatureDerivative(Variables<Variable> &vars, const int kFirst, const int kLast) const {
+  const int nReals = 2*c.nN;
+  const real oodz2 = c.oodz2;
+  const real *dfdx2Factor = dfdx2Factors.data();
+  for(int k=kFirst; k<kLast; ++k) {
+    const real *tmpUp = vars.tmp.realRow(k+1);
+    const real *tmp = vars.tmp.realRow(k);
+    const real *tmpDown = vars.tmp.realRow(k-1);
+    real *dTmpdt = vars.dTmpdt.realRow(k);
+    #pragma omp simd
+    for(int i=0; i<nReals; ++i) {
+      dTmpdt[i] = (tmpUp[i] - real(2.0)*tmp[i] + tmpDown[i])*oodz2 + dfdx2Factor[i]*tmp[i];
+    }
+  }
+}
+
+void SplitComplexKernels::computeLinearVorticityDerivative(Variables<Variable> &vars, const int kFirst, const int kLast) const {
+  const real oodz2 = c.oodz2;
+  const real Pr = c.Pr;
+  const real *dfdx2Factor = dfdx2Factors.data();
+  const real *tmpFactorRe = tmpFactorsRe.data();
+  const real *tmpFactorIm = tmpFactorsIm.data();
+  for(int k=kFirst; k<kLast; ++k) {
+    const real *omgUp = vars.omg.realRow(k+1);
+    const real *omg = vars.omg.realRow(k);
+    const real *omgDown = vars.omg.realRow(k-1);
+    const real *tmp = vars.tmp.realRow(k);
+    real *dOmgdt = vars.dOmgdt.realRow(k);
+    #pragma omp simd
+    for(int n=0; n<c.nN; ++n) {
+      const int re = 2*n;
+      const int im = 2*n+1;
+      const real laplacianRe = (omgUp[re] - real(2.0)*omg[re] + omgDown[re])*oodz2 + dfdx2Factor[re]*omg[re];
+      const real laplacianIm = (omgUp[im] - real(2.0)*omg[im] + omgDown[im])*oodz2 + dfdx2Factor[im]*omg[im];
+      dOmgdt[re] = Pr*laplacianRe - (tmpFactorRe[n]*tmp[re] - tmpFactorIm[n]*tmp[im]);
+      dOmgdt[im] = Pr*laplacianIm - (tmpFactorRe[n]*tmp[im] + tmpFactorIm[n]*tmp[re]);
+    }
+  }
+}
+
+void SplitComplexKernels::computeLinearXiDerivative(Variables<Variable> &vars, const int kFirst, const int kLast) const {
+  const real oodz2 = c.oodz2;
+  const real tau = c.tau;
+  const real *dfdx2Factor = dfdx2Factors.data();
+  const real *xiFactorRe = xiFactorsRe.data();
+  const real *xiFactorIm = xiFactorsIm.data();
+  for(int k=kFirst; k<kLast; ++k) {
+    const real *xiUp = vars.xi.realRow(k+1);
+    const real *xi = vars.xi.realRow(k);
+    const real *xiDown = vars.xi.realRow(k-1);
+    real *dXidt = vars.dXidt.realRow(k);
+    real *dOmgdt = vars.dOmgdt.realRow(k);
+    #pragma omp simd
+    for(int n=0; n<c.nN; ++n) {
+      const int re = 2*n;
+      const int im = 2*n+1;
+      dXidt[re] = tau*((xiUp[re] - real(2.0)*xi[re] + xiDown[re])*oodz2 + dfdx2Factor[re]*xi[re]);
+      dXidt[im] = tau*((xiUp[im] - real(2.0)*xi[im] + xiDown[im])*oodz2 + dfdx2Factor[im]*xi[im]);
+      dOmgdt[re] += xiFactorRe[n]*xi[re] - xiFactorIm[n]*xi[im];
+      dOmgdt[im] += xiFactorRe[n]*xi[im] + xiFactorIm[n]*xi[re];
+    }
+  }
+}
+
+void SplitComplexKernels::addNonlinearTerm(Variable &dVardt, const Variable &nonlinearTerm) const {
+  const int nReals = 2*c.nN;
+  const real *normalisation = normalisations.data();
+  for(int k=0; k<c.nZ; ++k) {
+    const real *term = nonlinearTerm.realRow(k);
+    real *dVardtRow = dVardt.realRow(k);
+    #pragma omp simd
+    for(int i=0; i<nReals; ++i) {
+      dVardtRow[i] += normalisation[i]*term[i];
+    }
+  }
+}
+
+void SplitComplexKernels::update(Variable &var, const Variable &dVardt, const real dt, const real f) const {
+  // adamsBashforth, with the coefficients hoisted
+  const int nReals = 2*c.nN;
+  const real currentFactor = 2.0+f;
+  const real halfDt = dt/2.0;
+  for(int k=0; k<c.nZ; ++k) {
+    const real *current = dVardt.realRow(k);
+    const real *previous = dVardt.realPrevRow(k);
+    real *varRow = var.realRow(k);
+    #pragma omp simd
+    for(int i=0; i<nReals; ++i) {
+      varRow[i] += (currentFactor*current[i] - f*previous[i])*halfDt;
+    }
+  }
+}
+
+void SplitComplexKernels::updateVars(Variables<Variable> &vars, const real dt, const real f) const {
+  update(vars.tmp, vars.dTmpdt, dt, f);
+  update(vars.omg, vars.dOmgdt, dt, f);
+  if(c.isDoubleDiffusion) {
+    update(vars.xi, vars.dXidt, dt, f);
+  }
+}
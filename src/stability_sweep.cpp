@@ -0,0 +1,217 @@
+#include <stability_sweep.hpp>
+#include <linear_stability_solver.hpp>
+#include <variables.hpp>
+
+#include <json.hpp>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef USE_MPI
+#include <mpi.h>
+#include <mpi_work_queue.hpp>
+#endif
+
+using std::cout;
+using std::endl;
+
+template<typename T>
+std::vector<T> readRange(const nlohmann::json &j, const std::string &name, const T defaultValue) {
+  // A range is either a single value, a list of values or
+  // {"min": a, "max": b, "count": N} with optional "log": true
+  std::vector<T> values;
+  if(j.find(name) == j.end()) {
+    values.push_back(defaultValue);
+    return values;
+  }
+
+  const nlohmann::json &range = j[name];
+  if(range.is_number()) {
+    values.push_back(range.get<T>());
+  } else if(range.is_array()) {
+    for(auto &value : range) {
+      values.push_back(value.get<T>());
+    }
+  } else if(range.is_object()) {
+    real min = range["min"];
+    real max = range["max"];
+    int count = range["count"];
+    bool isLog = range.find("log") != range.end() and range["log"].get<bool>();
+    for(int i=0; i<count; ++i) {
+      real frac = count > 1 ? real(i)/(count-1) : 0.0;
+      if(isLog) {
+        values.push_back(T(min*pow(max/min, frac)));
+      } else {
+        values.push_back(T(min + (max-min)*frac));
+      }
+    }
+  }
+  return values;
+}
+
+StabilitySweep::StabilitySweep(const Constants &c_in, const std::string &sweepFile):
+  c(c_in)
+{
+  nlohmann::json j;
+
+  std::ifstream in(sweepFile);
+  if(not in.is_open()) {
+    cout << "Couldn't open " << sweepFile << " for reading. Aborting." << endl;
+    exit(-1);
+  }
+  in >> j;
+  in.close();
+
+  modes = readRange<int>(j, "n", 1);
+  Ras = readRange<real>(j, "Ra", c.Ra);
+  RaXis = readRange<real>(j, "RaXi", c.isDoubleDiffusion ? c.RaXi : 0.0);
+  taus = readRange<real>(j, "tau", c.isDoubleDiffusion ? c.tau : 0.0);
+  Prs = readRange<real>(j, "Pr", c.Pr);
+  aspectRatios = readRange<real>(j, "aspectRatio", c.aspectRatio);
+
+  if (j.find("output") != j.end()) {
+    outputFile = j["output"];
+  } else {
+    outputFile = c.saveFolder + "stability_map.dat";
+  }
+}
+
+int StabilitySweep::nPoints() const {
+  return modes.size()*Ras.size()*RaXis.size()*taus.size()*Prs.size()*aspectRatios.size();
+}
+
+void StabilitySweep::setParameters(Constants &cPoint, const int i, int &n) const {
+  // Points are ordered row-major over (n, Ra, RaXi, tau, Pr, aspectRatio)
+  int index = i;
+  cPoint.aspectRatio = aspectRatios[index%aspectRatios.size()];
+  index /= aspectRatios.size();
+  cPoint.Pr = Prs[index%Prs.size()];
+  index /= Prs.size();
+  cPoint.tau = taus[index%taus.size()];
+  index /= taus.size();
+  cPoint.RaXi = RaXis[index%RaXis.size()];
+  index /= RaXis.size();
+  cPoint.Ra = Ras[index%Ras.size()];
+  index /= Ras.size();
+  n = modes[index];
+
+  cPoint.calculateDerivedConstants();
+}
+
+void StabilitySweep::run() {
+  cout << "Sweeping " << nPoints() << " parameter points" << endl;
+
+  // Background gradients are taken from the initial conditions, as in Sim
+  Variables<Variable> vars(c);
+  vars.load(c.icFile);
+
+  eigenvalues.resize(nPoints());
+
+  #pragma omp parallel
+  {
+    LinearStabilitySolver solver(c);
+    solver.setBackground(vars.tmp, vars.xi);
+
+    #pragma omp for schedule(dynamic)
+    for(int i=0; i<nPoints(); ++i) {
+      int n;
+      setParameters(solver.c, i, n);
+      eigenvalues[i] = solver.calcLeadingEigenvalue(n);
+    }
+  }
+
+  writeResults(outputFile);
+}
+
+#ifdef USE_MPI
+void StabilitySweep::runDistributed() {
+  // A task is a chunk of consecutive points, evaluated by the threads of one
+  // rank. Ranks may have different numbers of threads, so rank 0 chooses the
+  // chunk size for all of them.
+  int nThreads = 1;
+#ifdef _OPENMP
+  nThreads = omp_get_max_threads();
+#endif
+  int chunkSize = 2*nThreads;
+  MPI_Bcast(&chunkSize, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  const int nChunks = (nPoints() + chunkSize - 1)/chunkSize;
+
+  MpiWorkQueue queue(nChunks, 2*chunkSize);
+  if(queue.isRoot()) {
+    cout << "Sweeping " << nPoints() << " parameter points in " << nChunks
+      << " chunks on " << std::max(1, queue.nRanks-1) << " MPI ranks" << endl;
+  }
+
+  // Rank 0 only hands out chunks when there are other ranks
+  std::vector<LinearStabilitySolver*> solvers;
+  if(queue.isRunningTasks()) {
+    Variables<Variable> vars(c);
+    vars.load(c.icFile);
+    for(int i=0; i<nThreads; ++i) {
+      solvers.push_back(new LinearStabilitySolver(c));
+      solvers[i]->setBackground(vars.tmp, vars.xi);
+    }
+  }
+
+  queue.run([&](int chunk, real *result) {
+    int first = chunk*chunkSize;
+    int last = std::min(first + chunkSize, nPoints());
+    #pragma omp parallel for schedule(dynamic)
+    for(int i=first; i<last; ++i) {
+      int thread = 0;
+#ifdef _OPENMP
+      thread = omp_get_thread_num();
+#endif
+      int n;
+      setParameters(solvers[thread]->c, i, n);
+      mode eigenvalue = solvers[thread]->calcLeadingEigenvalue(n);
+      result[2*(i-first)] = eigenvalue.real();
+      result[2*(i-first)+1] = eigenvalue.imag();
+    }
+  });
+
+  for(LinearStabilitySolver *solver : solvers) {
+    delete solver;
+  }
+
+  if(queue.isRoot()) {
+    eigenvalues.resize(nPoints());
+    for(int i=0; i<nPoints(); ++i) {
+      eigenvalues[i] = mode(queue.results[2*i], queue.results[2*i+1]);
+    }
+    writeResults(outputFile);
+  }
+}
+#endif
+
+void StabilitySweep::writeResults(const std::string &filePath) const {
+  std::ofstream file(filePath);
+  if(not file.is_open()) {
+    cout << "Couldn't open " << filePath << " for writing. Aborting." << endl;
+    exit(-1);
+  }
+
+  file << "# shape: " << modes.size() << " " << Ras.size() << " " << RaXis.size() << " "
+    << taus.size() << " " << Prs.size() << " " << aspectRatios.size() << endl;
+  file << "# n Ra RaXi tau Pr aspectRatio growthRate frequency" << endl;
+  file << std::setprecision(10);
+
+  Constants cPoint(c);
+  for(int i=0; i<nPoints(); ++i) {
+    int n;
+    setParameters(cPoint, i, n);
+    file << n << " "
+      << cPoint.Ra << " " << cPoint.RaXi << " " << cPoint.tau << " "
+      << cPoint.Pr << " " << cPoint.aspectRatio << " "
+      << eigenvalues[i].real() << " " << eigenvalues[i].imag() << endl;
+  }
+  file.close();
+
+  cout << "Stability map written to " << filePath << endl;
+}
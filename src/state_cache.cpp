@@ -0,0 +1,164 @@
+#include <state_cache.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using std::cout;
+using std::endl;
+
+namespace {
+  void regrid(const Variable &from, Variable &to, const bool isPeriodic) {
+    // Modes beyond the smaller nN are dropped or zero. In z, the profile of
+    // each mode is linearly interpolated onto the new points.
+    for(int i=0; i<to.getTotalSteps(); ++i) {
+      const mode *fromData = from.getPlus(i);
+      mode *toData = to.getPlus(i);
+      for(int n=0; n<to.nN; ++n) {
+        for(int k=0; k<to.nZ; ++k) {
+          mode value = 0.0;
+          if(n < from.nN) {
+            real z = isPeriodic ? real(k)/to.nZ : real(k)/(to.nZ-1);
+            real position = isPeriodic ? z*from.nZ : z*(from.nZ-1);
+            int kBelow = std::min(int(position), isPeriodic ? from.nZ-1 : from.nZ-2);
+            int kAbove = isPeriodic ? (kBelow+1)%from.nZ : kBelow+1;
+            real frac = position - kBelow;
+            value = (1.0-frac)*fromData[from.calcIndex(n,kBelow)] + frac*fromData[from.calcIndex(n,kAbove)];
+          }
+          toData[to.calcIndex(n,k)] = value;
+        }
+      }
+    }
+    to.topBoundary = to(0,to.nZ-1);
+    to.bottomBoundary = to(0,0);
+  }
+}
+
+StateCache::StateCache(const std::string &folder_in):
+  folder(folder_in)
+{}
+
+std::string StateCache::createKey(const Constants &c) const {
+  // Parameters and grid, so that each distinct run has its own entry
+  char buff[256];
+  snprintf(buff, sizeof(buff), "nN%d_nZ%d_nX%d_Ra%.6g_Pr%.6g_a%.6g_v%d_h%d",
+      c.nN, c.nZ, c.nX, c.Ra, c.Pr, c.aspectRatio,
+      int(c.verticalBoundaryConditions), int(c.horizontalBoundaryConditions));
+  std::string key(buff);
+  if(c.isDoubleDiffusion) {
+    snprintf(buff, sizeof(buff), "_RaXi%.6g_tau%.6g", c.RaXi, c.tau);
+    key += buff;
+  }
+  return key;
+}
+
+void StateCache::store(const Constants &c, const Variables<Variable> &vars) const {
+  mkdir(folder.c_str(), 0755);
+  std::string path = folder + "/" + createKey(c);
+
+  // Written under a temporary name and renamed, so concurrent runs never see
+  // a partial state
+  vars.writeToFile(path + ".dat.tmp");
+  std::rename((path + ".dat.tmp").c_str(), (path + ".dat").c_str());
+  c.writeJson(path + ".json.tmp");
+  std::rename((path + ".json.tmp").c_str(), (path + ".json").c_str());
+}
+
+real StateCache::distance(const Constants &c1, const Constants &c2) {
+  // Parameters span orders of magnitude, so they are compared in log space
+  auto logRatio = [](const real a, const real b) {
+    return std::log(a/b);
+  };
+  real d = pow(logRatio(c1.Ra, c2.Ra), 2)
+    + pow(logRatio(c1.Pr, c2.Pr), 2)
+    + pow(logRatio(c1.aspectRatio, c2.aspectRatio), 2);
+  if(c1.isDoubleDiffusion) {
+    d += pow(logRatio(c1.RaXi, c2.RaXi), 2) + pow(logRatio(c1.tau, c2.tau), 2);
+  }
+  return std::sqrt(d);
+}
+
+bool StateCache::findNearest(const Constants &c, std::string &stateFile, Constants &cached) const {
+  DIR *dir = opendir(folder.c_str());
+  if(dir == nullptr) {
+    return false;
+  }
+
+  std::vector<std::string> names;
+  struct dirent *entry;
+  while((entry = readdir(dir)) != nullptr) {
+    std::string name = entry->d_name;
+    if(name.size() > 5 and name.substr(name.size()-5) == ".json") {
+      names.push_back(name.substr(0, name.size()-5));
+    }
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+
+  real bestDistance = std::numeric_limits<real>::max();
+  for(const std::string &name : names) {
+    std::string path = folder + "/" + name;
+    struct stat pathStat;
+    if(stat((path + ".dat").c_str(), &pathStat) != 0) {
+      continue;
+    }
+
+    Constants candidate(path + ".json");
+    // Only states of the same kind of system are usable
+    if(candidate.isDoubleDiffusion != c.isDoubleDiffusion
+        or candidate.verticalBoundaryConditions != c.verticalBoundaryConditions
+        or candidate.horizontalBoundaryConditions != c.horizontalBoundaryConditions) {
+      continue;
+    }
+
+    // Prefer the same grid when parameters are equally close
+    real d = distance(c, candidate) + (c.isSameGridShape(candidate) ? 0.0 : 1e-12);
+    if(d < bestDistance) {
+      bestDistance = d;
+      stateFile = path + ".dat";
+      cached = candidate;
+    }
+  }
+  return bestDistance < std::numeric_limits<real>::max();
+}
+
+bool StateCache::load(const Constants &c, Variables<Variable> &vars) const {
+  std::string stateFile;
+  Constants cached;
+  if(not findNearest(c, stateFile, cached)) {
+    cout << "No cached state found in " << folder << endl;
+    return false;
+  }
+
+  cout << "Warm start from " << stateFile
+    << " (Ra " << cached.Ra << ", Pr " << cached.Pr << ", aspectRatio " << cached.aspectRatio;
+  if(c.isDoubleDiffusion) {
+    cout << ", RaXi " << cached.RaXi << ", tau " << cached.tau;
+  }
+  cout << ", distance " << distance(c, cached) << ")" << endl;
+
+  if(c.isSameGridShape(cached)) {
+    vars.load(stateFile);
+  } else {
+    cout << "Regridding from nN " << cached.nN << ", nZ " << cached.nZ << endl;
+    Variables<Variable> cachedVars(cached);
+    cachedVars.load(stateFile);
+    bool isPeriodic = c.verticalBoundaryConditions == BoundaryConditions::periodic;
+    for(int i=0; i<vars.variableList.size(); ++i) {
+      regrid(*cachedVars.variableList[i], *vars.variableList[i], isPeriodic);
+    }
+  }
+
+  if(distance(c, cached) > 0.0) {
+    // The stored time derivatives belong to other parameters, so the first
+    // step starts the multistep scheme afresh
+    vars.dTmpdt.fill(0.0);
+    vars.dOmgdt.fill(0.0);
+    vars.dXidt.fill(0.0);
+  }
+  return true;
+}
@@ -0,0 +1,54 @@
+#include <stretched_grid.hpp>
+
+#include <cmath>
+#include <algorithm>
+
+StretchedGrid::StretchedGrid(const std::string &stretching, const real factor, const int nZ_in)
+  : nZ(nZ_in)
+  , ds(1.0/(nZ_in-1))
+{
+  z.resize(nZ);
+  dsdz.resize(nZ);
+  d2sdz2.resize(nZ);
+
+  for(int k=0; k<nZ; ++k) {
+    const real u = factor*(2.0*k*ds - 1.0);
+    real dzds, d2zds2;
+    if(stretching == "boundaries") {
+      const real scale = 1.0/tanh(factor);
+      const real sech2 = 1.0/pow(cosh(u), 2);
+      z[k] = 0.5*(1.0 + tanh(u)*scale);
+      dzds = factor*sech2*scale;
+      d2zds2 = -4.0*factor*factor*sech2*tanh(u)*scale;
+    } else if(stretching == "interface") {
+      const real scale = 1.0/sinh(factor);
+      z[k] = 0.5*(1.0 + sinh(u)*scale);
+      dzds = factor*cosh(u)*scale;
+      d2zds2 = 2.0*factor*factor*sinh(u)*scale;
+    } else {
+      z[k] = k*ds;
+      dzds = 1.0;
+      d2zds2 = 0.0;
+    }
+    dsdz[k] = 1.0/dzds;
+    d2sdz2[k] = -d2zds2/pow(dzds, 3);
+  }
+}
+
+bool StretchedGrid::isValidStretching(const std::string &stretching) {
+  return stretching == "uniform"
+    or stretching == "boundaries"
+    or stretching == "interface";
+}
+
+real StretchedGrid::spacing(const int k) const {
+  return ds/dsdz[k];
+}
+
+real StretchedGrid::minSpacing() const {
+  real result = spacing(0);
+  for(int k=1; k<nZ; ++k) {
+    result = std::min(result, spacing(k));
+  }
+  return result;
+}
@@ -1,6 +1,10 @@
 #include <thomas_algorithm.hpp>
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 ThomasAlgorithm::~ThomasAlgorithm() {
   delete[] wk1;
@@ -12,20 +16,33 @@ ThomasAlgorithm::~ThomasAlgorithm() {
   if(rhs2 != nullptr) {
     delete [] rhs2;
   }
+  if(spikeSolver != nullptr) {
+    delete spikeSolver;
+  }
+  if(stretchedGrid != nullptr) {
+    delete stretchedGrid;
+  }
 }
 
 ThomasAlgorithm::ThomasAlgorithm(const Constants& c_in) :
   nZ {c_in.nZ},
   nN {c_in.nN},
+  isCompact {c_in.isCompact},
   oodz2 {c_in.oodz2},
   wavelength {c_in.wavelength},
   sol2 {nullptr},
   isPeriodic{c_in.verticalBoundaryConditions == BoundaryConditions::periodic},
-  rhs2 {nullptr}
+  rhs2 {nullptr},
+  spikeSolver {nullptr},
+  stretchedGrid {nullptr}
 {
+  if(c_in.verticalStretching != "uniform") {
+    stretchedGrid = new StretchedGrid(c_in.verticalStretching, c_in.stretchingFactor, nZ);
+  }
+
   wk1 = new real [nN*nZ];
   wk2 = new real [nN*nZ];
-  sub = new real [nZ];
+  sub = new real [nN*nZ];
 
   if(isPeriodic) {
     sol2 = new mode[nZ-1];
@@ -35,32 +52,101 @@ ThomasAlgorithm::ThomasAlgorithm(const Constants& c_in) :
     }
   }
 
+#ifdef _OPENMP
+  const int nThreads = omp_get_max_threads();
+#else
+  const int nThreads = 1;
+#endif
+  // With fewer modes than threads, each mode's rows are split over the
+  // threads instead
+  const int nRows = isPeriodic ? nZ-1 : nZ;
+  if(nN < nThreads and nRows >= 2*nThreads and not isCompact) {
+    spikeSolver = new SpikeSolver(nN, nRows, nThreads);
+  }
+  isRowSweep = c_in.isSplitComplexKernels and not isPeriodic and not isCompact
+    and spikeSolver == nullptr;
+
   precalculate();
 }
 
+void ThomasAlgorithm::reparameterise(const Constants& c_in) {
+  assert(c_in.nN == nN and c_in.nZ == nZ);
+  isRowSweep = c_in.isSplitComplexKernels and not isPeriodic and not isCompact
+    and spikeSolver == nullptr;
+  if(c_in.oodz2 != oodz2 or c_in.wavelength != wavelength) {
+    oodz2 = c_in.oodz2;
+    wavelength = c_in.wavelength;
+    precalculate();
+  } else if(isRowSweep and wk1Rows.empty()) {
+    transposeForRows();
+  }
+}
+
 void ThomasAlgorithm::precalculate() {
   // Precalculate tridiagonal arrays
   real * dia = new real [nZ];
   real * sup = new real [nZ];
-  for(int k=0; k<nZ; ++k) {
-    sub[k] = sup[k] = -oodz2;
-  }
   for(int n=0; n<nN; ++n) {
+    real *subN = sub + n*nZ;
     for(int k=0; k<nZ; ++k){
-      dia[k] = pow(wavelength*real(n), 2) + 2.0*oodz2;
+      subN[k] = sup[k] = offDiagonal(n);
+      dia[k] = diagonal(n);
+    }
+    if(stretchedGrid != nullptr) {
+      // -(s_z^2 d2/ds2 + s_zz d/ds) with central differences in s
+      const real oodz = sqrt(oodz2);
+      for(int k=1; k<nZ-1; ++k) {
+        const real secondOrder = pow(stretchedGrid->dsdz[k], 2)*oodz2;
+        const real firstOrder = stretchedGrid->d2sdz2[k]*oodz*0.5;
+        subN[k-1] = -(secondOrder - firstOrder);
+        sup[k] = -(secondOrder + firstOrder);
+        dia[k] = pow(wavelength*real(n), 2) + 2.0*secondOrder;
+      }
     }
     if(not isPeriodic) {
       // This encodes impermeable vertical boundary conditions
       dia[0] = dia[nZ-1] = 1.0;
-      sub[nZ-2] = sup[0] = 0.0;
+      subN[nZ-2] = sup[0] = 0.0;
     }
     formTriDiagonalArraysForN(
-    sub, dia, sup,
+    subN, dia, sup,
     wk1+n*nZ, wk2+n*nZ);
+    if(spikeSolver != nullptr) {
+      spikeSolver->factorise(n, subN, dia, sup);
+    }
+  }
+
+  if(spikeSolver != nullptr and isPeriodic) {
+    // The Sherman-Morrison correction vectors only depend on the matrix
+    periodicSpikes.assign(nN*(nZ-1), 0.0);
+    std::vector<mode> rhs2Local(nZ-1, 0.0);
+    for(int n=0; n<nN; ++n) {
+      rhs2Local[0] = rhs2Local[nZ-2] = -offDiagonal(n);
+      solveSystem(periodicSpikes.data() + n*(nZ-1), rhs2Local.data(), nZ-1, n);
+    }
   }
 
   delete [] dia;
   delete [] sup;
+
+  if(isRowSweep) {
+    transposeForRows();
+  }
+}
+
+void ThomasAlgorithm::transposeForRows() {
+  const int nReals = 2*nN;
+  wk1Rows.resize(nZ*nReals);
+  wk2Rows.resize(nZ*nReals);
+  subRows.resize(nZ*nReals);
+  for(int k=0; k<nZ; ++k) {
+    for(int i=0; i<nReals; ++i) {
+      const int n = i/2;
+      wk1Rows[k*nReals + i] = wk1[n*nZ + k];
+      wk2Rows[k*nReals + i] = wk2[n*nZ + k];
+      subRows[k*nReals + i] = sub[n*nZ + k];
+    }
+  }
 }
 
 void ThomasAlgorithm::formTriDiagonalArraysForN (
@@ -87,7 +173,7 @@ void ThomasAlgorithm::solveSystem(mode *sol, const mode *rhs, const int matrixN,
   // Forward Subsitution
   sol[0] = rhs[0]*wk1[0+iN];
   for (int i=1; i<matrixN; ++i) {
-    sol[i] = (rhs[i] - sub[i-1]*sol[i-1])*wk1[i+iN];
+    sol[i] = (rhs[i] - sub[i-1+iN]*sol[i-1])*wk1[i+iN];
   }
   // Backward Substitution
   for (int i=matrixN-2; i>=0; --i) {
@@ -105,7 +191,7 @@ void ThomasAlgorithm::solveSystem(Variable& sol, const Variable& rhs, const int
   // Forward Subsitution
   sol(n,0) = rhs(n,0)*wk1[0+iN];
   for (int i=1; i<matrixN; ++i) {
-    sol(n,i) = (rhs(n,i) - sub[i-1]*sol(n,i-1))*wk1[i+iN];
+    sol(n,i) = (rhs(n,i) - sub[i-1+iN]*sol(n,i-1))*wk1[i+iN];
   }
   // Backward Substitution
   for (int i=matrixN-2; i>=0; --i) {
@@ -117,8 +203,8 @@ void ThomasAlgorithm::solvePeriodicSystem(Variable& sol, const Variable& rhs, co
   solveSystem(sol, rhs, nZ-1, n);
 
   mode a, b, c;
-  a = c = -oodz2;
-  b = pow(wavelength*real(n), 2) + 2*oodz2;
+  a = c = offDiagonal(n);
+  b = diagonal(n);
   rhs2[0] = -a;
   rhs2[nZ-2] = -c;
   solveSystem(sol2, rhs2, nZ-1, n);
@@ -131,10 +217,177 @@ void ThomasAlgorithm::solvePeriodicSystem(Variable& sol, const Variable& rhs, co
   sol(n,nZ-1) = x_last;
 }
 
-void ThomasAlgorithm::solve(Variable& sol, const Variable& rhs, const int n) const {
+void ThomasAlgorithm::solvePeriodicSystem(mode *sol, const mode *rhs, const int n) const {
+  // As above, but with local workspace so that modes can be solved concurrently
+  solveSystem(sol, rhs, nZ-1, n);
+
+  std::vector<mode> sol2Local(nZ-1);
+  std::vector<mode> rhs2Local(nZ-1, 0.0);
+  mode a, b, c;
+  a = c = offDiagonal(n);
+  b = diagonal(n);
+  rhs2Local[0] = -a;
+  rhs2Local[nZ-2] = -c;
+  solveSystem(sol2Local.data(), rhs2Local.data(), nZ-1, n);
+
+  mode x_last = (rhs[nZ-1] - c*sol[0] - a*sol[nZ-2])/(b + a*sol2Local[nZ-2] + c*sol2Local[0]);
+
+  for(int k=0; k<nZ-1; ++k) {
+    sol[k] += x_last*sol2Local[k];
+  }
+  sol[nZ-1] = x_last;
+}
+
+real ThomasAlgorithm::diagonal(const int n) const {
+  if(isCompact) {
+    return pow(wavelength*real(n), 2) + 2.4*oodz2;
+  }
+  return pow(wavelength*real(n), 2) + 2.0*oodz2;
+}
+
+real ThomasAlgorithm::offDiagonal(const int n) const {
+  if(isCompact) {
+    return -1.2*oodz2 + 0.1*pow(wavelength*real(n), 2);
+  }
+  return -oodz2;
+}
+
+void ThomasAlgorithm::formCompactRhs(const mode *rhs, const int stride, mode *compactRhs) const {
+  // The compact scheme for the second derivative applies
+  // 1/10 f_{k-1} + f_k + 1/10 f_{k+1} to the right hand side
+  for(int k=0; k<nZ; ++k) {
+    if(isPeriodic) {
+      compactRhs[k] = rhs[k*stride]
+        + 0.1*(rhs[((k+nZ-1)%nZ)*stride] + rhs[((k+1)%nZ)*stride]);
+    } else if(k == 0 or k == nZ-1) {
+      compactRhs[k] = rhs[k*stride];
+    } else {
+      compactRhs[k] = rhs[k*stride] + 0.1*(rhs[(k-1)*stride] + rhs[(k+1)*stride]);
+    }
+  }
+}
+
+void ThomasAlgorithm::solveColumn(mode *sol, const mode *rhs, const int n) const {
   if(isPeriodic) {
     solvePeriodicSystem(sol, rhs, n);
   } else {
     solveSystem(sol, rhs, nZ, n);
   }
 }
+
+void ThomasAlgorithm::solve(Variable& sol, const Variable& rhs, const int n) const {
+  if(isCompact) {
+    std::vector<mode> compactRhs(nZ);
+    std::vector<mode> column(nZ);
+    formCompactRhs(&rhs(n,0), rhs.getRowStride(), compactRhs.data());
+    solveColumn(column.data(), compactRhs.data(), n);
+    for(int k=0; k<nZ; ++k) {
+      sol(n,k) = column[k];
+    }
+  } else if(isPeriodic) {
+    solvePeriodicSystem(sol, rhs, n);
+  } else {
+    solveSystem(sol, rhs, nZ, n);
+  }
+}
+
+void ThomasAlgorithm::solve(mode *sol, const mode *rhs, const int n) const {
+  // Solves for a single mode stored contiguously in z
+  if(isCompact) {
+    std::vector<mode> compactRhs(nZ);
+    formCompactRhs(rhs, 1, compactRhs.data());
+    solveColumn(sol, compactRhs.data(), n);
+  } else {
+    solveColumn(sol, rhs, n);
+  }
+}
+
+void ThomasAlgorithm::solveAllModesInRows(Variable& sol, const Variable& rhs) const {
+  // The same recurrences as solveSystem, run down the rows for a block of
+  // modes at a time, so that the inner loops are over contiguous reals.
+  // Each block is a few vectors wide and the blocks are shared out over
+  // the threads.
+  const int nReals = 2*nN;
+  const int blockSize = 32;
+  #pragma omp parallel for schedule(static)
+  for(int iFirst=0; iFirst<nReals; iFirst+=blockSize) {
+    const int iLast = std::min(nReals, iFirst+blockSize);
+
+    // Forward substitution
+    {
+      const real *rhsRow = rhs.realRow(0);
+      real *solRow = sol.realRow(0);
+      #pragma omp simd
+      for(int i=iFirst; i<iLast; ++i) {
+        solRow[i] = rhsRow[i]*wk1Rows[i];
+      }
+    }
+    for(int k=1; k<nZ; ++k) {
+      const real *rhsRow = rhs.realRow(k);
+      const real *solBelow = sol.realRow(k-1);
+      real *solRow = sol.realRow(k);
+      const real *subRow = subRows.data() + (k-1)*nReals;
+      const real *wk1Row = wk1Rows.data() + k*nReals;
+      #pragma omp simd
+      for(int i=iFirst; i<iLast; ++i) {
+        solRow[i] = (rhsRow[i] - subRow[i]*solBelow[i])*wk1Row[i];
+      }
+    }
+
+    // Backward substitution
+    for(int k=nZ-2; k>=0; --k) {
+      const real *solAbove = sol.realRow(k+1);
+      real *solRow = sol.realRow(k);
+      const real *wk2Row = wk2Rows.data() + k*nReals;
+      #pragma omp simd
+      for(int i=iFirst; i<iLast; ++i) {
+        solRow[i] -= wk2Row[i]*solAbove[i];
+      }
+    }
+  }
+}
+
+void ThomasAlgorithm::solveAllModes(Variable& sol, const Variable& rhs) const {
+  if(isRowSweep) {
+    solveAllModesInRows(sol, rhs);
+    return;
+  }
+  if(spikeSolver == nullptr) {
+    #pragma omp parallel for schedule(dynamic)
+    for(int n=0; n<nN; ++n) {
+      solve(sol, rhs, n);
+    }
+    return;
+  }
+
+  std::vector<mode> ends(nN*2*spikeSolver->nPartitions);
+  std::vector<mode> xLast(nN);
+  #pragma omp parallel num_threads(spikeSolver->nPartitions)
+  {
+    spikeSolver->solve(sol, rhs, ends);
+
+    if(isPeriodic) {
+      // Sherman-Morrison correction, as in solvePeriodicSystem
+      #pragma omp for schedule(static)
+      for(int n=0; n<nN; ++n) {
+        const mode *sol2Mode = periodicSpikes.data() + n*(nZ-1);
+        mode a, b, c;
+        a = c = offDiagonal(n);
+        b = diagonal(n);
+        xLast[n] = (rhs(n,nZ-1) - c*sol(n,0) - a*sol(n,nZ-2))/(b + a*sol2Mode[nZ-2] + c*sol2Mode[0]);
+      }
+
+      #pragma omp for schedule(static)
+      for(int k=0; k<nZ-1; ++k) {
+        for(int n=0; n<nN; ++n) {
+          sol(n,k) += xLast[n]*periodicSpikes[n*(nZ-1) + k];
+        }
+      }
+
+      #pragma omp single
+      for(int n=0; n<nN; ++n) {
+        sol(n,nZ-1) = xLast[n];
+      }
+    }
+  }
+}
@@ -0,0 +1,24 @@
+#include <transform_backend.hpp>
+#include <fftw_backend.hpp>
+#include <native_backend.hpp>
+
+template<class T>
+TransformBackend<T>* TransformBackend<T>::create(const std::string &name, const TransformKind kind,
+    const int n, const int nRows, T *spatial, std::complex<T> *spectral,
+    const int rowStride, const int nThreads) {
+  if(name == "native") {
+    return new NativeBackend<T>(kind, n, nRows, spatial, spectral, rowStride, nThreads);
+  }
+  return new FftwBackend<T>(kind, n, nRows, spatial, spectral, rowStride, nThreads);
+}
+
+template<class T>
+bool TransformBackend<T>::isValidName(const std::string &name) {
+  return name == "fftw"
+    or name == "native";
+}
+
+template class TransformBackend<double>;
+#if defined PRECISION_SINGLE or defined PRECISION_MIXED
+template class TransformBackend<float>;
+#endif
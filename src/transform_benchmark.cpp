@@ -0,0 +1,72 @@
+#include <transform_benchmark.hpp>
+#include <variable.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+TransformBenchmark::TransformBenchmark(const Constants &c_in):
+  c(c_in)
+{}
+
+void TransformBenchmark::time(const std::string &backend, const bool useSinTransform,
+    const int nRepeats, real &forwardTime, real &backwardTime) const {
+  Constants cBackend = c;
+  cBackend.transformBackend = backend;
+  Variable var(cBackend, 1, useSinTransform);
+
+  for(int k=0; k<c.nZ; ++k) {
+    for(int n=0; n<c.nN; ++n) {
+      var(n,k) = 1.0/(n+1.0);
+    }
+  }
+  var.toPhysical();
+  var.toSpectral();
+
+  auto start = std::chrono::steady_clock::now();
+  for(int i=0; i<nRepeats; ++i) {
+    var.toSpectral();
+  }
+  auto end = std::chrono::steady_clock::now();
+  forwardTime = std::chrono::duration<real, std::micro>(end - start).count()/nRepeats;
+
+  start = std::chrono::steady_clock::now();
+  for(int i=0; i<nRepeats; ++i) {
+    var.toPhysical();
+  }
+  end = std::chrono::steady_clock::now();
+  backwardTime = std::chrono::duration<real, std::micro>(end - start).count()/nRepeats;
+}
+
+void TransformBenchmark::run(const int nRepeats) const {
+  cout << "Transform times per call for " << c.nZ << " rows of " << c.nX << " points (us)" << endl;
+  cout << "backend\ttransform\tforward\tbackward" << endl;
+
+  std::string fastest;
+  real fastestTime = INFINITY;
+  for(const std::string backend : {"fftw", "native"}) {
+    real total = 0.0;
+    for(const bool useSinTransform : {true, false}) {
+      if(c.horizontalBoundaryConditions == BoundaryConditions::periodic and not useSinTransform) {
+        // Both use the same Fourier transform
+        continue;
+      }
+      real forwardTime, backwardTime;
+      time(backend, useSinTransform, nRepeats, forwardTime, backwardTime);
+      std::string transform = "fourier";
+      if(c.horizontalBoundaryConditions == BoundaryConditions::impermeable) {
+        transform = useSinTransform ? "sine" : "cosine";
+      }
+      cout << backend << "\t" << transform << "\t\t" << forwardTime << "\t" << backwardTime << endl;
+      total += forwardTime + backwardTime;
+    }
+    if(total < fastestTime) {
+      fastestTime = total;
+      fastest = backend;
+    }
+  }
+  cout << "Fastest: \"transformBackend\": \"" << fastest << "\"" << endl;
+}
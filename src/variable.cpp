@@ -17,19 +17,19 @@ const mode* Variable::getCurrent() const {
 }
 
 mode* Variable::getPrevious() {
-  return data + previous*varSize();
+  return data + previous*stepSize();
 }
 
 const mode* Variable::getPrevious() const {
-  return data + previous*varSize();
+  return data + previous*stepSize();
 }
 
 mode* Variable::getPlus(int nSteps) {
-  return data + ((current+nSteps)%totalSteps)*varSize();
+  return data + ((current+nSteps)%totalSteps)*stepSize();
 }
 
 const mode* Variable::getPlus(int nSteps) const {
-  return data + ((current+nSteps)%totalSteps)*varSize();
+  return data + ((current+nSteps)%totalSteps)*stepSize();
 }
 
 void Variable::advanceTimestep(int nSteps) {
@@ -60,10 +60,53 @@ void Variable::readFromFile(std::ifstream& file) {
   bottomBoundary = (*this)(0,0);
 }
 
+void Variable::writeToBuffer(mode *buffer) const {
+  // Copies the full spectral state, including ghost points, into
+  // totalSize() contiguous modes. Steps are relative to current, as in
+  // writeToFile, so a state can be read back after an odd number of steps.
+  int i = 0;
+  for(int step=0; step<totalSteps; ++step) {
+    const mode *stepData = getPlus(step);
+    for(int k=-nG; k<nZ+nG; ++k) {
+      for(int n=-nG; n<nX+nG; ++n) {
+        buffer[i++] = stepData[calcIndex(n, k)];
+      }
+    }
+  }
+}
+
+void Variable::readFromBuffer(const mode *buffer) {
+  int i = 0;
+  for(int step=0; step<totalSteps; ++step) {
+    mode *stepData = getPlus(step);
+    for(int k=-nG; k<nZ+nG; ++k) {
+      for(int n=-nG; n<nX+nG; ++n) {
+        stepData[calcIndex(n, k)] = buffer[i++];
+      }
+    }
+  }
+  topBoundary = (*this)(0,nZ-1);
+  bottomBoundary = (*this)(0,0);
+}
+
+void Variable::reparameterise(const Constants &c_in) {
+  // Keeps data and FFTW plans, so the grid shape must not change
+  assert(c_in.nN == nN and c_in.nZ == nZ and c_in.nX == nX and c_in.nG == nG);
+  c = c_in;
+  dz = c.dz;
+  oodz2 = c.oodz2;
+  oodz = c.oodz;
+  oodx = c.oodx;
+}
+
 void Variable::fill(mode value) {
-  for(int i=0; i<this->totalSize(); ++i) {
-    data[i] = value;
-    spatialData[i] = value.real();
+  for(int step=0; step<totalSteps; ++step) {
+    for(int k=-nG; k<nZ+nG; ++k) {
+      for(int i=-nG; i<nX+nG; ++i) {
+        data[calcIndex(step, i, k)] = value;
+        spatialData[calcIndex(step, i, k)] = value.real();
+      }
+    }
   }
 }
 
@@ -75,122 +118,245 @@ void Variable::update(const Variable& dVardt, const real dt, const real f) {
   }
 }
 
+void Variable::computeCompactDerivatives() {
+  #pragma omp parallel for schedule(static)
+  for(int n=0; n<nN; ++n) {
+    const mode *column = getCurrent() + calcIndex(n,0);
+    compactScheme->dfdz(column, dfdzData + calcIndex(n,0), rowStride);
+    compactScheme->dfdz2(column, dfdz2Data + calcIndex(n,0), rowStride);
+  }
+}
+
+void Variable::computeCompactSpatialDerivative() {
+  // Ghost columns are included, as the Jacobian reads them
+  #pragma omp parallel for schedule(static)
+  for(int ix=-nG; ix<nX+nG; ++ix) {
+    compactScheme->dfdz(&spatial(ix,0), dfdzSpatialData + calcIndex(ix,0), rowStride);
+  }
+}
+
 void Variable::initialiseData(mode initialValue) {
   data = new mode[this->totalSize()];
-  spatialData = new real[this->totalSize()];
+  spatialData = new transform_real[this->totalSize()];
   fill(initialValue);
+  initialiseStagingData();
 }
 
-void Variable::toSpectral() {
-  fftw_execute(fftwForwardPlan);
+void Variable::initialiseStagingData() {
+  if(isTransformStaged) {
+    if(stagingData != nullptr) {
+      delete [] stagingData;
+    }
+    stagingData = new transform_mode[stepSize()];
+    for(int i=0; i<stepSize(); ++i) {
+      stagingData[i] = 0.0;
+    }
+  }
+}
 
-  if(c.horizontalBoundaryConditions == BoundaryConditions::impermeable) {
-    #pragma omp parallel for schedule(dynamic)
-    for(int k=0; k<nZ; ++k) {
-      (*this)(0,k) = ((*this)(0,k))/(2.0*(nX-1.0));
-      for(int n=1; n<nX; ++n) {
-        (*this)(n,k) = ((*this)(n,k))/(nX-1.0);
+void Variable::useStorage(mode *data_in, transform_real *spatialData_in, const int rowStride_in) {
+  // Compact derivatives are stored with the old row stride
+  assert(compactScheme == nullptr and rowStride_in >= rowSize());
+  std::vector<mode> state(totalSize());
+  writeToBuffer(state.data());
+
+  if(isStorageOwned) {
+    delete [] data;
+    delete [] spatialData;
+  }
+  data = data_in;
+  spatialData = spatialData_in;
+  rowStride = rowStride_in;
+  isStorageOwned = false;
+
+  readFromBuffer(state.data());
+  for(int step=0; step<totalSteps; ++step) {
+    for(int k=-nG; k<nZ+nG; ++k) {
+      for(int i=-nG; i<nX+nG; ++i) {
+        spatialData[calcIndex(step, i, k)] = 0.0;
       }
     }
+  }
+  initialiseStagingData();
+
+  // The transforms were planned on the old arrays
+  delete transform;
+  setupTransforms();
+  if(not slabTransforms.empty()) {
+    setupSlabTransforms(std::vector<int>(slabStarts));
+  }
+}
+
+transform_mode* Variable::transformSpectralData() {
+  if(isTransformStaged) {
+    return stagingData;
+  }
+  return reinterpret_cast<transform_mode*>(getCurrent());
+}
+
+void Variable::copyFromStagingRow(const int k) {
+  const int nModes = isPruned ? nN : nX;
+  for(int n=0; n<nModes; ++n) {
+    (*this)(n,k) = mode(stagingData[calcIndex(n,k)]);
+  }
+}
+
+void Variable::copyToStagingRow(const int k) {
+  // Modes above nN are zero when pruned, whatever toSpectral left there
+  const int nModes = isPruned ? nN : nX;
+  for(int n=0; n<nModes; ++n) {
+    stagingData[calcIndex(n,k)] = transform_mode((*this)(n,k));
+  }
+  for(int n=nModes; n<nX; ++n) {
+    stagingData[calcIndex(n,k)] = 0.0;
+  }
+}
+
+void Variable::normaliseSpectralRow(const int k) {
+  const int nModes = isPruned ? nN : nX;
+  if(c.horizontalBoundaryConditions == BoundaryConditions::impermeable) {
+    (*this)(0,k) = ((*this)(0,k))/(2.0*(nX-1.0));
+    for(int n=1; n<nModes; ++n) {
+      (*this)(n,k) = ((*this)(n,k))/(nX-1.0);
+    }
   } else if(c.horizontalBoundaryConditions == BoundaryConditions::periodic) {
-    #pragma omp parallel for schedule(dynamic)
-    for(int k=0; k<nZ; ++k) {
-      for(int n=0; n<nX; ++n) {
-        (*this)(n,k) *= 1.0/nX;
-      }
+    for(int n=0; n<nModes; ++n) {
+      (*this)(n,k) *= 1.0/nX;
     }
   }
 }
 
-void Variable::toPhysical() {
-  fftw_execute(fftwBackwardPlan);
-
+void Variable::normalisePhysicalRow(const int k) {
   if(c.horizontalBoundaryConditions == BoundaryConditions::impermeable) {
     if(useSinTransform) {
-      #pragma omp parallel for schedule(dynamic)
-      for(int k=0; k<nZ; ++k) {
-        for(int i=0; i<nX; ++i) {
-          spatial(i,k) = (spatial(i,k))/2.0;
-        }
+      for(int i=0; i<nX; ++i) {
+        spatial(i,k) = (spatial(i,k))/2.0;
       }
     } else {
-      #pragma omp parallel for schedule(dynamic)
-      for(int k=0; k<nZ; ++k) {
-        for(int i=0; i<nX; ++i) {
-          spatial(i,k) = (spatial(i,k) + (*this)(0,k).real() + pow(-1, i)*(*this)(nX-1,k).real())/2.0;
-        }
+      // The last mode is above nN, so it is zero when pruned
+      const real first = (*this)(0,k).real();
+      const real last = isPruned ? 0.0 : (*this)(nX-1,k).real();
+      for(int i=0; i<nX; ++i) {
+        real sign = (i%2 == 0) ? 1.0 : -1.0;
+        spatial(i,k) = (spatial(i,k) + first + sign*last)/2.0;
       }
     }
   }
 }
 
-void Variable::setupFFTW() {
-  if(c.horizontalBoundaryConditions == BoundaryConditions::impermeable) {
-    int n[1];
-    fftw_r2r_kind kind[1];
-    real *spatial;
-    mode *spectral;
+void Variable::toSpectral() {
+  transform->forward();
 
-    if(useSinTransform) {
-      kind[0] = FFTW_RODFT00;
-      n[0] = nX-2;
-      spatial = spatialData + calcIndex(0,0) + 1;
-      spectral = getCurrent() + calcIndex(0,0) + 1;
-    } else {
-      kind[0] = FFTW_REDFT00;
-      n[0] = nX;
-      spatial = spatialData + calcIndex(0,0);
-      spectral = getCurrent() + calcIndex(0,0);
+  if(isTransformStaged) {
+    #pragma omp parallel for schedule(static)
+    for(int k=0; k<nZ; ++k) {
+      copyFromStagingRow(k);
     }
+  }
 
-    #pragma omp critical
-    {
-#ifdef _OPENMP
-    fftw_plan_with_nthreads(omp_get_max_threads());
-#endif
+  if(isNormalisationDeferred) {
+    return;
+  }
 
-    fftwForwardPlan = fftw_plan_many_r2r(1, n, nZ,
-        spatial, NULL, 1, rowSize(),
-        (real*)spectral, NULL, 2, 2*rowSize(),
-        kind, FFTW_MEASURE);
+  #pragma omp parallel for schedule(dynamic)
+  for(int k=0; k<nZ; ++k) {
+    normaliseSpectralRow(k);
+  }
+}
 
-#ifdef _OPENMP
-    fftw_plan_with_nthreads(omp_get_max_threads());
-#endif
+void Variable::toPhysical() {
+  if(isTransformStaged) {
+    #pragma omp parallel for schedule(static)
+    for(int k=0; k<nZ; ++k) {
+      copyToStagingRow(k);
+    }
+  }
 
-    fftwBackwardPlan = fftw_plan_many_r2r(1, n, nZ,
-        (real*)spectral, NULL, 2, 2*rowSize(),
-        spatial, NULL, 1, rowSize(),
-        kind, FFTW_MEASURE);
+  transform->backward();
+
+  if(c.horizontalBoundaryConditions == BoundaryConditions::impermeable) {
+    #pragma omp parallel for schedule(dynamic)
+    for(int k=0; k<nZ; ++k) {
+      normalisePhysicalRow(k);
     }
-  } else if(c.horizontalBoundaryConditions == BoundaryConditions::periodic) {
-    int n[] = {nX};
-    real *spatial = spatialData + calcIndex(0,0);
-    mode *spectral = getCurrent() + calcIndex(0,0);
+  }
+}
 
-    #pragma omp critical
-    {
-#ifdef _OPENMP
-    fftw_plan_with_nthreads(omp_get_max_threads());
-#endif
+void Variable::toSpectral(const int slab) {
+  // Single threaded, so it can be called by the thread owning the slab
+  slabTransforms[slab]->forward();
+
+  if(isTransformStaged) {
+    for(int k=slabStarts[slab]; k<slabStarts[slab+1]; ++k) {
+      copyFromStagingRow(k);
+    }
+  }
+
+  if(isNormalisationDeferred) {
+    return;
+  }
 
-    fftwForwardPlan = fftw_plan_many_dft_r2c(1, n, nZ,
-        spatial, NULL, 1, rowSize(),
-        (fftw_complex*)spectral, NULL, 1, rowSize(),
-        FFTW_MEASURE);
+  for(int k=slabStarts[slab]; k<slabStarts[slab+1]; ++k) {
+    normaliseSpectralRow(k);
+  }
+}
 
+void Variable::toPhysical(const int slab) {
+  if(isTransformStaged) {
+    for(int k=slabStarts[slab]; k<slabStarts[slab+1]; ++k) {
+      copyToStagingRow(k);
+    }
+  }
+
+  slabTransforms[slab]->backward();
+
+  for(int k=slabStarts[slab]; k<slabStarts[slab+1]; ++k) {
+    normalisePhysicalRow(k);
+  }
+}
+
+TransformBackend<transform_real>* Variable::createTransform(const int kFirst, const int nRows,
+    const int nThreads) {
+  transform_mode *spectral = transformSpectralData() + calcIndex(0,kFirst);
+  if(c.horizontalBoundaryConditions == BoundaryConditions::periodic) {
+    return TransformBackend<transform_real>::create(c.transformBackend, TransformKind::fourier,
+        nX, nRows, spatialData + calcIndex(0,kFirst), spectral, rowStride, nThreads);
+  } else if(useSinTransform) {
+    return TransformBackend<transform_real>::create(c.transformBackend, TransformKind::sine,
+        nX-2, nRows, spatialData + calcIndex(0,kFirst) + 1, spectral + 1, rowStride, nThreads);
+  }
+  return TransformBackend<transform_real>::create(c.transformBackend, TransformKind::cosine,
+      nX, nRows, spatialData + calcIndex(0,kFirst), spectral, rowStride, nThreads);
+}
+
+void Variable::setupTransforms() {
 #ifdef _OPENMP
-    fftw_plan_with_nthreads(omp_get_max_threads());
+  const int nThreads = omp_get_max_threads();
+#else
+  const int nThreads = 1;
 #endif
+  transform = createTransform(0, nZ, nThreads);
+}
 
-    fftwBackwardPlan = fftw_plan_many_dft_c2r(1, n, nZ,
-        (fftw_complex*)spectral, NULL, 1, rowSize(),
-        spatial, NULL, 1, rowSize(),
-        FFTW_MEASURE | FFTW_PRESERVE_INPUT);
-    }
+void Variable::setupSlabTransforms(const std::vector<int> &slabStarts_in) {
+  // One single threaded transform per slab of rows
+  // [slabStarts[s], slabStarts[s+1])
+  destroySlabTransforms();
+  slabStarts = slabStarts_in;
+  const int nSlabs = slabStarts.size() - 1;
+  for(int s=0; s<nSlabs; ++s) {
+    slabTransforms.push_back(
+        createTransform(slabStarts[s], slabStarts[s+1] - slabStarts[s], 1));
   }
 }
 
+void Variable::destroySlabTransforms() {
+  for(TransformBackend<transform_real> *slabTransform : slabTransforms) {
+    delete slabTransform;
+  }
+  slabTransforms.clear();
+}
+
 Variable::Variable(const Constants &c_in, const int totalSteps_in, const bool useSinTransform_in):
   data(nullptr),
   spatialData(nullptr),
@@ -206,19 +372,60 @@ Variable::Variable(const Constants &c_in, const int totalSteps_in, const bool us
   totalSteps(totalSteps_in),
   current(0),
   previous(1),
+  rowStride(c_in.nX + 2*c_in.nG),
+  isStorageOwned(true),
   nG(c_in.nG),
   useSinTransform(useSinTransform_in),
-  c(c_in)
+  isPruned(false),
+  isNormalisationDeferred(false),
+  c(c_in),
+  compactScheme(nullptr),
+  dfdzData(nullptr),
+  dfdz2Data(nullptr),
+  dfdzSpatialData(nullptr),
+  stretchedGrid(nullptr),
+  transform(nullptr),
+  stagingData(nullptr)
 {
   initialiseData();
-  setupFFTW();
+  setupTransforms();
+
+  if(c.isCompact) {
+    compactScheme = new CompactScheme(nZ, dz,
+        verticalBoundaryConditions == BoundaryConditions::periodic);
+    dfdzData = new mode[varSize()];
+    dfdz2Data = new mode[varSize()];
+    dfdzSpatialData = new transform_real[varSize()];
+    for(int i=0; i<varSize(); ++i) {
+      dfdzData[i] = dfdz2Data[i] = 0.0;
+      dfdzSpatialData[i] = 0.0;
+    }
+  }
+
+  if(c.verticalStretching != "uniform") {
+    stretchedGrid = new StretchedGrid(c.verticalStretching, c.stretchingFactor, nZ);
+  }
 }
 
 Variable::~Variable() {
-  if(data != nullptr) {
+  destroySlabTransforms();
+  delete transform;
+  if(data != nullptr and isStorageOwned) {
     delete [] data;
   }
-  if(spatialData != nullptr) {
+  if(spatialData != nullptr and isStorageOwned) {
     delete [] spatialData;
   }
+  if(stagingData != nullptr) {
+    delete [] stagingData;
+  }
+  if(compactScheme != nullptr) {
+    delete compactScheme;
+    delete [] dfdzData;
+    delete [] dfdz2Data;
+    delete [] dfdzSpatialData;
+  }
+  if(stretchedGrid != nullptr) {
+    delete stretchedGrid;
+  }
 }
@@ -88,6 +88,34 @@ cat << EOF > test_constants_periodic.json
 }
 EOF
 
+cat << EOF > test_constants_periodic_ddc.json
+{
+  "Pr":1,
+  "Ra":1.1e4,
+  "RaXi":1e6,
+  "tau":1e-2,
+  "aspectRatio":1.41421356237,
+  "initialDt":3e-6,
+
+  "nN":${n_modes},
+  "nZ":${n_gridpoints},
+
+  "icFile":"initial_conditions_ddc.dat",
+  "saveFolder":"./",
+
+  "timeBetweenSaves":0.01,
+  "totalTime":0.05,
+
+  "isNonlinear":true,
+  "isDoubleDiffusion":true,
+
+  "horizontalBoundaryConditions":"periodic",
+  "verticalBoundaryConditions":"periodic",
+  "temperatureGradient":1,
+  "salinityGradient":1
+}
+EOF
+
 cat << EOF > test_constants_ddc_gpu.json
 {
   "Pr":1,
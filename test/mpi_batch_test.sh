@@ -0,0 +1,56 @@
+#!/usr/bin/env bash
+
+set -e
+
+save_folder="test/benchmark"
+n_ranks=3
+
+mkdir -p $save_folder
+rm -rf $save_folder/*
+
+python3 tools/make_initial_conditions.py --output $save_folder/ICn1nZ101nN51 --n_modes 51 --n_gridpoints 101 --linear_stability
+
+for Ra in 600 650 700 750; do
+  mkdir -p $save_folder/Ra$Ra
+  cat << EOF > $save_folder/Ra$Ra.json
+{
+  "Pr":0.5,
+  "Ra":$Ra,
+  "aspectRatio":3,
+
+  "nN":51,
+  "nZ":101,
+
+  "icFile":"$save_folder/ICn1nZ101nN51",
+  "saveFolder":"$save_folder/Ra$Ra/",
+
+  "initialDt":1e-5,
+  "timeBetweenSaves":0.01,
+  "totalTime":10,
+
+  "isNonlinear":false,
+  "isDoubleDiffusion":false,
+  "isEigenvalueSolverEnabled":true
+}
+EOF
+done
+
+echo "==================== Building program"
+make clean
+make -j4 mpi
+
+echo "==================== Starting program"
+{ /usr/bin/time mpirun -np $n_ranks --oversubscribe build/exe --batch $save_folder --summary $save_folder/summary.dat ; } 2>&1 | tee $save_folder/log
+
+# Leave the build directory for the non-MPI tests
+make clean
+
+# Every run should appear exactly once in the summary and have succeeded
+n_successful=$(grep -v "^#" $save_folder/summary.dat | awk '$3 == 1' | wc -l)
+if [ "$n_successful" -eq 4 ]; then
+  echo "All runs completed"
+  exit 0
+else
+  echo "Only $n_successful of 4 runs completed"
+  exit -1
+fi
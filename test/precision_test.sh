@@ -0,0 +1,69 @@
+#!/usr/bin/env bash
+
+# Runs nonlinear_test.sh's case in single and mixed precision and compares
+# them against double precision. The case is still growing from the initial
+# perturbation, so rounding differences grow with it and the comparison is
+# made after a short time.
+
+save_folder="test/precision"
+nN=51
+nZ=101
+
+mkdir -p $save_folder
+rm -rf $save_folder/*
+
+python3 tools/make_initial_conditions.py --output $save_folder/initial_conditions.dat --n_modes $nN --n_gridpoints $nZ --modes 1
+# Single precision builds read and write single precision files
+python3 -c "import numpy as np; np.fromfile('$save_folder/initial_conditions.dat', dtype=np.cdouble).astype(np.csingle).tofile('$save_folder/initial_conditions_single.dat')"
+
+status=0
+for precision in DOUBLE MIXED SINGLE; do
+  folder=$save_folder/$precision
+  mkdir -p $folder
+
+  ic_file=$save_folder/initial_conditions.dat
+  if [ $precision == SINGLE ]; then
+    ic_file=$save_folder/initial_conditions_single.dat
+  fi
+
+  cat << EOF > $folder/constants.json
+{
+  "Pr":0.5,
+  "Ra":1e6,
+  "aspectRatio":3,
+  "icFile":"$ic_file",
+  "initialDt":3e-6,
+  "nN":$nN,
+  "nZ":$nZ,
+  "saveFolder":"$folder/",
+  "timeBetweenSaves":0.01,
+  "isNonlinear":true,
+  "isDoubleDiffusion":false,
+  "totalTime":0.01
+}
+EOF
+
+  echo "==================== Building program in $precision precision"
+  make -j4 release PRECISION=$precision BUILD_DIR=build_$precision
+
+  echo "==================== Starting program"
+  { /usr/bin/time build_$precision/exe --constants $folder/constants.json ; } 2>&1 | tee $folder/log
+done
+
+echo "==================== Comparing results"
+
+echo "Mixed precision"
+python3 tools/compare_precision.py $save_folder/DOUBLE/dump0001.dat $save_folder/MIXED/dump0001.dat \
+  --constants $save_folder/MIXED/constants.json --tolerance 1e-5 || status=-1
+
+echo "Single precision"
+python3 tools/compare_precision.py $save_folder/DOUBLE/dump0001.dat $save_folder/SINGLE/dump0001.dat \
+  --constants $save_folder/SINGLE/constants.json --tolerance 1e-3 --single || status=-1
+
+if [ $status != 0 ]; then
+  echo "Simulation returned different results!"
+  exit -1
+else
+  echo "Results match!"
+  exit 0
+fi
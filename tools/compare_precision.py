@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+"""Compares temperature, vorticity and stream function in a dump against a
+double precision reference, relative to the largest reference mode"""
+
+import argparse
+import json
+import sys
+import numpy as np
+
+variable_names = ["temperature", "vorticity", "streamfunction"]
+
+def main():
+    """main function"""
+    parser = argparse.ArgumentParser(description='Compare a dump against a double precision reference')
+    parser.add_argument('reference', help='double precision dump')
+    parser.add_argument('filename', help='dump to compare')
+    parser.add_argument('--constants', help='constants file', required=True)
+    parser.add_argument('--tolerance', type=float, help='largest relative error allowed',
+                        required=True)
+    parser.add_argument('--single', action='store_true',
+                        help='the dump was written by a single precision build')
+    args = parser.parse_args()
+
+    constants_file = open(args.constants, "r")
+    constants = json.load(constants_file)
+
+    n_modes = constants["nN"]
+    n_gridpoints = constants["nZ"]
+    size = n_modes*n_gridpoints
+
+    reference = np.fromfile(args.reference, dtype=np.dtype(np.cdouble))
+    dtype = np.csingle if args.single else np.cdouble
+    data = np.fromfile(args.filename, dtype=np.dtype(dtype)).astype(np.cdouble)
+
+    is_within_tolerance = True
+    for varidx, name in enumerate(variable_names):
+        expected = reference[varidx*size:(varidx+1)*size]
+        actual = data[varidx*size:(varidx+1)*size]
+        error = np.abs(actual - expected).max()/np.abs(expected).max()
+        print(name, "%.3E" % error)
+        if error > args.tolerance:
+            is_within_tolerance = False
+
+    sys.exit(0 if is_within_tolerance else 1)
+
+if __name__ == "__main__":
+    main()
@@ -30,6 +30,15 @@ def set_temperature_background(data, background):
 def set_xi_background(data, background):
     set_xi(data, 0, background)
 
+def heights(n_gridpoints, stretching, factor):
+    """Vertical grid, as in StretchedGrid"""
+    u = factor*(2.0*np.linspace(0, 1, n_gridpoints) - 1.0)
+    if stretching == 'boundaries':
+        return 0.5*(1.0 + np.tanh(u)/np.tanh(factor))
+    elif stretching == 'interface':
+        return 0.5*(1.0 + np.sinh(u)/np.sinh(factor))
+    return np.linspace(0, 1, n_gridpoints)
+
 def main():
     """main function"""
     parser = argparse.ArgumentParser(description='Create initial conditions file')
@@ -59,6 +68,11 @@ def main():
                         help='amplitude of initial disturbance')
     parser.add_argument('--perturb_vorticity', action='store_true',
                         help='Adds perturbation to 0th mode of vorticity')
+    parser.add_argument('--stretching', default='uniform',
+                        choices=['uniform', 'boundaries', 'interface'],
+                        help='vertical grid clustering, matching verticalStretching')
+    parser.add_argument('--stretching_factor', type=float, default=0.0,
+                        help='strength of the vertical grid clustering')
 
     args = parser.parse_args()
 
@@ -99,6 +113,7 @@ def main():
     data = np.zeros((n_vars, n_modes, n_gridpoints), dtype=np.cdouble)
 
     background = np.zeros(n_gridpoints)
+    z = heights(n_gridpoints, args.stretching, args.stretching_factor)
 
     # Set up n=0 background
     if args.step_profile:
@@ -107,7 +122,7 @@ def main():
         background[int(n_gridpoints/2):] = 1 # Set upper half to 1
     elif not args.periodic:
         # Linear gradient
-        background = np.linspace(0, 1, n_gridpoints)
+        background = z
 
     set_temperature_background(data, background[::temp_grad])
     if ddc:
@@ -117,8 +132,11 @@ def main():
     if args.step_profile:
         perturbation = np.zeros(n_gridpoints)
         perturbation[int(n_gridpoints/2)] = amp
+    elif args.linear_stability:
+        # Must project onto the fundamental vertical mode, which cos(pi z) does not
+        perturbation = amp*np.sin(np.pi*z)
     else:
-        perturbation = amp*np.cos(np.pi*np.linspace(0, 1, n_gridpoints))
+        perturbation = amp*np.cos(np.pi*z)
 
     if args.perturb_vorticity:
         set_vorticity(data, 0, perturbation)
@@ -6,9 +6,19 @@
 #include <variable.hpp>
 #include <boundary_conditions.hpp>
 #include <sim.hpp>
+#include <linear_stability_solver.hpp>
+#include <linear_mode_sim.hpp>
+#include <ensemble_sim.hpp>
+#include <state_cache.hpp>
+#include <spectral_sim.hpp>
+#include <chebyshev_basis.hpp>
+#include <chebyshev_tau_solver.hpp>
+#include <field_expression.hpp>
+#include <numerical_methods.hpp>
 
 #include <iostream>
 #include <cmath>
+#include <omp.h>
 
 using std::cout;
 using std::endl;
@@ -255,6 +265,131 @@ TEST_CASE("Test discrete Fourier transform", "[]") {
   }
 }
 
+TEST_CASE("Test pruned and deferred transforms match full transforms", "[]") {
+  for(const std::string constantsFile : {"test_constants.json", "test_constants_periodic.json"}) {
+    Constants c(constantsFile);
+    for(const bool useSinTransform : {true, false}) {
+      Variable full(c, 1, useSinTransform);
+      Variable pruned(c, 1, useSinTransform);
+      pruned.isPruned = true;
+
+      // Sine transforms have no mode 0
+      for(int k=0; k<c.nZ; ++k) {
+        for(int n=useSinTransform; n<c.nN; ++n) {
+          full(n,k) = pruned(n,k) = 1.0/(n+k+1.0);
+        }
+      }
+
+      full.toPhysical();
+      pruned.toPhysical();
+      for(int k=0; k<c.nZ; ++k) {
+        for(int ix=0; ix<c.nX; ++ix) {
+          require_equal(pruned.spatial(ix,k), full.spatial(ix,k));
+        }
+      }
+
+      Variable deferred(c, 1, useSinTransform);
+      deferred.isNormalisationDeferred = true;
+      for(int k=0; k<c.nZ; ++k) {
+        for(int ix=0; ix<c.nX; ++ix) {
+          deferred.spatial(ix,k) = full.spatial(ix,k);
+        }
+      }
+
+      full.toSpectral();
+      pruned.toSpectral();
+      deferred.toSpectral();
+      for(int k=0; k<c.nZ; ++k) {
+        for(int n=0; n<c.nN; ++n) {
+          require_equal(pruned(n,k), full(n,k));
+          require_equal(deferred.spectralNormalisation(n)*deferred(n,k), full(n,k));
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("Test native transform backend matches FFTW", "[]") {
+  // Odd and even lengths, which the native backend does differently
+  for(const std::string constantsFile : {"test_constants.json", "test_constants_periodic.json"}) {
+    for(const int nX : {150, 151}) {
+      Constants c(constantsFile);
+      c.nX = nX;
+      c.isPhysicalResSpecfified = true;
+      c.calculateDerivedConstants();
+      Constants cNative = c;
+      cNative.transformBackend = "native";
+
+      for(const bool useSinTransform : {true, false}) {
+        Variable fftw(c, 1, useSinTransform);
+        Variable native(cNative, 1, useSinTransform);
+
+        for(int k=0; k<c.nZ; ++k) {
+          for(int ix=0; ix<c.nX; ++ix) {
+            fftw.spatial(ix,k) = native.spatial(ix,k) = sin(0.1*ix*ix + k) + 0.01*ix;
+          }
+        }
+        fftw.toSpectral();
+        native.toSpectral();
+        for(int k=0; k<c.nZ; ++k) {
+          for(int n=0; n<c.nN; ++n) {
+            require_within_error(native(n,k), fftw(n,k), 1e-12);
+          }
+        }
+
+        fftw.toPhysical();
+        native.toPhysical();
+        for(int k=0; k<c.nZ; ++k) {
+          for(int ix=0; ix<c.nX; ++ix) {
+            require_within_error(native.spatial(ix,k), fftw.spatial(ix,k), 1e-11);
+          }
+        }
+      }
+    }
+  }
+}
+
+#if defined PRECISION_SINGLE or defined PRECISION_MIXED
+TEST_CASE("Test single precision transforms match double", "[]") {
+  const int nRows = 20;
+  const int n = 150;
+  const int stride = n + 2;
+  for(const std::string backend : {"fftw", "native"}) {
+    for(const TransformKind kind : {TransformKind::sine, TransformKind::cosine, TransformKind::fourier}) {
+      std::vector<double> xDouble(nRows*stride);
+      std::vector<float> xFloat(nRows*stride);
+      std::vector<std::complex<double>> yDouble(nRows*stride);
+      std::vector<std::complex<float>> yFloat(nRows*stride);
+      // Created first, as planning may overwrite the arrays
+      TransformBackend<double> *transformDouble = TransformBackend<double>::create(
+          backend, kind, n, nRows, xDouble.data(), yDouble.data(), stride, 1);
+      TransformBackend<float> *transformFloat = TransformBackend<float>::create(
+          backend, kind, n, nRows, xFloat.data(), yFloat.data(), stride, 1);
+
+      for(int i=0; i<nRows*stride; ++i) {
+        xDouble[i] = xFloat[i] = sin(0.1*i*i) + 0.01*(i%stride);
+      }
+      transformDouble->forward();
+      transformFloat->forward();
+      for(int i=0; i<nRows*stride; ++i) {
+        // Relative to the largest modes, which are O(n)
+        require_within_error(yFloat[i].real()/n, yDouble[i].real()/n, 1e-5);
+        require_within_error(yFloat[i].imag()/n, yDouble[i].imag()/n, 1e-5);
+      }
+
+      transformDouble->backward();
+      transformFloat->backward();
+      for(int i=0; i<nRows*stride; ++i) {
+        require_within_error(xFloat[i]/(n*n), xDouble[i]/(n*n), 1e-5);
+      }
+
+      delete transformDouble;
+      delete transformFloat;
+    }
+  }
+}
+#endif
+
 TEST_CASE("Test complex poisson solver", "[]") {
   Constants c("test_constants_periodic.json");
 
@@ -286,6 +421,43 @@ TEST_CASE("Test complex poisson solver", "[]") {
   }
 }
 
+TEST_CASE("Test partitioned tridiagonal solver matches Thomas algorithm", "[]") {
+  // Fewer modes than threads selects the partitioned solver
+  const int nThreads = omp_get_max_threads();
+  omp_set_num_threads(4);
+
+  for(std::string constantsFile : {"test_constants.json", "test_constants_periodic_ddc.json"}) {
+    Constants c(constantsFile);
+    c.nN = 3;
+    c.calculateDerivedConstants();
+
+    ThomasAlgorithm thomasAlgorithm(c);
+    Variable rhs(c);
+    Variable partitionedSol(c);
+    Variable thomasSol(c);
+
+    for(int n=0; n<c.nN; ++n) {
+      for(int k=0; k<c.nZ; ++k) {
+        real z = c.dz*k;
+        rhs(n,k) = cos(3.0*z + n) + 1.0i*z*real(n+1);
+      }
+    }
+
+    thomasAlgorithm.solveAllModes(partitionedSol, rhs);
+    for(int n=0; n<c.nN; ++n) {
+      thomasAlgorithm.solve(thomasSol, rhs, n);
+    }
+
+    for(int n=0; n<c.nN; ++n) {
+      for(int k=0; k<c.nZ; ++k) {
+        require_within_error(partitionedSol(n,k), thomasSol(n,k), 1e-10);
+      }
+    }
+  }
+
+  omp_set_num_threads(nThreads);
+}
+
 TEST_CASE("Test simple nonlinear multiplication and transform", "[]") {
   Constants c("test_constants.json");
 
@@ -378,6 +550,51 @@ TEST_CASE("Test spatial dfdx derivative", "[]") {
   }
 }
 
+TEST_CASE("Test field expressions match hand written loops", "[]") {
+  Constants c("test_constants_periodic.json");
+
+  Variable a(c), b(c), result(c);
+  for(int k=-1; k<=c.nZ; ++k) {
+    for(int n=0; n<c.nN; ++n) {
+      a(n,k) = mode(sin(0.3*n + 0.1*k), cos(0.2*n*k));
+      b(n,k) = mode(1.0/(n+k+3.0), 0.5*n - 0.25*k);
+    }
+    for(int ix=-1; ix<=c.nX; ++ix) {
+      a.spatial(ix,k) = sin(0.05*ix*k);
+      b.spatial(ix,k) = cos(0.1*ix + 0.2*k);
+    }
+  }
+
+  result = c.Pr*lap(a) - kx(c)*c.xCosDerivativeFactor*c.Ra*b;
+  for(int k=0; k<c.nZ; ++k) {
+    for(int n=0; n<c.nN; ++n) {
+      require_within_error(result(n,k),
+          c.Pr*a.laplacian(n,k) - n*c.wavelength*c.xCosDerivativeFactor*c.Ra*b(n,k), 1e-10);
+    }
+  }
+
+  // Only the given rows change
+  result = -b;
+  rows(result, 2, c.nZ-2) += 2.0*dfdz(a) - (shift(a, 0, 1) - shift(a, 0, -1))*c.oodz;
+  for(int k=0; k<c.nZ; ++k) {
+    for(int n=0; n<c.nN; ++n) {
+      mode expected = -b(n,k);
+      if(k >= 2 and k < c.nZ-2) {
+        expected += 2.0*a.dfdz(n,k) - (a(n,k+1) - a(n,k-1))*c.oodz;
+      }
+      require_within_error(result(n,k), expected, 1e-10);
+    }
+  }
+
+  result = spatial(a)*dfdx(b) - 0.5*shift(dfdzSpatial(b), 1, 0);
+  for(int k=0; k<c.nZ; ++k) {
+    for(int ix=0; ix<c.nX; ++ix) {
+      require_within_error(result.spatial(ix,k),
+          a.spatial(ix,k)*b.dfdx(ix,k) - 0.5*b.dfdzSpatial(ix+1,k), 1e-6);
+    }
+  }
+}
+
 TEST_CASE("Test spatial nonlinear derivative", "[]") {
   Constants c("test_constants_periodic.json");
 
@@ -411,6 +628,415 @@ TEST_CASE("Test spatial nonlinear derivative", "[]") {
   }
 }
 
+TEST_CASE("Test task graph derivatives match sequential derivatives", "[]") {
+  Constants c("test_constants_ddc_gpu.json");
+
+  Sim sequentialSim(c);
+  Sim taskSim(c);
+  for(Sim *sim : {&sequentialSim, &taskSim}) {
+    sim->loadInitialConditions();
+    sim->applyTemperatureBoundaryConditions();
+    sim->applyVorticityBoundaryConditions();
+    sim->applyXiBoundaryConditions();
+    sim->solveForPsi();
+    sim->applyPsiBoundaryConditions();
+  }
+
+  sequentialSim.computeLinearDerivatives();
+  sequentialSim.computeNonlinearDerivatives();
+  taskSim.computeDerivatives();
+
+  for(int n=0; n<c.nN; ++n) {
+    for(int k=0; k<c.nZ; ++k) {
+      require_equal(taskSim.vars.dTmpdt(n,k), sequentialSim.vars.dTmpdt(n,k));
+      require_equal(taskSim.vars.dOmgdt(n,k), sequentialSim.vars.dOmgdt(n,k));
+      require_equal(taskSim.vars.dXidt(n,k), sequentialSim.vars.dXidt(n,k));
+    }
+  }
+}
+
+TEST_CASE("Test slab transforms match task graph derivatives", "[]") {
+  // Force several slabs so that the edge rows wait on their neighbours
+  const int nThreads = omp_get_max_threads();
+  omp_set_num_threads(4);
+
+  for(std::string constantsFile : {"test_constants.json", "test_constants_periodic.json", "test_constants_periodic_ddc.json"}) {
+    Constants c(constantsFile);
+    Constants cSlab(c);
+    cSlab.isSlabTransformEnabled = true;
+
+    Sim taskSim(c);
+    Sim slabSim(cSlab);
+    for(Sim *sim : {&taskSim, &slabSim}) {
+      sim->loadInitialConditions();
+      sim->applyTemperatureBoundaryConditions();
+      sim->applyVorticityBoundaryConditions();
+      if(c.isDoubleDiffusion) {
+        sim->applyXiBoundaryConditions();
+      }
+      sim->solveForPsi();
+      sim->applyPsiBoundaryConditions();
+    }
+
+    taskSim.computeDerivatives();
+    slabSim.computeDerivativesInSlabs();
+
+    for(int n=0; n<c.nN; ++n) {
+      for(int k=0; k<c.nZ; ++k) {
+        require_within_error(slabSim.vars.dTmpdt(n,k), taskSim.vars.dTmpdt(n,k), 1e-8);
+        require_within_error(slabSim.vars.dOmgdt(n,k), taskSim.vars.dOmgdt(n,k), 1e-8);
+        if(c.isDoubleDiffusion) {
+          require_within_error(slabSim.vars.dXidt(n,k), taskSim.vars.dXidt(n,k), 1e-8);
+        }
+      }
+    }
+  }
+
+  omp_set_num_threads(nThreads);
+}
+
+TEST_CASE("Test split complex kernels match complex kernels", "[]") {
+  for(std::string constantsFile : {"test_constants.json", "test_constants_periodic.json", "test_constants_periodic_ddc.json"}) {
+    Constants c(constantsFile);
+    Constants cSplit(c);
+    cSplit.isSplitComplexKernels = true;
+    REQUIRE(cSplit.isValid());
+
+    Sim complexSim(c);
+    Sim splitSim(cSplit);
+    for(Sim *sim : {&complexSim, &splitSim}) {
+      sim->loadInitialConditions();
+      sim->applyTemperatureBoundaryConditions();
+      sim->applyVorticityBoundaryConditions();
+      sim->applyPsiBoundaryConditions();
+      if(c.isDoubleDiffusion) {
+        sim->applyXiBoundaryConditions();
+      }
+      for(int step=0; step<3; ++step) {
+        sim->runNonLinearStep();
+      }
+    }
+
+    // Only the order of the floating point operations may differ
+    for(int n=0; n<c.nN; ++n) {
+      for(int k=0; k<c.nZ; ++k) {
+        require_within_error(splitSim.vars.tmp(n,k), complexSim.vars.tmp(n,k), 1e-10);
+        require_within_error(splitSim.vars.omg(n,k), complexSim.vars.omg(n,k), 1e-10);
+        require_within_error(splitSim.vars.psi(n,k), complexSim.vars.psi(n,k), 1e-10);
+        if(c.isDoubleDiffusion) {
+          require_within_error(splitSim.vars.xi(n,k), complexSim.vars.xi(n,k), 1e-10);
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("Test interleaved fields match separate variables", "[]") {
+  for(std::string constantsFile : {"test_constants.json", "test_constants_periodic_ddc.json"}) {
+    Constants c(constantsFile);
+    Constants cInterleaved(c);
+    cInterleaved.isFieldInterleaved = true;
+    REQUIRE(cInterleaved.isValid());
+
+    Sim separateSim(c);
+    Sim interleavedSim(cInterleaved);
+    const Variable &tmp = interleavedSim.vars.tmp;
+    REQUIRE(&interleavedSim.vars.omg(0,0) == &tmp(0,0) + tmp.rowSize());
+    REQUIRE(&tmp(0,1) == &tmp(0,0) + tmp.getRowStride());
+
+    for(Sim *sim : {&separateSim, &interleavedSim}) {
+      sim->loadInitialConditions();
+      sim->applyTemperatureBoundaryConditions();
+      sim->applyVorticityBoundaryConditions();
+      sim->applyPsiBoundaryConditions();
+      if(c.isDoubleDiffusion) {
+        sim->applyXiBoundaryConditions();
+      }
+      for(int step=0; step<3; ++step) {
+        sim->runNonLinearStep();
+      }
+    }
+
+    // The transforms may be planned differently for the longer row stride
+    std::vector<mode> separateState, interleavedState;
+    separateSim.vars.writeState(separateState);
+    interleavedSim.vars.writeState(interleavedState);
+    REQUIRE(separateState.size() == interleavedState.size());
+    for(int i=0; i<separateState.size(); ++i) {
+      require_within_error(interleavedState[i], separateState[i], 1e-10);
+    }
+  }
+}
+
+TEST_CASE("Test fully spectral psi solve and nonlinear derivative are exact", "[]") {
+  Constants c("test_constants_periodic_ddc.json");
+  c.isFullySpectral = true;
+  SpectralSim sim(c);
+
+  const real kx1 = c.wavelength;
+  const real kz1 = 2.0*M_PI;
+  const real kx2 = 2.0*c.wavelength;
+  const real kz2 = 4.0*M_PI;
+
+  // Arrays have to be aligned like those the FFTW plans were made for
+  const int nPhysical = c.nZ*c.nX;
+  real *psi = static_cast<real*>(fftw_malloc(sizeof(real)*nPhysical));
+  real *omg = static_cast<real*>(fftw_malloc(sizeof(real)*nPhysical));
+  real *tmp = static_cast<real*>(fftw_malloc(sizeof(real)*nPhysical));
+  real *nonlinear = static_cast<real*>(fftw_malloc(sizeof(real)*nPhysical));
+  mode *expected = static_cast<mode*>(fftw_malloc(sizeof(mode)*sim.nSpectral));
+
+  for(int k=0; k<c.nZ; ++k) {
+    for(int i=0; i<c.nX; ++i) {
+      real x = i*c.dx;
+      real z = k*c.dz;
+      int index = k*c.nX + i;
+      psi[index] = sin(kx1*x)*cos(kz1*z);
+      omg[index] = (kx1*kx1 + kz1*kz1)*psi[index];
+      tmp[index] = cos(kx2*x)*sin(kz2*z);
+
+      real dpsidz = -kz1*sin(kx1*x)*sin(kz1*z);
+      real dpsidx = kx1*cos(kx1*x)*cos(kz1*z);
+      real dtmpdx = -kx2*sin(kx2*x)*sin(kz2*z);
+      real dtmpdz = kz2*cos(kx2*x)*cos(kz2*z);
+      nonlinear[index] = dpsidz*dtmpdx - dpsidx*dtmpdz;
+    }
+  }
+
+  sim.toSpectral(omg, sim.omg);
+  sim.toSpectral(tmp, sim.tmp);
+  sim.solveForPsi();
+
+  sim.toSpectral(psi, expected);
+  for(int i=0; i<sim.nSpectral; ++i) {
+    require_within_error(sim.psi[i], expected[i], 1e-12);
+  }
+
+  std::fill(sim.dTmpdt[0], sim.dTmpdt[0] + sim.nSpectral, mode(0.0));
+  sim.computeVelocities();
+  sim.computeNonlinearDerivative(sim.dTmpdt[0], sim.tmp);
+
+  sim.toSpectral(nonlinear, expected);
+  for(int i=0; i<sim.nSpectral; ++i) {
+    require_within_error(sim.dTmpdt[0][i], expected[i], 1e-10);
+  }
+
+  for(real *var : {psi, omg, tmp, nonlinear}) {
+    fftw_free(var);
+  }
+  fftw_free(expected);
+}
+
+TEST_CASE("Test Chebyshev derivative and tau solver are spectrally accurate", "[]") {
+  Constants c("test_constants.json");
+  c.nZ = 33;
+  c.isChebyshev = true;
+  c.calculateDerivedConstants();
+
+  ChebyshevBasis basis(c);
+  Variable u(c);
+  Variable rhs(c);
+  Variable result(c);
+
+  // Stiff modes like those of a Crank-Nicolson step with a small dt
+  std::vector<real> lambda(c.nN);
+  std::vector<mode> bottom(c.nN), top(c.nN);
+  for(int n=0; n<c.nN; ++n) {
+    lambda[n] = pow(n*c.wavelength, 2) + 1e3*n;
+    const mode factor = 1.0 + real(n)*1.0i;
+    bottom[n] = factor*(cos(0.0) + 0.0);
+    top[n] = factor*(cos(3.0) + 1.0);
+    for(int k=0; k<c.nZ; ++k) {
+      const real z = basis.z[k];
+      u(n,k) = factor*(cos(3.0*z) + z);
+      rhs(n,k) = factor*(-9.0*cos(3.0*z)) - lambda[n]*u(n,k);
+    }
+  }
+
+  std::vector<mode> coefficients(basis.nCoefficients), derivative(basis.nCoefficients);
+  basis.toCoefficients(u, coefficients.data());
+  basis.differentiate(coefficients.data(), derivative.data());
+  basis.toGridpoints(derivative.data(), result);
+  for(int n=0; n<c.nN; ++n) {
+    const mode factor = 1.0 + real(n)*1.0i;
+    for(int k=0; k<c.nZ; ++k) {
+      require_within_error(result(n,k), factor*(-3.0*sin(3.0*basis.z[k]) + 1.0), 1e-9);
+    }
+    require_within_error(basis.evaluate(coefficients.data(), n, 0.3), factor*(cos(0.9) + 0.3), 1e-12);
+  }
+
+  ChebyshevTauSolver solver(c.nN, c.nZ);
+  solver.factorise(lambda);
+  basis.toCoefficients(rhs, coefficients.data());
+  solver.solve(coefficients.data(), derivative.data(), bottom, top);
+  basis.toGridpoints(derivative.data(), result);
+  for(int n=0; n<c.nN; ++n) {
+    for(int k=0; k<c.nZ; ++k) {
+      require_within_error(result(n,k), u(n,k), 1e-9);
+    }
+  }
+}
+
+TEST_CASE("Test compact differences are fourth order", "[]") {
+  // Halving dz should reduce the errors by about 16
+  for(const bool isPeriodic : {false, true}) {
+    real errors[2][3];
+    for(int refinement=0; refinement<2; ++refinement) {
+      Constants c(isPeriodic ? "test_constants_periodic_ddc.json" : "test_constants.json");
+      c.nZ = isPeriodic ? 16*(refinement+1) : 16*(refinement+1) + 1;
+      c.isCompact = true;
+      c.calculateDerivedConstants();
+
+      Sim sim(c);
+      Variable u(c);
+      Variable psi(c);
+      for(int n=0; n<c.nN; ++n) {
+        const mode factor = 1.0 + real(n)*1.0i;
+        for(int k=0; k<c.nZ; ++k) {
+          const real z = c.dz*k;
+          u(n,k) = factor*(isPeriodic ? sin(2.0*M_PI*z) : cos(3.0*z) + z);
+          psi(n,k) = factor*sin((isPeriodic ? 2.0 : 1.0)*M_PI*z);
+          const real kz = isPeriodic ? 2.0*M_PI : M_PI;
+          sim.vars.omg(n,k) = (kz*kz + pow(real(n)*c.wavelength, 2))*psi(n,k);
+        }
+      }
+      u.computeCompactDerivatives();
+      sim.solveForPsi();
+
+      for(int i=0; i<3; ++i) {
+        errors[refinement][i] = 0.0;
+      }
+      for(int n=0; n<c.nN; ++n) {
+        const mode factor = 1.0 + real(n)*1.0i;
+        for(int k=0; k<c.nZ; ++k) {
+          const real z = c.dz*k;
+          const mode dudz = factor*(isPeriodic ? 2.0*M_PI*cos(2.0*M_PI*z) : -3.0*sin(3.0*z) + 1.0);
+          const mode d2udz2 = factor*(isPeriodic ? -4.0*M_PI*M_PI*sin(2.0*M_PI*z) : -9.0*cos(3.0*z));
+          errors[refinement][0] = std::max(errors[refinement][0], std::abs(u.dfdz(n,k) - dudz));
+          errors[refinement][1] = std::max(errors[refinement][1], std::abs(u.dfdz2(n,k) - d2udz2));
+          if(n > 0 or not isPeriodic) {
+            // The mean of a periodic psi is arbitrary
+            errors[refinement][2] = std::max(errors[refinement][2], std::abs(sim.vars.psi(n,k) - psi(n,k)));
+          }
+        }
+      }
+    }
+    for(int i=0; i<3; ++i) {
+      REQUIRE(errors[1][i] < errors[0][i]/12.0);
+    }
+  }
+}
+
+TEST_CASE("Test stretched grid derivatives and psi solve are second order", "[]") {
+  // Halving ds should reduce the errors by about 4, once resolved
+  for(const std::string stretching : {"boundaries", "interface"}) {
+    real errors[2][3];
+    for(int refinement=0; refinement<2; ++refinement) {
+      Constants c("test_constants.json");
+      c.nZ = 32*(refinement+1) + 1;
+      c.verticalStretching = stretching;
+      c.stretchingFactor = 2.0;
+      c.calculateDerivedConstants();
+
+      Sim sim(c);
+      Variable u(c);
+      Variable psi(c);
+      const std::vector<real> &z = u.getStretchedGrid()->z;
+      require_equal(z[0], 0.0);
+      require_equal(z[c.nZ-1], 1.0);
+      for(int n=0; n<c.nN; ++n) {
+        const mode factor = 1.0 + real(n)*1.0i;
+        for(int k=0; k<c.nZ; ++k) {
+          u(n,k) = factor*(cos(3.0*z[k]) + z[k]);
+          psi(n,k) = factor*sin(M_PI*z[k]);
+          sim.vars.omg(n,k) = (M_PI*M_PI + pow(real(n)*c.wavelength, 2))*psi(n,k);
+        }
+      }
+      sim.solveForPsi();
+
+      for(int i=0; i<3; ++i) {
+        errors[refinement][i] = 0.0;
+      }
+      for(int n=0; n<c.nN; ++n) {
+        const mode factor = 1.0 + real(n)*1.0i;
+        for(int k=1; k<c.nZ-1; ++k) {
+          errors[refinement][0] = std::max(errors[refinement][0],
+              std::abs(u.dfdz(n,k) - factor*(-3.0*sin(3.0*z[k]) + 1.0)));
+          errors[refinement][1] = std::max(errors[refinement][1],
+              std::abs(u.dfdz2(n,k) - factor*(-9.0*cos(3.0*z[k]))));
+          errors[refinement][2] = std::max(errors[refinement][2],
+              std::abs(sim.vars.psi(n,k) - psi(n,k)));
+        }
+      }
+    }
+    for(int i=0; i<3; ++i) {
+      REQUIRE(errors[1][i] < errors[0][i]/3.0);
+    }
+  }
+}
+
+TEST_CASE("Test spectral x derivatives give a dealiased Jacobian", "[]") {
+  Constants c("test_constants.json");
+  c.isSpectralX = true;
+  c.calculateDerivedConstants();
+  require_equal(c.nX, c.dealiasedNX());
+
+  Sim sim(c);
+  const real w = c.wavelength;
+
+  // tmp = cos(2wx) and psi = sin(wx) z(1-z), so the Jacobian is
+  //   psi_z tmp_x = -w(1-2z)(cos(wx) - cos(3wx))
+  for(int k=0; k<c.nZ; ++k) {
+    real z = k*c.dz;
+    sim.vars.tmp(2,k) = 1.0;
+    sim.vars.psi(1,k) = z*(1.0-z);
+  }
+
+  sim.computeNonlinearDerivatives();
+
+  for(int k=1; k<c.nZ-1; ++k) {
+    real z = k*c.dz;
+    for(int n=0; n<c.nN; ++n) {
+      real expected = 0.0;
+      if(n == 1) {
+        expected = -w*(1.0-2.0*z);
+      } else if(n == 3) {
+        expected = w*(1.0-2.0*z);
+      }
+      require_within_error(sim.vars.dTmpdt(n,k), mode(expected), 1e-10);
+    }
+  }
+}
+
+TEST_CASE("Test FFT friendly nX is the smallest smooth size above the default", "[]") {
+  Constants c("test_constants.json");
+  c.nN = 51;
+  c.isFftFriendlyNX = true;
+  c.calculateDerivedConstants();
+
+  // 3nN+1 = 154 has a sine/cosine transform length of 153 = 3*3*17
+  require_equal(c.nX, 161);
+  require_equal(c.transformLength(c.nX), 160);
+  REQUIRE(c.transformCost(154) > c.transformCost(161));
+
+  c.isSpectralX = true;
+  c.calculateDerivedConstants();
+  require_equal(c.nX, c.fftFriendlyNX(c.dealiasedNX()));
+  REQUIRE(c.nX >= c.dealiasedNX());
+  require_equal(c.nX, 81);
+}
+
+TEST_CASE("Test CFL factor brings dt within the crossing times once", "[]") {
+  const real dt = 1.0;
+  REQUIRE(cflTimestepFactor(dt, 2.0, 3.0) == 1.0);
+
+  // 0.8^3 is the first power with 0.8^3*dt <= 0.8*0.7
+  const real f = cflTimestepFactor(dt, 10.0, 0.7);
+  require_within_error(f, 0.512, 1e-6);
+  REQUIRE(f*dt <= 0.8*0.7);
+  REQUIRE(f*dt/0.8 > 0.8*0.7);
+}
+
 TEST_CASE("Test reading and writing from file", "[]") {
   Constants c;
   c.nN = 5;
@@ -442,3 +1068,235 @@ TEST_CASE("Test reading and writing from file", "[]") {
     }
   }
 }
+
+TEST_CASE("Test eigenvalue solver finds critical Rayleigh number", "[]") {
+  Constants c("test_constants.json");
+
+  LinearStabilitySolver solver(c);
+
+  int nCrit = 2;
+  real RaCrit = pow(M_PI/c.aspectRatio, 4) * pow(pow(nCrit,2) + pow(c.aspectRatio,2), 3) / pow(nCrit,2);
+
+  solver.c.Ra = RaCrit - 2;
+  REQUIRE(solver.calcGrowthRate(nCrit) < 0.0);
+  solver.c.Ra = RaCrit + 2;
+  REQUIRE(solver.calcGrowthRate(nCrit) > 0.0);
+
+  require_within_error(solver.findCriticalRayleigh(nCrit, 0.5*RaCrit, 2.0*RaCrit), RaCrit, 1.0);
+}
+
+TEST_CASE("Test mode-decoupled linear simulation matches full linear step", "[]") {
+  Constants c("test_constants.json");
+
+  Sim sim(c);
+  sim.vars.load(c.icFile);
+
+  std::vector<int> modes = {1, 2, 5};
+  LinearModeSim modeSim(c, modes);
+  modeSim.load(sim.vars);
+  modeSim.dt.assign(modes.size(), sim.dt);
+
+  for(int step=0; step<100; ++step) {
+    sim.runLinearStep();
+    for(int i=0; i<modes.size(); ++i) {
+      modeSim.runStep(i);
+    }
+  }
+
+  for(int i=0; i<modes.size(); ++i) {
+    for(int k=0; k<c.nZ; ++k) {
+      require_within_error(modeSim.tmp(i,k), sim.vars.tmp(modes[i],k), 1e-10);
+      require_within_error(modeSim.omg(i,k), sim.vars.omg(modes[i],k), 1e-10);
+      require_within_error(modeSim.psi(i,k), sim.vars.psi(modes[i],k), 1e-10);
+    }
+  }
+}
+
+TEST_CASE("Test resetting simulation matches a new simulation", "[]") {
+  Constants c("test_constants.json");
+  Constants c2(c);
+  c2.Ra = 2.0*c.Ra;
+  c2.Pr = 2.0*c.Pr;
+  c2.aspectRatio = 2.0;
+  c2.calculateDerivedConstants();
+
+  auto runSteps = [](Sim &sim, const int nSteps) {
+    sim.loadInitialConditions();
+    sim.applyTemperatureBoundaryConditions();
+    sim.applyVorticityBoundaryConditions();
+    sim.applyPsiBoundaryConditions();
+    for(int step=0; step<nSteps; ++step) {
+      sim.runNonLinearStep();
+    }
+  };
+
+  // Initial conditions part way through a run, so that both time step
+  // slots of the derivatives are nonzero
+  {
+    Sim sim(c);
+    runSteps(sim, 3);
+    sim.vars.writeToFile("reset_initial_conditions.dat");
+  }
+  c.icFile = c2.icFile = "reset_initial_conditions.dat";
+
+  Sim newSim(c2);
+  runSteps(newSim, 50);
+
+  // An odd number of steps leaves the time step slots swapped
+  for(int nSteps : {49, 50}) {
+    Sim sim(c);
+    runSteps(sim, nSteps);
+    REQUIRE(sim.reset(c2));
+    runSteps(sim, 50);
+
+    for(int n=0; n<c.nN; ++n) {
+      for(int k=0; k<c.nZ; ++k) {
+        require_equal(sim.vars.tmp(n,k), newSim.vars.tmp(n,k));
+        require_equal(sim.vars.omg(n,k), newSim.vars.omg(n,k));
+        require_equal(sim.vars.psi(n,k), newSim.vars.psi(n,k));
+      }
+    }
+  }
+}
+
+TEST_CASE("Test resetting with a different layout refuses or matches a new simulation", "[]") {
+  // Layouts that change allocations or plans must be refused by reset, so
+  // that a new Sim is built, and the others must give the same result
+  Constants c("test_constants.json");
+  std::vector<Constants> layouts(7, c);
+  layouts[0].isCompact = true;
+  layouts[1].isFieldInterleaved = true;
+  layouts[2].transformBackend = "native";
+  layouts[3].verticalStretching = "boundaries";
+  layouts[3].stretchingFactor = 2.0;
+  layouts[4].isSlabTransformEnabled = true;
+  layouts[5].isSplitComplexKernels = true;
+  // At the same nX, so that only the x derivatives differ
+  layouts[6].isSpectralX = true;
+  layouts[6].isPhysicalResSpecfified = true;
+
+  auto runSteps = [](Sim &sim, const int nSteps) {
+    sim.loadInitialConditions();
+    sim.applyTemperatureBoundaryConditions();
+    sim.applyVorticityBoundaryConditions();
+    sim.applyPsiBoundaryConditions();
+    for(int step=0; step<nSteps; ++step) {
+      sim.runNonLinearStep();
+    }
+  };
+
+  // As above, with nonzero derivatives in both time step slots
+  {
+    Sim sim(c);
+    runSteps(sim, 3);
+    sim.vars.writeToFile("reset_layout_initial_conditions.dat");
+  }
+  c.icFile = "reset_layout_initial_conditions.dat";
+
+  for(Constants &cLayout : layouts) {
+    cLayout.icFile = "reset_layout_initial_conditions.dat";
+    cLayout.calculateDerivedConstants();
+    REQUIRE(cLayout.isValid());
+
+    // An odd number of steps before the reset leaves the time step slots swapped
+    Sim sim(c);
+    runSteps(sim, 9);
+    if(not sim.reset(cLayout)) {
+      continue;
+    }
+    runSteps(sim, 10);
+
+    Sim newSim(cLayout);
+    runSteps(newSim, 10);
+
+    for(int n=0; n<c.nN; ++n) {
+      for(int k=0; k<c.nZ; ++k) {
+        require_equal(sim.vars.tmp(n,k), newSim.vars.tmp(n,k));
+        require_equal(sim.vars.omg(n,k), newSim.vars.omg(n,k));
+        require_equal(sim.vars.psi(n,k), newSim.vars.psi(n,k));
+      }
+    }
+  }
+}
+
+TEST_CASE("Test unperturbed ensemble member matches a single simulation", "[]") {
+  for(std::string constantsFile : {"test_constants.json", "test_constants_periodic.json"}) {
+    Constants c(constantsFile);
+
+    Sim sim(c);
+    sim.loadInitialConditions();
+    sim.applyTemperatureBoundaryConditions();
+    sim.applyVorticityBoundaryConditions();
+    sim.applyPsiBoundaryConditions();
+
+    EnsembleSim ensemble(c, 3, 1e-3);
+    ensemble.loadInitialConditions();
+    ensemble.applyTemperatureBoundaryConditions();
+    ensemble.applyVorticityBoundaryConditions();
+    ensemble.applyPsiBoundaryConditions();
+
+    for(int step=0; step<50; ++step) {
+      sim.runNonLinearStep();
+      ensemble.runNonLinearStep();
+    }
+
+    real maxDifference = 0.0;
+    for(int n=0; n<c.nN; ++n) {
+      for(int k=0; k<c.nZ; ++k) {
+        require_within_error(ensemble.tmp(n,k,0), sim.vars.tmp(n,k), 1e-10);
+        require_within_error(ensemble.omg(n,k,0), sim.vars.omg(n,k), 1e-10);
+        require_within_error(ensemble.psi(n,k,0), sim.vars.psi(n,k), 1e-10);
+        maxDifference = std::max(maxDifference, std::abs(ensemble.tmp(n,k,2) - sim.vars.tmp(n,k)));
+      }
+    }
+    REQUIRE(maxDifference > 1e-6);
+  }
+}
+
+TEST_CASE("Test state cache picks the nearest state and regrids it", "[]") {
+  Constants c("test_constants.json");
+  c.stateCacheFolder = "test_state_cache";
+  StateCache cache(c.stateCacheFolder);
+
+  // Two cached states with linear temperature profiles of opposite sign
+  for(real sign : {1.0, -1.0}) {
+    Constants cCached(c);
+    cCached.Ra = sign > 0 ? 1e5 : 2e6;
+    Variables<Variable> vars(cCached);
+    for(int n=0; n<c.nN; ++n) {
+      for(int k=0; k<c.nZ; ++k) {
+        vars.tmp(n,k) = sign*(n+1)*k*c.dz;
+      }
+    }
+    cache.store(cCached, vars);
+  }
+
+  Constants cFine(c);
+  cFine.Ra = 1.5e6;
+  cFine.nZ = 2*c.nZ-1;
+  cFine.calculateDerivedConstants();
+
+  std::string stateFile;
+  Constants cached;
+  REQUIRE(cache.findNearest(cFine, stateFile, cached));
+  require_equal(cached.Ra, 2e6);
+
+  Variables<Variable> vars(cFine);
+  REQUIRE(cache.load(cFine, vars));
+  for(int n=0; n<cFine.nN; ++n) {
+    for(int k=0; k<cFine.nZ; ++k) {
+      require_within_error(vars.tmp(n,k), mode(-(n+1)*k*cFine.dz), 1e-10);
+      require_equal(vars.dTmpdt(n,k), 0.0);
+    }
+  }
+
+  // Only single nonlinear finite difference runs read the cache
+  Constants cWarm(c);
+  cWarm.warmStart = true;
+  REQUIRE(cWarm.isValid());
+  cWarm.ensembleSize = 2;
+  REQUIRE_FALSE(cWarm.isValid());
+  cWarm.ensembleSize = 1;
+  cWarm.isNonlinear = false;
+  REQUIRE_FALSE(cWarm.isValid());
+}